@@ -0,0 +1,47 @@
+/*
+ * auto_framing.h
+ *
+ *  A virtual camera that crops the preview around the tracked faces and
+ *  scales the crop back to the full frame. The window glides after the
+ *  faces like a camera operator would follow them, instead of jumping
+ *  with every detection.
+ */
+
+#ifndef AUTO_FRAMING_H_
+#define AUTO_FRAMING_H_
+
+#include <vector>
+#include <dlib/geometry.h>
+#include "nv12_resample.h"
+
+/* Size of the window next to the box around all the faces. */
+#define FRAMING_MARGIN 2.5
+#define FRAMING_MAX_ZOOM 3.0
+/* Natural frequency of the virtual camera, in rad/s. Higher follows faster. */
+#define FRAMING_RESPONSE 3.0
+/* The window stays where it is while the faces move less than this fraction of it. */
+#define FRAMING_DEAD_ZONE 0.08
+/* The window waits this long, in ms, before it zooms out on a frame without faces. */
+#define FRAMING_HOLD_MS 1000
+/* Frame interval assumed when the timestamps do not give one, in ms. */
+#define FRAMING_DEFAULT_DT 33
+
+typedef struct _framing {
+	bool started; /* false until the first frame */
+	double x, y, size; /* center and width of the window, in frame pixels */
+	double vx, vy, vsize; /* their speeds, in pixels per second */
+	double target_x, target_y, target_size; /* where the window is headed */
+	unsigned int time; /* timestamp of the last update, in ms */
+	unsigned int face_time; /* timestamp of the last frame with a face */
+	int left, top, width, height; /* the window of the current frame, even */
+	std::vector<unsigned char> crop; /* the window, NV12, while it is scaled over the frame */
+	nv12resampler resampler;
+} framing;
+
+void framing_reset(framing* fr);
+void framing_update(framing* fr, const std::vector<dlib::rectangle>& faces,
+		int frame_width, int frame_height, unsigned int time);
+bool framing_active(const framing* fr, int frame_width, int frame_height);
+void framing_apply(framing* fr, unsigned char* y, unsigned char* uv, int frame_width, int frame_height);
+
+#endif /* AUTO_FRAMING_H_ */
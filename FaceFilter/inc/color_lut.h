@@ -0,0 +1,32 @@
+/*
+ * color_lut.h
+ *
+ *  Color grading with the 3D lookup tables of .cube files. A table is
+ *  baked once, when it is loaded, into the YUV of the camera preview, so
+ *  a frame is graded in a single pass over its NV12 planes without ever
+ *  going through RGB.
+ */
+
+#ifndef COLOR_LUT_H_
+#define COLOR_LUT_H_
+
+#include <vector>
+#include <dlib/threads.h>
+
+/* Nodes along every axis of a baked table: 17 nodes 16 levels apart, or 33 nodes 8 apart. */
+#define COLOR_LUT_SMALL 17
+#define COLOR_LUT_LARGE 33
+/* Largest table a .cube file may hold along every axis. */
+#define COLOR_LUT_MAX_CUBE 256
+
+typedef struct _colorlut {
+	int size; /* nodes along every axis, 0 if nothing is loaded */
+	int shift; /* log2 of the levels between nodes */
+	std::vector<unsigned char> nodes; /* Y, Cb, Cr and a pad byte of every node, Cr varying fastest, then Cb */
+} colorlut;
+
+bool color_lut_load(colorlut* cl, const char* path, int size);
+void color_lut_apply(const colorlut* cl, unsigned char* y, unsigned char* uv, int width, int height,
+		int stride, dlib::thread_pool* pool);
+
+#endif /* COLOR_LUT_H_ */
@@ -0,0 +1,37 @@
+/*
+ * convolution.h
+ *
+ *  3x3 and 5x5 convolution of the rows of an NV12 plane, in fixed point.
+ *  A kernel is either separable, one vertical and one horizontal pass like
+ *  dlib's spatial_filter_image_separable(), or a full kernel of which only
+ *  the nonzero taps are visited. Neighbours are step bytes apart, so the
+ *  Cb and Cr samples of an interleaved chroma row are filtered apart.
+ */
+
+#ifndef CONVOLUTION_H_
+#define CONVOLUTION_H_
+
+#define CONV_MAX_RADIUS 2
+#define CONV_MAX_TAPS 25
+/* Bytes a row needs left and right of it: the radius times a chroma step. */
+#define CONV_PAD (2 * CONV_MAX_RADIUS)
+
+typedef struct _convkernel {
+	int radius; /* 1 for 3x3, 2 for 5x5 */
+	int shift; /* the weights are in units of 1 / (1 << shift) */
+	bool separable;
+	short col[2 * CONV_MAX_RADIUS + 1]; /* separable: vertical weights, top first */
+	short row[2 * CONV_MAX_RADIUS + 1]; /* separable: horizontal weights, left first */
+	int taps; /* not separable: number of nonzero weights */
+	short weights[CONV_MAX_TAPS];
+	signed char dy[CONV_MAX_TAPS]; /* row of every tap, -radius..radius */
+	signed char dx[CONV_MAX_TAPS]; /* column of every tap, in samples */
+} convkernel;
+
+bool conv_kernel_init(convkernel* ck, const int* k, int size, int shift);
+bool conv_kernel_init_separable(convkernel* ck, const int* col, const int* row, int size, int shift);
+void conv_pad_row(unsigned char* row, int width, int step);
+void conv_row(const convkernel* ck, const unsigned char* const* rows, unsigned char* out,
+		int width, int step, short* temp);
+
+#endif /* CONVOLUTION_H_ */
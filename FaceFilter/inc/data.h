@@ -25,7 +25,7 @@
 #include <camera.h>
 
 #define BUFLEN 512
-#define MAX_FILTER 30
+#define MAX_FILTER 12
 #define MAX_STICKER 5
 
 typedef struct{
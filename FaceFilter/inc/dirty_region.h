@@ -0,0 +1,36 @@
+/*
+ * dirty_region.h
+ *
+ *  The parts of the preview frame that the effects of the current frame
+ *  touch: sticker bounds and face regions. Stages that only change those
+ *  parts walk the list instead of the whole plane.
+ */
+
+#ifndef DIRTY_REGION_H_
+#define DIRTY_REGION_H_
+
+#include <vector>
+
+/* What a region was added for. A merged region keeps all of its kinds. */
+#define DIRTY_STICKER 0x1
+#define DIRTY_FACE 0x2
+#define MAX_DIRTY 32
+
+typedef struct _dirtyrect {
+	int left, top; /* first column and row, even */
+	int right, bottom; /* one past the last column and row, even */
+	unsigned kinds;
+} dirtyrect;
+
+typedef struct _dirtylist {
+	std::vector<dirtyrect> rects; /* do not overlap once merged */
+	int width; /* of the frame */
+	int height;
+} dirtylist;
+
+void dirty_list_begin(dirtylist* dl, int width, int height);
+void dirty_list_add(dirtylist* dl, int left, int top, int right, int bottom, unsigned kind);
+void dirty_list_merge(dirtylist* dl);
+void dirty_list_draw(const dirtylist* dl, unsigned char* y, unsigned char* uv);
+
+#endif /* DIRTY_REGION_H_ */
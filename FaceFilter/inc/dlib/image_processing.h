@@ -22,6 +22,7 @@
 #include "image_processing/shape_predictor.h"
 #include "image_processing/shape_predictor_trainer.h"
 #include "image_processing/correlation_tracker.h"
+#include "image_processing/fast_correlation_tracker.h"
 
 #endif // DLIB_IMAGE_PROCESSInG_H_h_
 
@@ -0,0 +1,836 @@
+// Copyright (C) 2015  Davis E. King (davis@dlib.net)
+// License: Boost Software License   See LICENSE.txt for the full license.
+#ifndef DLIB_FAST_CORRELATION_TrACKER_H_
+#define DLIB_FAST_CORRELATION_TrACKER_H_
+
+#include "fast_correlation_tracker_abstract.h"
+#include "../geometry.h"
+#include "../matrix.h"
+#include "../array.h"
+#include "../array2d.h"
+#include "../statistics.h"
+#include "../image_transforms/assign_image.h"
+#include "../image_transforms/interpolation.h"
+#include "../image_transforms/fhog.h"
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+
+namespace dlib
+{
+
+// ----------------------------------------------------------------------------------------
+
+    namespace impl_fct
+    {
+        typedef std::complex<float> cf;
+
+        inline cf cmul (const cf& a, const cf& b)
+        {
+            // Written out by hand since std::complex's operator* does the full C99
+            // inf/nan checking, which is several times slower.
+            return cf(a.real()*b.real() - a.imag()*b.imag(),
+                      a.real()*b.imag() + a.imag()*b.real());
+        }
+
+        inline cf cmul_conj (const cf& a, const cf& b)
+        {
+            // a*conj(b)
+            return cf(a.real()*b.real() + a.imag()*b.imag(),
+                      a.imag()*b.real() - a.real()*b.imag());
+        }
+
+        inline float norm2 (const cf& a)
+        {
+            return a.real()*a.real() + a.imag()*a.imag();
+        }
+
+    // ------------------------------------------------------------------------------------
+
+        class real_fft
+        {
+            /*!
+                WHAT THIS OBJECT REPRESENTS
+                    This object computes FFTs of real valued signals of a fixed power of
+                    two length n.  The twiddle factors and bit reversal permutation are
+                    computed once by setup(), so transforming does no trigonometry and no
+                    allocation.
+
+                    Real inputs are transformed two at a time by packing them into the
+                    real and imaginary parts of one complex FFT, and only the n/2+1
+                    non-redundant bins of each spectrum are produced.  The other bins
+                    follow from Hermitian symmetry.  The transforms use the same sign
+                    conventions as dlib's fft() and ifft().
+            !*/
+        public:
+
+            real_fft() : n(0) {}
+
+            void setup (
+                long size
+            )
+            {
+                DLIB_ASSERT(size >= 2 && is_power_of_two(size));
+                if (size == n)
+                    return;
+
+                n = size;
+                tw.resize(n/2);
+                twc.resize(n/2);
+                for (long k = 0; k < n/2; ++k)
+                {
+                    tw[k] = cf(std::cos(-2*pi*k/n), std::sin(-2*pi*k/n));
+                    twc[k] = std::conj(tw[k]);
+                }
+
+                long bits = 0;
+                while ((1L<<bits) < n)
+                    ++bits;
+                rev.resize(n);
+                for (long i = 0; i < n; ++i)
+                {
+                    long r = 0;
+                    for (long b = 0; b < bits; ++b)
+                    {
+                        if (i&(1L<<b))
+                            r |= 1L<<(bits-1-b);
+                    }
+                    rev[i] = r;
+                }
+                buf.resize(n);
+            }
+
+            long size (
+            ) const { return n; }
+
+            long half_size (
+            ) const { return n/2+1; }
+
+            void forward_2d (
+                const matrix<float>& in,
+                matrix<cf>& out
+            )
+            /*!
+                requires
+                    - in.nr() == in.nc() == size()
+                ensures
+                    - #out == the left size() x half_size() columns of fft(in)
+            !*/
+            {
+                // Pack pairs of rows into complex signals, stored transposed so the
+                // row FFTs can all be done at once by transform_cols().
+                const long h = half_size();
+                const long np = n/2;
+                packed.set_size(n, np);
+                for (long p = 0; p < np; ++p)
+                {
+                    for (long c = 0; c < n; ++c)
+                        packed(c,p) = cf(in(2*p,c), in(2*p+1,c));
+                }
+                transform_cols(&packed(0,0), np, false);
+
+                out.set_size(n, h);
+                for (long k = 0; k < h; ++k)
+                {
+                    const cf* z = &packed(k,0);
+                    const cf* zn = &packed((n-k)&(n-1),0);
+                    for (long p = 0; p < np; ++p)
+                    {
+                        const cf zc = std::conj(zn[p]);
+                        out(2*p,k)   = cf(0.5f*(z[p].real()+zc.real()), 0.5f*(z[p].imag()+zc.imag()));
+                        out(2*p+1,k) = cf(0.5f*(z[p].imag()-zc.imag()), 0.5f*(zc.real()-z[p].real()));
+                    }
+                }
+
+                transform_cols(&out(0,0), h, false);
+            }
+
+            void inverse_2d (
+                matrix<cf>& in,
+                matrix<float>& out
+            )
+            /*!
+                requires
+                    - in.nr() == size()
+                    - in.nc() == half_size()
+                    - in is the non-redundant half of the spectrum of a real image
+                ensures
+                    - #out == real(ifft(the full spectrum))
+                    - in is used as scratch space and its contents are destroyed
+            !*/
+            {
+                transform_cols(&in(0,0), half_size(), true);
+
+                const long h = half_size();
+                const long np = n/2;
+                packed.set_size(n, np);
+                for (long k = 0; k < n; ++k)
+                {
+                    cf* z = &packed(k,0);
+                    if (k < h)
+                    {
+                        for (long p = 0; p < np; ++p)
+                        {
+                            const cf xa = in(2*p,k), xb = in(2*p+1,k);
+                            z[p] = cf(xa.real()-xb.imag(), xa.imag()+xb.real());
+                        }
+                    }
+                    else
+                    {
+                        for (long p = 0; p < np; ++p)
+                        {
+                            const cf xa = std::conj(in(2*p,n-k)), xb = std::conj(in(2*p+1,n-k));
+                            z[p] = cf(xa.real()-xb.imag(), xa.imag()+xb.real());
+                        }
+                    }
+                }
+                transform_cols(&packed(0,0), np, true);
+
+                out.set_size(n, n);
+                const float scale = 1.0f/(n*n);
+                for (long p = 0; p < np; ++p)
+                {
+                    for (long c = 0; c < n; ++c)
+                    {
+                        out(2*p,c)   = packed(c,p).real()*scale;
+                        out(2*p+1,c) = packed(c,p).imag()*scale;
+                    }
+                }
+            }
+
+            void forward_cols (
+                const matrix<float>& in,
+                matrix<cf>& out
+            )
+            /*!
+                requires
+                    - in.nc() == size()
+                ensures
+                    - #out.nr() == in.nr()
+                    - #out.nc() == half_size()
+                    - each row of #out is the non-redundant half of the 1D FFT of the
+                      corresponding row of in.
+            !*/
+            {
+                const long h = half_size();
+                out.set_size(in.nr(), h);
+                for (long r = 0; r < in.nr(); r += 2)
+                {
+                    const bool has_pair = r+1 < in.nr();
+                    for (long c = 0; c < n; ++c)
+                        buf[c] = cf(in(r,c), has_pair ? in(r+1,c) : 0);
+                    transform(false);
+                    if (has_pair)
+                    {
+                        split(&out(r,0), &out(r+1,0), 1);
+                    }
+                    else
+                    {
+                        for (long k = 0; k < h; ++k)
+                            out(r,k) = buf[k];
+                    }
+                }
+            }
+
+            void inverse_1d (
+                const cf* in,
+                float* out
+            )
+            /*!
+                requires
+                    - in points to the half_size() non-redundant bins of the spectrum of a
+                      real signal
+                    - out points to size() floats
+                ensures
+                    - writes real(ifft(the full spectrum)) to out
+            !*/
+            {
+                merge(in, 0, 1);
+                transform(true);
+                const float scale = 1.0f/n;
+                for (long k = 0; k < n; ++k)
+                    out[k] = buf[k].real()*scale;
+            }
+
+        private:
+
+            void split (
+                cf* a,
+                cf* b,
+                long stride
+            ) const
+            {
+                // buf holds fft(x + i*y), separate it into fft(x) and fft(y).
+                const long h = half_size();
+                for (long k = 0; k < h; ++k)
+                {
+                    const cf z = buf[k];
+                    const cf zc = std::conj(buf[(n-k)&(n-1)]);
+                    a[k*stride] = cf(0.5f*(z.real()+zc.real()), 0.5f*(z.imag()+zc.imag()));
+                    b[k*stride] = cf(0.5f*(z.imag()-zc.imag()), 0.5f*(zc.real()-z.real()));
+                }
+            }
+
+            void merge (
+                const cf* a,
+                const cf* b,
+                long stride
+            )
+            {
+                // Rebuild the full spectra from their halves and pack them as fft(x + i*y).
+                const long h = half_size();
+                for (long k = 0; k < n; ++k)
+                {
+                    cf xa, xb;
+                    if (k < h)
+                    {
+                        xa = a[k*stride];
+                        xb = b ? b[k*stride] : cf(0);
+                    }
+                    else
+                    {
+                        xa = std::conj(a[(n-k)*stride]);
+                        xb = b ? std::conj(b[(n-k)*stride]) : cf(0);
+                    }
+                    buf[k] = cf(xa.real()-xb.imag(), xa.imag()+xb.real());
+                }
+            }
+
+            void transform (
+                bool backward
+            )
+            {
+                // iterative radix-2 decimation in time FFT on buf
+                const cf* w = backward ? &twc[0] : &tw[0];
+                cf* x = &buf[0];
+                for (long i = 0; i < n; ++i)
+                {
+                    if (i < rev[i])
+                        std::swap(x[i], x[rev[i]]);
+                }
+
+                for (long len = 2; len <= n; len <<= 1)
+                {
+                    const long half = len/2;
+                    const long step = n/len;
+                    for (long i = 0; i < n; i += len)
+                    {
+                        for (long j = 0; j < half; ++j)
+                        {
+                            const cf v = cmul(x[i+j+half], w[j*step]);
+                            x[i+j+half] = x[i+j] - v;
+                            x[i+j] += v;
+                        }
+                    }
+                }
+            }
+
+            void transform_cols (
+                cf* data,
+                long nc,
+                bool backward
+            )
+            {
+                // Same as transform() but applied to all the columns of the n x nc row
+                // major matrix in data at once.  The butterflies then work on whole
+                // contiguous rows, which is much friendlier to the cache and to the
+                // vectorizer than transforming one strided column at a time.
+                const cf* w = backward ? &twc[0] : &tw[0];
+                for (long i = 0; i < n; ++i)
+                {
+                    if (i < rev[i])
+                        std::swap_ranges(data + i*nc, data + (i+1)*nc, data + rev[i]*nc);
+                }
+
+                for (long len = 2; len <= n; len <<= 1)
+                {
+                    const long half = len/2;
+                    const long step = n/len;
+                    for (long i = 0; i < n; i += len)
+                    {
+                        for (long j = 0; j < half; ++j)
+                        {
+                            const cf ww = w[j*step];
+                            cf* a = data + (i+j)*nc;
+                            cf* b = data + (i+j+half)*nc;
+                            for (long c = 0; c < nc; ++c)
+                            {
+                                const cf v = cmul(b[c], ww);
+                                b[c] = a[c] - v;
+                                a[c] += v;
+                            }
+                        }
+                    }
+                }
+            }
+
+            long n;
+            std::vector<cf> tw, twc;
+            std::vector<long> rev;
+            std::vector<cf> buf;
+            matrix<cf> packed;
+        };
+
+    }
+
+// ----------------------------------------------------------------------------------------
+
+    class fast_correlation_tracker
+    {
+    public:
+
+        explicit fast_correlation_tracker (unsigned long filter_size = 6,
+            unsigned long num_scale_levels = 5,
+            unsigned long scale_window_size = 23,
+            double regularizer_space = 0.001,
+            double nu_space = 0.025,
+            double regularizer_scale = 0.001,
+            double nu_scale = 0.025,
+            double scale_pyramid_alpha = 1.020,
+            unsigned long scale_update_interval = 3
+        )
+            : filter_size(1 << filter_size), num_scale_levels(1 << num_scale_levels),
+            scale_window_size(scale_window_size),
+            regularizer_space(regularizer_space), nu_space(nu_space),
+            regularizer_scale(regularizer_scale), nu_scale(nu_scale),
+            scale_pyramid_alpha(scale_pyramid_alpha),
+            scale_update_interval(scale_update_interval),
+            updates_since_scale(0)
+        {
+            DLIB_CASSERT(scale_update_interval > 0,
+                "\t fast_correlation_tracker::fast_correlation_tracker()"
+                << "\n\t scale_update_interval must be > 0"
+            );
+
+            fft_space.setup(get_filter_size());
+            fft_scale.setup(get_num_scale_levels());
+
+            // Create the cosine mask used for space filtering.
+            mask = make_cosine_mask();
+
+            // Create the cosine mask used for the scale filtering.
+            scale_cos_mask.resize(get_num_scale_levels());
+            const long max_level = get_num_scale_levels()/2;
+            for (unsigned long k = 0; k < get_num_scale_levels(); ++k)
+            {
+                double dist = std::abs((double)k-max_level)/max_level*pi/2;
+                dist = std::min(dist, pi/2);
+                scale_cos_mask[k] = std::cos(dist);
+            }
+        }
+
+        template <typename image_type>
+        void start_track (
+            const image_type& img,
+            const drectangle& p
+        )
+        {
+            DLIB_CASSERT(p.is_empty() == false,
+                "\t void fast_correlation_tracker::start_track()"
+                << "\n\t You can't give an empty rectangle."
+            );
+
+            point_transform_affine tform = inv(make_chip(img, p));
+            make_target_location_image(tform(center(p)), G);
+            A.resize(F.size());
+            B.set_size(G.nr(), G.nc());
+            B = 0;
+            for (unsigned long i = 0; i < F.size(); ++i)
+            {
+                A[i].set_size(G.nr(), G.nc());
+                const impl_fct::cf* f = &F[i](0,0);
+                const impl_fct::cf* g = &G(0,0);
+                impl_fct::cf* a = &A[i](0,0);
+                float* b = &B(0,0);
+                for (long k = 0; k < G.size(); ++k)
+                {
+                    a[k] = impl_fct::cmul(g[k], f[k]);
+                    b[k] += impl_fct::norm2(f[k]);
+                }
+            }
+
+            position = p;
+
+            // now do the scale space stuff
+            make_scale_space(img);
+            make_scale_target_location_image(get_num_scale_levels()/2, Gs);
+            As.set_size(Fs.nr(), Fs.nc());
+            Bs.set_size(Fs.nc());
+            Bs = 0;
+            for (long i = 0; i < Fs.nr(); ++i)
+            {
+                for (long k = 0; k < Fs.nc(); ++k)
+                {
+                    As(i,k) = impl_fct::cmul(Gs(k), Fs(i,k));
+                    Bs(k) += impl_fct::norm2(Fs(i,k));
+                }
+            }
+            updates_since_scale = 0;
+        }
+
+
+        unsigned long get_filter_size (
+        ) const { return filter_size; }
+
+        unsigned long get_num_scale_levels(
+        ) const { return num_scale_levels; }
+
+        unsigned long get_scale_window_size (
+        ) const { return scale_window_size; }
+
+        double get_regularizer_space (
+        ) const { return regularizer_space; }
+        inline double get_nu_space (
+        ) const { return nu_space;}
+
+        double get_regularizer_scale (
+        ) const { return regularizer_scale; }
+        double get_nu_scale (
+        ) const { return nu_scale;}
+
+        drectangle get_position (
+        ) const
+        {
+            return position;
+        }
+
+        double get_scale_pyramid_alpha (
+        ) const { return scale_pyramid_alpha; }
+
+        unsigned long get_scale_update_interval (
+        ) const { return scale_update_interval; }
+
+        void set_scale_update_interval (
+            unsigned long interval
+        )
+        {
+            DLIB_CASSERT(interval > 0,
+                "\t void fast_correlation_tracker::set_scale_update_interval()"
+                << "\n\t interval must be > 0"
+            );
+            scale_update_interval = interval;
+        }
+
+
+        template <typename image_type>
+        double update_noscale(
+            const image_type& img,
+            const drectangle& guess
+        )
+        {
+            DLIB_CASSERT(get_position().is_empty() == false,
+                "\t double fast_correlation_tracker::update()"
+                << "\n\t You must call start_track() first before calling update()."
+            );
+
+
+            const point_transform_affine tform = make_chip(img, guess);
+
+            // use the current filter to predict the object's location
+            const long size = B.size();
+            const float reg = get_regularizer_space();
+            impl_fct::cf* g = &G(0,0);
+            for (long k = 0; k < size; ++k)
+                g[k] = 0;
+            for (unsigned long i = 0; i < F.size(); ++i)
+            {
+                const impl_fct::cf* f = &F[i](0,0);
+                const impl_fct::cf* a = &A[i](0,0);
+                for (long k = 0; k < size; ++k)
+                    g[k] += impl_fct::cmul_conj(f[k], a[k]);
+            }
+            const float* b = &B(0,0);
+            for (long k = 0; k < size; ++k)
+                g[k] *= 1/(b[k]+reg);
+            fft_space.inverse_2d(G, response);
+            const dlib::vector<double,2> pp = max_point_interpolated(response);
+
+
+            // Compute the peak to side lobe ratio.
+            const point p = pp;
+            running_stats<double> rs;
+            const rectangle peak = centered_rect(p, 8,8);
+            for (long r = 0; r < response.nr(); ++r)
+            {
+                for (long c = 0; c < response.nc(); ++c)
+                {
+                    if (!peak.contains(point(c,r)))
+                        rs.add(response(r,c));
+                }
+            }
+            const double psr = (response(p.y(),p.x())-rs.mean())/rs.stddev();
+
+            // update the position of the object
+            position = translate_rect(guess, tform(pp)-center(guess));
+
+            // now update the position filters
+            make_target_location_image(pp, G);
+            const float nu = get_nu_space();
+            float* bb = &B(0,0);
+            for (long k = 0; k < size; ++k)
+                bb[k] *= 1-nu;
+            for (unsigned long i = 0; i < F.size(); ++i)
+            {
+                const impl_fct::cf* f = &F[i](0,0);
+                impl_fct::cf* a = &A[i](0,0);
+                for (long k = 0; k < size; ++k)
+                {
+                    a[k] = nu*impl_fct::cmul(g[k], f[k]) + (1-nu)*a[k];
+                    bb[k] += nu*impl_fct::norm2(f[k]);
+                }
+            }
+
+            return psr;
+        }
+
+        template <typename image_type>
+        double update (
+            const image_type& img,
+            const drectangle& guess
+        )
+        {
+            double psr = update_noscale(img, guess);
+
+            // The scale changes much slower than the position, so only estimate it
+            // every get_scale_update_interval() updates.
+            if (++updates_since_scale < get_scale_update_interval())
+                return psr;
+            updates_since_scale = 0;
+
+            // Now predict the scale change
+            make_scale_space(img);
+            for (long k = 0; k < Gs.size(); ++k)
+                Gs(k) = 0;
+            for (long i = 0; i < Fs.nr(); ++i)
+            {
+                for (long k = 0; k < Fs.nc(); ++k)
+                    Gs(k) += impl_fct::cmul_conj(Fs(i,k), As(i,k));
+            }
+            const float reg = get_regularizer_scale();
+            for (long k = 0; k < Gs.size(); ++k)
+                Gs(k) *= 1/(Bs(k)+reg);
+            fft_scale.inverse_1d(&Gs(0), &response_scale(0));
+            const double pos = max_point_interpolated(response_scale).y();
+
+            // update the rectangle's scale
+            position *= std::pow(get_scale_pyramid_alpha(), pos-(double)get_num_scale_levels()/2);
+
+
+
+            // Now update the scale filters
+            make_scale_target_location_image(pos, Gs);
+            const float nu = get_nu_scale();
+            Bs *= 1-nu;
+            for (long i = 0; i < Fs.nr(); ++i)
+            {
+                for (long k = 0; k < Fs.nc(); ++k)
+                {
+                    As(i,k) = nu*impl_fct::cmul(Gs(k), Fs(i,k)) + (1-nu)*As(i,k);
+                    Bs(k) += nu*impl_fct::norm2(Fs(i,k));
+                }
+            }
+
+
+            return psr;
+        }
+
+        template <typename image_type>
+        double update_noscale (
+            const image_type& img
+        )
+        {
+            return update_noscale(img, get_position());
+        }
+
+        template <typename image_type>
+        double update(
+            const image_type& img
+            )
+        {
+            return update(img, get_position());
+        }
+
+    private:
+
+        template <typename image_type>
+        void make_scale_space(
+            const image_type& img
+        )
+        {
+            // Sample the image pyramid one level at a time and put the HOG features of
+            // every level into a column of scale_feats.
+            const long chip_size = get_scale_window_size();
+            drectangle ppp = position*std::pow(get_scale_pyramid_alpha(), -(double)get_num_scale_levels()/2);
+            from_points.resize(3);
+            from_points[0] = point(0,0);
+            from_points[1] = point(chip_size-1,0);
+            from_points[2] = point(chip_size-1,chip_size-1);
+            to_points.resize(3);
+            scale_chip.set_size(chip_size, chip_size);
+            for (unsigned long k = 0; k < get_num_scale_levels(); ++k)
+            {
+                // pull box into chip
+                to_points[0] = ppp.tl_corner();
+                to_points[1] = ppp.tr_corner();
+                to_points[2] = ppp.br_corner();
+                transform_image(img,scale_chip,interpolate_bilinear(),find_affine_transform(from_points, to_points));
+                ppp *= get_scale_pyramid_alpha();
+
+                extract_fhog_features(scale_chip, scale_hog, 4);
+                const long hnr = scale_hog[0].nr();
+                const long hnc = scale_hog[0].nc();
+                if (k == 0)
+                    scale_feats.set_size(hnr*hnc*32, get_num_scale_levels());
+
+                // The last channel is the raw chip, scaled to [0,1].
+                const float m = scale_cos_mask[k];
+                long i = 0;
+                for (long r = 0; r < hnr; ++r)
+                {
+                    for (long c = 0; c < hnc; ++c)
+                    {
+                        for (unsigned long j = 0; j < 31; ++j)
+                            scale_feats(i++,k) = scale_hog[j][r][c]*m;
+                        scale_feats(i++,k) = scale_chip[r][c]/255*m;
+                    }
+                }
+            }
+
+            fft_scale.forward_cols(scale_feats, Fs);
+            response_scale.set_size(get_num_scale_levels());
+        }
+
+        template <typename image_type>
+        point_transform_affine make_chip (
+            const image_type& img,
+            drectangle p
+        )
+        {
+            const double padding = 1.4;
+            const chip_details details(p*padding, chip_dims(get_filter_size(), get_filter_size()));
+            extract_image_chip(img, details, chip);
+
+            F.resize(32);
+            extract_fhog_features(chip, hog, 1, 3,3 );
+            plane.set_size(chip.nr(), chip.nc());
+            for (unsigned long i = 0; i < hog.size(); ++i)
+            {
+                for (long r = 0; r < plane.nr(); ++r)
+                {
+                    for (long c = 0; c < plane.nc(); ++c)
+                        plane(r,c) = hog[i][r][c]*mask(r,c);
+                }
+                fft_space.forward_2d(plane, F[i]);
+            }
+
+            for (long r = 0; r < plane.nr(); ++r)
+            {
+                for (long c = 0; c < plane.nc(); ++c)
+                    plane(r,c) = chip[r][c]*mask(r,c)/255;
+            }
+            fft_space.forward_2d(plane, F[31]);
+
+            return inv(get_mapping_to_chip(details));
+        }
+
+        void make_target_location_image (
+            const dlib::vector<double,2>& p,
+            matrix<impl_fct::cf>& g
+        )
+        {
+            plane.set_size(get_filter_size(), get_filter_size());
+            plane = 0;
+            rectangle area = centered_rect(p, 21,21).intersect(get_rect(plane));
+            for (long r = area.top(); r <= area.bottom(); ++r)
+            {
+                for (long c = area.left(); c <= area.right(); ++c)
+                {
+                    double dist = length(point(c,r)-p);
+                    plane(r,c) = std::exp(-dist/3.0);
+                }
+            }
+            fft_space.forward_2d(plane, g);
+            for (long k = 0; k < g.size(); ++k)
+                g(k) = std::conj(g(k));
+        }
+
+
+        void make_scale_target_location_image (
+            const double scale,
+            matrix<impl_fct::cf,0,1>& g
+        )
+        {
+            scale_target.set_size(1, get_num_scale_levels());
+            for (long i = 0; i < scale_target.size(); ++i)
+            {
+                double dist = std::pow((i-scale),2.0);
+                scale_target(i) = std::exp(-dist/1.000);
+            }
+            fft_scale.forward_cols(scale_target, scale_target_fft);
+            g = conj(trans(scale_target_fft));
+        }
+
+        matrix<float> make_cosine_mask (
+        ) const
+        {
+            const long size = get_filter_size();
+            matrix<float> temp(size,size);
+            point cent = center(get_rect(temp));
+            for (long r = 0; r < temp.nr(); ++r)
+            {
+                for (long c = 0; c < temp.nc(); ++c)
+                {
+                    point delta = point(c,r)-cent;
+                    double dist = length(delta)/(size/2.0)*(pi/2);
+                    dist = std::min(dist*1.0, pi/2);
+
+                    temp(r,c) = std::cos(dist);
+                }
+            }
+            return temp;
+        }
+
+
+        // The filters only hold the non-redundant half of each spectrum.
+        std::vector<matrix<impl_fct::cf> > A, F;
+        matrix<float> B;
+
+        matrix<impl_fct::cf> As, Fs;
+        matrix<float,0,1> Bs;
+        drectangle position;
+
+        matrix<float> mask;
+        std::vector<double> scale_cos_mask;
+
+        // None of the following logically contribute to the state of this object.
+        // They are here just so we can avoid reallocating them on every update.
+        impl_fct::real_fft fft_space, fft_scale;
+        matrix<impl_fct::cf> G;
+        matrix<impl_fct::cf,0,1> Gs;
+        matrix<float> response;
+        matrix<float,0,1> response_scale;
+        matrix<float> plane;
+        array2d<float> chip;
+        dlib::array<array2d<float> > hog;
+        array2d<float> scale_chip;
+        dlib::array<array2d<float> > scale_hog;
+        matrix<float> scale_feats;
+        matrix<float> scale_target;
+        matrix<impl_fct::cf> scale_target_fft;
+        std::vector<dlib::vector<double,2> > from_points, to_points;
+
+        unsigned long filter_size;
+        unsigned long num_scale_levels;
+        unsigned long scale_window_size;
+        double regularizer_space;
+        double nu_space;
+        double regularizer_scale;
+        double nu_scale;
+        double scale_pyramid_alpha;
+        unsigned long scale_update_interval;
+        unsigned long updates_since_scale;
+    };
+}
+
+#endif // DLIB_FAST_CORRELATION_TrACKER_H_
@@ -0,0 +1,188 @@
+// Copyright (C) 2015  Davis E. King (davis@dlib.net)
+// License: Boost Software License   See LICENSE.txt for the full license.
+#undef DLIB_FAST_CORRELATION_TrACKER_ABSTRACT_H_
+#ifdef DLIB_FAST_CORRELATION_TrACKER_ABSTRACT_H_
+
+#include "../geometry/drectangle_abstract.h"
+
+namespace dlib
+{
+
+// ----------------------------------------------------------------------------------------
+
+    class fast_correlation_tracker
+    {
+        /*!
+            WHAT THIS OBJECT REPRESENTS
+                This object is a drop in replacement for the correlation_tracker that is
+                several times cheaper per update.  It implements the same method, but:
+                    - All the filters and features are kept in single precision.
+                    - Since the features are real valued, it uses real-to-complex FFTs
+                      and stores only the non-redundant half of every spectrum.
+                    - The FFT tables and all the working buffers live inside the object,
+                      so update() does not allocate once the tracker is running.
+                    - The scale of the object is only re-estimated every
+                      get_scale_update_interval() calls to update().
+
+                The only other difference is that the features are always computed from
+                a grayscale version of the image, even for color images.
+        !*/
+
+    public:
+
+        explicit fast_correlation_tracker (unsigned long filter_size = 6, 
+            unsigned long num_scale_levels = 5, 
+            unsigned long scale_window_size = 23,
+            double regularizer_space = 0.001,
+            double nu_space = 0.025,
+            double regularizer_scale = 0.001,
+            double nu_scale = 0.025,
+            double scale_pyramid_alpha = 1.020,
+            unsigned long scale_update_interval = 3
+        );
+        /*!
+            requires
+                - scale_update_interval > 0
+            ensures
+                - Initializes fast_correlation_tracker. The arguments have the same
+                  meaning as for correlation_tracker.
+                - #get_scale_update_interval() == scale_update_interval
+                - #get_position().is_empty() == true
+        !*/
+
+        unsigned long get_scale_update_interval (
+        ) const;
+        /*!
+            ensures
+                - update() re-estimates the scale of the object, and updates the scale
+                  filter, once every get_scale_update_interval() calls.  The other calls
+                  behave like update_noscale().  A value of 1 gives the behavior of
+                  correlation_tracker.
+        !*/
+
+        void set_scale_update_interval (
+            unsigned long interval
+        );
+        /*!
+            requires
+                - interval > 0
+            ensures
+                - #get_scale_update_interval() == interval
+        !*/
+
+        template <
+            typename image_type
+            >
+        void start_track (
+            const image_type& img,
+            const drectangle& p
+        );
+        /*!
+            requires
+                - image_type == an image object that implements the interface defined in
+                  dlib/image_processing/generic_image.h 
+                - p.is_empty() == false
+            ensures
+                - This object will start tracking the thing inside the bounding box in the
+                  given image.  That is, if you call update() with subsequent video frames 
+                  then it will try to keep track of the position of the object inside p.
+                - #get_position() == p
+        !*/
+
+        drectangle get_position (
+        ) const;
+        /*!
+            ensures
+                - returns the predicted position of the object under track.  
+        !*/
+
+        template <
+            typename image_type
+            >
+        double update_noscale (
+            const image_type& img,
+            const drectangle& guess
+        );
+        /*!
+            requires
+                - image_type == an image object that implements the interface defined in
+                  dlib/image_processing/generic_image.h 
+                - get_position().is_empty() == false
+                  (i.e. you must have started tracking by calling start_track())
+            ensures
+                - When searching for the object in img, we search in the area around the
+                  provided guess. This function only tracks object position without trying
+                  to track the scale
+                - #get_position() == the new predicted location of the object in img.  This
+                  location will be a copy of guess that has been translated and NOT scaled
+                  appropriately based on the content of img so that it, hopefully, bounds
+                  the object in img.
+                - Returns the peak to side-lobe ratio.  This is a number that measures how
+                  confident the tracker is that the object is inside #get_position().
+                  Larger values indicate higher confidence.
+        !*/
+
+        template <
+            typename image_type
+            >
+        double update (
+            const image_type& img,
+            const drectangle& guess
+        );
+        /*!
+            requires
+                - image_type == an image object that implements the interface defined in
+                  dlib/image_processing/generic_image.h 
+                - get_position().is_empty() == false
+                  (i.e. you must have started tracking by calling start_track())
+            ensures
+                - When searching for the object in img, we search in the area around the
+                  provided guess.
+                - The scale is only estimated on every get_scale_update_interval()th call.
+                - #get_position() == the new predicted location of the object in img.  This
+                  location will be a copy of guess that has been translated and scaled
+                  appropriately based on the content of img so that it, hopefully, bounds
+                  the object in img.
+                - Returns the peak to side-lobe ratio.  This is a number that measures how
+                  confident the tracker is that the object is inside #get_position().
+                  Larger values indicate higher confidence.
+        !*/
+
+        template <
+            typename image_type
+            >
+        double update_noscale (
+            const image_type& img
+        );
+        /*!
+            requires
+                - image_type == an image object that implements the interface defined in
+                  dlib/image_processing/generic_image.h 
+                - get_position().is_empty() == false
+                  (i.e. you must have started tracking by calling start_track())
+            ensures
+                - performs: return update_noscale(img, get_position())
+        !*/
+        template <
+            typename image_type
+            >
+        double update (
+            const image_type& img
+        );
+        /*!
+            requires
+                - image_type == an image object that implements the interface defined in
+                  dlib/image_processing/generic_image.h 
+                - get_position().is_empty() == false
+                  (i.e. you must have started tracking by calling start_track())
+            ensures
+                - performs: return update(img, get_position())
+        !*/
+
+    };
+}
+
+#endif // DLIB_FAST_CORRELATION_TrACKER_ABSTRACT_H_
+
+
+
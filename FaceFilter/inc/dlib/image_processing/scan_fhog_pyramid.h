@@ -323,6 +323,42 @@ namespace dlib
             nuclear_norm_regularization_strength = strength;
         }
 
+        unsigned long get_cascade_rank (
+        ) const { return cascade_rank; }
+
+        void set_cascade_rank (
+            unsigned long rank
+        )
+        {
+            // make sure requires clause is not broken
+            DLIB_ASSERT(rank <= 1 ,
+                "\t void scan_fhog_pyramid::set_cascade_rank()"
+                << "\n\t The first stage of the cascade is only cheaper than the full filter bank at rank 1."
+                << "\n\t rank: " << rank 
+                << "\n\t this: " << this
+            );
+
+            cascade_rank = rank;
+        }
+
+        double get_cascade_margin (
+        ) const { return cascade_margin; }
+
+        void set_cascade_margin (
+            double margin
+        )
+        {
+            // make sure requires clause is not broken
+            DLIB_ASSERT(margin >= 0 ,
+                "\t void scan_fhog_pyramid::set_cascade_margin()"
+                << "\n\t You can't have a negative cascade margin."
+                << "\n\t margin: " << margin 
+                << "\n\t this: " << this
+            );
+
+            cascade_margin = margin;
+        }
+
         unsigned long get_fhog_window_width (
         ) const 
         {
@@ -393,6 +429,8 @@ namespace dlib
         unsigned long min_pyramid_layer_width;
         unsigned long min_pyramid_layer_height;
         double nuclear_norm_regularization_strength;
+        unsigned long cascade_rank;
+        double cascade_margin;
 
         void init()
         {
@@ -404,6 +442,8 @@ namespace dlib
             min_pyramid_layer_width = 64;
             min_pyramid_layer_height = 64;
             nuclear_norm_regularization_strength = 0;
+            cascade_rank = 0;
+            cascade_margin = 1;
         }
 
     };
@@ -416,7 +456,8 @@ namespace dlib
         rectangle apply_filters_to_fhog (
             const fhog_filterbank& w,
             const array<array2d<float> >& feats,
-            array2d<float>& saliency_image
+            array2d<float>& saliency_image,
+            array2d<float>& scratch
         )
         {
             const unsigned long num_separable_filters = w.num_separable_filters();
@@ -434,8 +475,9 @@ namespace dlib
             }
             else
             {
-                saliency_image.clear();
-                array2d<float> scratch;
+                // Don't clear() saliency_image here.  Keeping its memory around lets
+                // callers that reuse it avoid a reallocation on every call.
+                bool first = true;
 
                 // find the first filter to apply
                 unsigned long i = 0;
@@ -446,13 +488,11 @@ namespace dlib
                 {
                     for (unsigned long j = 0; j < w.row_filters[i].size(); ++j)
                     {
-                        if (saliency_image.size() == 0)
-                            area = float_spatially_filter_image_separable(feats[i], saliency_image, w.row_filters[i][j], w.col_filters[i][j],scratch,false);
-                        else
-                            area = float_spatially_filter_image_separable(feats[i], saliency_image, w.row_filters[i][j], w.col_filters[i][j],scratch,true);
+                        area = float_spatially_filter_image_separable(feats[i], saliency_image, w.row_filters[i][j], w.col_filters[i][j],scratch,!first);
+                        first = false;
                     }
                 }
-                if (saliency_image.size() == 0)
+                if (first)
                 {
                     saliency_image.set_size(feats[0].nr(), feats[0].nc());
                     assign_all_pixels(saliency_image, 0);
@@ -460,6 +500,82 @@ namespace dlib
             }
             return area;
         }
+
+        template <typename fhog_filterbank>
+        rectangle apply_filters_to_fhog (
+            const fhog_filterbank& w,
+            const array<array2d<float> >& feats,
+            array2d<float>& saliency_image
+        )
+        {
+            array2d<float> scratch;
+            return apply_filters_to_fhog(w, feats, saliency_image, scratch);
+        }
+
+        template <typename fhog_filterbank>
+        rectangle apply_cascade_filters_to_fhog (
+            const fhog_filterbank& w,
+            const array<array2d<float> >& feats,
+            const unsigned long cascade_rank,
+            array2d<float>& saliency_image,
+            array2d<float>& scratch
+        )
+        /*!
+            ensures
+                - Computes a cheap approximation of the saliency image produced by
+                  apply_filters_to_fhog() by using only the first cascade_rank separable
+                  (rank 1) terms of each filter.  These are the terms with the largest
+                  singular values since build_fhog_filterbank() sorts them that way.
+                - returns the area of #saliency_image that contains valid filter outputs.
+        !*/
+        {
+            saliency_image.set_size(feats[0].nr(), feats[0].nc());
+            assign_all_pixels(saliency_image, 0);
+
+            for (unsigned long i = 0; i < w.row_filters.size(); ++i)
+            {
+                const unsigned long rank = std::min<unsigned long>(cascade_rank, w.row_filters[i].size());
+                for (unsigned long j = 0; j < rank; ++j)
+                    float_spatially_filter_image_separable(feats[i], saliency_image, w.row_filters[i][j], w.col_filters[i][j],scratch,true);
+            }
+
+            // The valid area depends only on the filter size, so compute it directly
+            // rather than relying on at least one separable filter having been applied.
+            const long first_row = w.filters[0].nr()/2;
+            const long first_col = w.filters[0].nc()/2;
+            const long last_row = feats[0].nr() - ((w.filters[0].nr()-1)/2);
+            const long last_col = feats[0].nc() - ((w.filters[0].nc()-1)/2);
+            return rectangle(first_col, first_row, last_col-1, last_row-1);
+        }
+
+        template <typename fhog_filterbank>
+        float score_fhog_window (
+            const fhog_filterbank& w,
+            const array<array2d<float> >& feats,
+            const long r,
+            const long c
+        )
+        /*!
+            ensures
+                - returns the exact value apply_filters_to_fhog() would produce at
+                  saliency_image[r][c], computed using only the window centered there.
+        !*/
+        {
+            float score = 0;
+            for (unsigned long i = 0; i < w.filters.size(); ++i)
+            {
+                const matrix<float>& f = w.filters[i];
+                const long top = r - f.nr()/2;
+                const long left = c - f.nc()/2;
+                for (long rr = 0; rr < f.nr(); ++rr)
+                {
+                    const float* row = &feats[i][top+rr][left];
+                    for (long cc = 0; cc < f.nc(); ++cc)
+                        score += row[cc]*f(rr,cc);
+                }
+            }
+            return score;
+        }
     }
 
 // ----------------------------------------------------------------------------------------
@@ -470,7 +586,7 @@ namespace dlib
         std::ostream& out
     )
     {
-        int version = 1;
+        int version = 2;
         serialize(version, out);
         serialize(item.fe, out);
         serialize(item.feats, out);
@@ -482,6 +598,8 @@ namespace dlib
         serialize(item.min_pyramid_layer_width, out);
         serialize(item.min_pyramid_layer_height, out);
         serialize(item.nuclear_norm_regularization_strength, out);
+        serialize(item.cascade_rank, out);
+        serialize(item.cascade_margin, out);
         serialize(item.get_num_dimensions(), out);
     }
 
@@ -495,7 +613,7 @@ namespace dlib
     {
         int version = 0;
         deserialize(version, in);
-        if (version != 1)
+        if (version != 1 && version != 2)
             throw serialization_error("Unsupported version found when deserializing a scan_fhog_pyramid object.");
 
         deserialize(item.fe, in);
@@ -508,6 +626,18 @@ namespace dlib
         deserialize(item.min_pyramid_layer_width, in);
         deserialize(item.min_pyramid_layer_height, in);
         deserialize(item.nuclear_norm_regularization_strength, in);
+        if (version == 2)
+        {
+            deserialize(item.cascade_rank, in);
+            deserialize(item.cascade_margin, in);
+            if (item.cascade_rank > 1)
+                throw serialization_error("Invalid cascade rank found when deserializing a scan_fhog_pyramid object.");
+        }
+        else
+        {
+            item.cascade_rank = 0;
+            item.cascade_margin = 1;
+        }
 
         // When developing some feature extractor, it's easy to accidentally change its
         // number of dimensions and then try to deserialize data from an older version of
@@ -612,6 +742,117 @@ namespace dlib
                 }
             }
         }
+
+        template <
+            typename feature_extractor_type,
+            typename image_type
+            >
+        void extract_fhog_level (
+            const feature_extractor_type& fe,
+            const image_type& img,
+            array<array2d<float> >& hog,
+            array2d<matrix<float,18,1> >& ,
+            array2d<float>& ,
+            int cell_size,
+            int filter_rows_padding,
+            int filter_cols_padding
+        )
+        {
+            // A user supplied feature extractor doesn't know about our scratch buffers
+            // so just call it the normal way.
+            fe(img, hog, cell_size, filter_rows_padding, filter_cols_padding);
+        }
+
+        template <
+            typename image_type
+            >
+        void extract_fhog_level (
+            const default_fhog_feature_extractor& ,
+            const image_type& img,
+            array<array2d<float> >& hog,
+            array2d<matrix<float,18,1> >& hist,
+            array2d<float>& norm,
+            int cell_size,
+            int filter_rows_padding,
+            int filter_cols_padding
+        )
+        {
+            impl_fhog::impl_extract_fhog_features(img, hog, hist, norm, cell_size, filter_rows_padding, filter_cols_padding);
+            if (hog.size() == 0)
+                hog.resize(31);
+        }
+
+        template <
+            typename pyramid_type,
+            typename image_type,
+            typename feature_extractor_type
+            >
+        void create_fhog_pyramid (
+            const image_type& img,
+            const feature_extractor_type& fe,
+            array<array<array2d<float> > >& feats,
+            array<array2d<typename image_traits<image_type>::pixel_type> >& pyramid_images,
+            array<array2d<matrix<float,18,1> > >& hists,
+            array<array2d<float> >& norms,
+            int cell_size,
+            int filter_rows_padding,
+            int filter_cols_padding,
+            unsigned long min_pyramid_layer_width,
+            unsigned long min_pyramid_layer_height,
+            unsigned long max_pyramid_levels
+        )
+        /*!
+            ensures
+                - performs the same computation as the create_fhog_pyramid() above except
+                  that every pyramid level gets its own image and scratch buffers.  Since
+                  each buffer always sees the same size when the input image size doesn't
+                  change, repeated calls do not allocate any memory after the first one.
+        !*/
+        {
+            unsigned long levels = 0;
+            rectangle rect = get_rect(img);
+
+            // figure out how many pyramid levels we should be using based on the image size
+            pyramid_type pyr;
+            do
+            {
+                rect = pyr.rect_down(rect);
+                ++levels;
+            } while (rect.width() >= min_pyramid_layer_width && rect.height() >= min_pyramid_layer_height &&
+                levels < max_pyramid_levels);
+
+            if (feats.max_size() < levels)
+                feats.set_max_size(levels);
+            feats.set_size(levels);
+            if (pyramid_images.max_size() < levels)
+                pyramid_images.set_max_size(levels);
+            pyramid_images.set_size(levels);
+            if (hists.max_size() < levels)
+                hists.set_max_size(levels);
+            hists.set_size(levels);
+            if (norms.max_size() < levels)
+                norms.set_max_size(levels);
+            norms.set_size(levels);
+
+            // build our feature pyramid.  Note that pyramid_images[0] is never used since
+            // the first level is the input image itself.
+            extract_fhog_level(fe, img, feats[0], hists[0], norms[0], cell_size,filter_rows_padding,filter_cols_padding);
+            DLIB_ASSERT(feats[0].size() == fe.get_num_planes(), 
+                "Invalid feature extractor used with dlib::scan_fhog_pyramid.  The output does not have the \n"
+                "indicated number of planes.");
+
+            if (feats.size() > 1)
+            {
+                pyr(img, pyramid_images[1]);
+                extract_fhog_level(fe, pyramid_images[1], feats[1], hists[1], norms[1], cell_size,filter_rows_padding,filter_cols_padding);
+
+                for (unsigned long i = 2; i < feats.size(); ++i)
+                {
+                    pyr(pyramid_images[i-1], pyramid_images[i]);
+                    extract_fhog_level(fe, pyramid_images[i], feats[i], hists[i], norms[i], cell_size,filter_rows_padding,filter_cols_padding);
+                }
+            }
+        }
     }
 
 // ----------------------------------------------------------------------------------------
@@ -667,6 +908,8 @@ namespace dlib
         min_pyramid_layer_width = item.min_pyramid_layer_width;
         min_pyramid_layer_height = item.min_pyramid_layer_height;
         nuclear_norm_regularization_strength = item.nuclear_norm_regularization_strength;
+        cascade_rank = item.cascade_rank;
+        cascade_margin = item.cascade_margin;
         fe = item.fe;
     }
 
@@ -773,18 +1016,61 @@ namespace dlib
             const int cell_size,
             const int filter_rows_padding,
             const int filter_cols_padding,
-            std::vector<std::pair<double, rectangle> >& dets
+            std::vector<std::pair<double, rectangle> >& dets,
+            array<array2d<float> >& saliency_images,
+            array<array2d<float> >& scratch_images,
+            const unsigned long cascade_rank = 0,
+            const double cascade_margin = 0
         ) 
+        /*!
+            requires
+                - saliency_images.size() == scratch_images.size()
+                - saliency_images.size() == 1 || saliency_images.size() == feats.size()
+            ensures
+                - When there is one buffer per pyramid level each buffer always has the
+                  same size, so no memory is reallocated when this is called repeatedly
+                  on pyramids of the same shape.
+        !*/
         {
             dets.clear();
 
-            array2d<float> saliency_image;
             pyramid_type pyr;
 
             // for all pyramid levels
             for (unsigned long l = 0; l < feats.size(); ++l)
             {
-                const rectangle area = apply_filters_to_fhog(w, feats[l], saliency_image);
+                const unsigned long b = std::min<unsigned long>(l, saliency_images.size()-1);
+                array2d<float>& saliency_image = saliency_images[b];
+                array2d<float>& scratch = scratch_images[b];
+
+                if (cascade_rank != 0)
+                {
+                    // First reject windows using the low rank approximation of the
+                    // filters and then only evaluate the full filters at the survivors.
+                    const rectangle area = apply_cascade_filters_to_fhog(w, feats[l], cascade_rank, saliency_image, scratch);
+                    const double approx_thresh = thresh - cascade_margin;
+
+                    for (long r = area.top(); r <= area.bottom(); ++r)
+                    {
+                        for (long c = area.left(); c <= area.right(); ++c)
+                        {
+                            if (saliency_image[r][c] < approx_thresh)
+                                continue;
+
+                            const double score = score_fhog_window(w, feats[l], r, c);
+                            if (score >= thresh)
+                            {
+                                rectangle rect = fe.feats_to_image(centered_rect(point(c,r),det_box_width,det_box_height), 
+                                    cell_size, filter_rows_padding, filter_cols_padding);
+                                rect = pyr.rect_up(rect, l);
+                                dets.push_back(std::make_pair(score, rect));
+                            }
+                        }
+                    }
+                    continue;
+                }
+
+                const rectangle area = apply_filters_to_fhog(w, feats[l], saliency_image, scratch);
 
                 // now search the saliency image for any detections
                 for (long r = area.top(); r <= area.bottom(); ++r)
@@ -806,6 +1092,32 @@ namespace dlib
             std::sort(dets.rbegin(), dets.rend(), compare_pair_rect);
         }
 
+        template <
+            typename pyramid_type,
+            typename feature_extractor_type,
+            typename fhog_filterbank
+            >
+        void detect_from_fhog_pyramid (
+            const array<array<array2d<float> > >& feats,
+            const feature_extractor_type& fe,
+            const fhog_filterbank& w,
+            const double thresh,
+            const unsigned long det_box_height,
+            const unsigned long det_box_width,
+            const int cell_size,
+            const int filter_rows_padding,
+            const int filter_cols_padding,
+            std::vector<std::pair<double, rectangle> >& dets,
+            const unsigned long cascade_rank = 0,
+            const double cascade_margin = 0
+        ) 
+        {
+            array<array2d<float> > saliency_images(1), scratch_images(1);
+            detect_from_fhog_pyramid<pyramid_type>(feats, fe, w, thresh, det_box_height,
+                det_box_width, cell_size, filter_rows_padding, filter_cols_padding, dets,
+                saliency_images, scratch_images, cascade_rank, cascade_margin);
+        }
+
         inline bool overlaps_any_box (
             const test_box_overlap& tester,
             const std::vector<rect_detection>& rects,
@@ -852,7 +1164,8 @@ namespace dlib
         compute_fhog_window_size(width,height);
 
         impl::detect_from_fhog_pyramid<pyramid_type>(feats, fe, w, thresh,
-            height-2*padding, width-2*padding, cell_size, height, width, dets);
+            height-2*padding, width-2*padding, cell_size, height, width, dets,
+            cascade_rank, cascade_margin);
     }
 
 // ----------------------------------------------------------------------------------------
@@ -1217,105 +1530,210 @@ namespace dlib
 // ----------------------------------------------------------------------------------------
 
     template <
-        typename pyramid_type,
-        typename image_type
+        typename pixel_type
         >
-    void evaluate_detectors (
-        const std::vector<object_detector<scan_fhog_pyramid<pyramid_type> > >& detectors,
-        const image_type& img,
-        std::vector<rect_detection>& dets,
-        const double adjust_threshold = 0
-    )
+    class fhog_detection_workspace : noncopyable
     {
-        typedef scan_fhog_pyramid<pyramid_type> scanner_type;
-
-        dets.clear();
-        if (detectors.size() == 0)
-            return;
-
-        const unsigned long cell_size = detectors[0].get_scanner().get_cell_size();
+    public:
 
-        // Find the maximum sized filters and also most extreme pyramiding settings used.
-        unsigned long max_filter_width = 0;
-        unsigned long max_filter_height = 0;
-        unsigned long min_pyramid_layer_width = std::numeric_limits<unsigned long>::max();
-        unsigned long min_pyramid_layer_height = std::numeric_limits<unsigned long>::max();
-        unsigned long max_pyramid_levels = 0;
-        bool all_cell_sizes_the_same = true;
-        for (unsigned long i = 0; i < detectors.size(); ++i)
+        void clear (
+        )
         {
-            const scanner_type& scanner = detectors[i].get_scanner();
-            max_filter_width = std::max(max_filter_width, scanner.get_fhog_window_width());
-            max_filter_height = std::max(max_filter_height, scanner.get_fhog_window_height());
-            max_pyramid_levels = std::max(max_pyramid_levels, scanner.get_max_pyramid_levels());
-            min_pyramid_layer_width = std::min(min_pyramid_layer_width, scanner.get_min_pyramid_layer_width());
-            min_pyramid_layer_height = std::min(min_pyramid_layer_height, scanner.get_min_pyramid_layer_height());
-            if (cell_size != scanner.get_cell_size())
-                all_cell_sizes_the_same = false;
+            feats.clear();
+            pyramid_images.clear();
+            hists.clear();
+            norms.clear();
+            saliency_images.clear();
+            scratch_images.clear();
+            temp_dets.clear();
+            dets_accum.clear();
         }
 
-        std::vector<rect_detection> dets_accum;
-        // Do to the HOG feature extraction to make the fhog pyramid.  Again, note that we
-        // are making a pyramid that will work with any of the detectors.  But only if all
-        // the cell sizes are the same.  If they aren't then we have to calculate the
-        // pyramid for each detector individually.
+        // Everything below is used by evaluate_detectors() and should be treated as
+        // opaque by users of this object.
         array<array<array2d<float> > > feats;
-        if (all_cell_sizes_the_same)
-        {
-            impl::create_fhog_pyramid<pyramid_type>(img,
-                detectors[0].get_scanner().get_feature_extractor(), feats, cell_size,
-                max_filter_height, max_filter_width, min_pyramid_layer_width,
-                min_pyramid_layer_height, max_pyramid_levels);
-        }
-
+        array<array2d<pixel_type> > pyramid_images;
+        array<array2d<matrix<float,18,1> > > hists;
+        array<array2d<float> > norms;
+        array<array2d<float> > saliency_images;
+        array<array2d<float> > scratch_images;
         std::vector<std::pair<double, rectangle> > temp_dets;
-        for (unsigned long i = 0; i < detectors.size(); ++i)
+        std::vector<rect_detection> dets_accum;
+    };
+
+// ----------------------------------------------------------------------------------------
+
+    namespace impl
+    {
+        template <
+            typename pyramid_type,
+            typename image_type
+            >
+        void evaluate_detectors (
+            const object_detector<scan_fhog_pyramid<pyramid_type> >* detectors,
+            const unsigned long num_detectors,
+            const image_type& img,
+            std::vector<rect_detection>& dets,
+            fhog_detection_workspace<typename image_traits<image_type>::pixel_type>& ws,
+            const double adjust_threshold
+        )
         {
-            const scanner_type& scanner = detectors[i].get_scanner();
-            if (!all_cell_sizes_the_same)
+            typedef scan_fhog_pyramid<pyramid_type> scanner_type;
+
+            dets.clear();
+            if (num_detectors == 0)
+                return;
+
+            const unsigned long cell_size = detectors[0].get_scanner().get_cell_size();
+
+            // Find the maximum sized filters and also most extreme pyramiding settings used.
+            unsigned long max_filter_width = 0;
+            unsigned long max_filter_height = 0;
+            unsigned long min_pyramid_layer_width = std::numeric_limits<unsigned long>::max();
+            unsigned long min_pyramid_layer_height = std::numeric_limits<unsigned long>::max();
+            unsigned long max_pyramid_levels = 0;
+            bool all_cell_sizes_the_same = true;
+            for (unsigned long i = 0; i < num_detectors; ++i)
+            {
+                const scanner_type& scanner = detectors[i].get_scanner();
+                max_filter_width = std::max(max_filter_width, scanner.get_fhog_window_width());
+                max_filter_height = std::max(max_filter_height, scanner.get_fhog_window_height());
+                max_pyramid_levels = std::max(max_pyramid_levels, scanner.get_max_pyramid_levels());
+                min_pyramid_layer_width = std::min(min_pyramid_layer_width, scanner.get_min_pyramid_layer_width());
+                min_pyramid_layer_height = std::min(min_pyramid_layer_height, scanner.get_min_pyramid_layer_height());
+                if (cell_size != scanner.get_cell_size())
+                    all_cell_sizes_the_same = false;
+            }
+
+            std::vector<rect_detection>& dets_accum = ws.dets_accum;
+            dets_accum.clear();
+            // Do to the HOG feature extraction to make the fhog pyramid.  Again, note that we
+            // are making a pyramid that will work with any of the detectors.  But only if all
+            // the cell sizes are the same.  If they aren't then we have to calculate the
+            // pyramid for each detector individually.
+            array<array<array2d<float> > >& feats = ws.feats;
+            if (all_cell_sizes_the_same)
             {
-                impl::create_fhog_pyramid<pyramid_type>(img,
-                    scanner.get_feature_extractor(), feats, scanner.get_cell_size(),
+                create_fhog_pyramid<pyramid_type>(img,
+                    detectors[0].get_scanner().get_feature_extractor(), feats,
+                    ws.pyramid_images, ws.hists, ws.norms, cell_size,
                     max_filter_height, max_filter_width, min_pyramid_layer_width,
                     min_pyramid_layer_height, max_pyramid_levels);
             }
 
-            const unsigned long det_box_width  = scanner.get_fhog_window_width()  - 2*scanner.get_padding();
-            const unsigned long det_box_height = scanner.get_fhog_window_height() - 2*scanner.get_padding();
-            // A single detector object might itself have multiple weight vectors in it. So
-            // we need to evaluate all of them.
-            for (unsigned d = 0; d < detectors[i].num_detectors(); ++d)
+            std::vector<std::pair<double, rectangle> >& temp_dets = ws.temp_dets;
+            if (ws.saliency_images.max_size() < feats.size())
+                ws.saliency_images.set_max_size(feats.size());
+            ws.saliency_images.set_size(feats.size());
+            if (ws.scratch_images.max_size() < feats.size())
+                ws.scratch_images.set_max_size(feats.size());
+            ws.scratch_images.set_size(feats.size());
+            for (unsigned long i = 0; i < num_detectors; ++i)
             {
-                const double thresh = detectors[i].get_processed_w(d).w(scanner.get_num_dimensions());
-
-                impl::detect_from_fhog_pyramid<pyramid_type>(feats, scanner.get_feature_extractor(),
-                    detectors[i].get_processed_w(d).get_detect_argument(), thresh+adjust_threshold,
-                    det_box_height, det_box_width, cell_size, max_filter_height,
-                    max_filter_width, temp_dets);
+                const scanner_type& scanner = detectors[i].get_scanner();
+                if (!all_cell_sizes_the_same)
+                {
+                    create_fhog_pyramid<pyramid_type>(img,
+                        scanner.get_feature_extractor(), feats, ws.pyramid_images,
+                        ws.hists, ws.norms, scanner.get_cell_size(),
+                        max_filter_height, max_filter_width, min_pyramid_layer_width,
+                        min_pyramid_layer_height, max_pyramid_levels);
+                }
 
-                for (unsigned long j = 0; j < temp_dets.size(); ++j)
+                const unsigned long det_box_width  = scanner.get_fhog_window_width()  - 2*scanner.get_padding();
+                const unsigned long det_box_height = scanner.get_fhog_window_height() - 2*scanner.get_padding();
+                // A single detector object might itself have multiple weight vectors in it. So
+                // we need to evaluate all of them.
+                for (unsigned d = 0; d < detectors[i].num_detectors(); ++d)
                 {
-                    rect_detection temp;
-                    temp.detection_confidence = temp_dets[j].first-thresh;
-                    temp.weight_index = i;
-                    temp.rect = temp_dets[j].second;
-                    dets_accum.push_back(temp);
+                    const double thresh = detectors[i].get_processed_w(d).w(scanner.get_num_dimensions());
+
+                    detect_from_fhog_pyramid<pyramid_type>(feats, scanner.get_feature_extractor(),
+                        detectors[i].get_processed_w(d).get_detect_argument(), thresh+adjust_threshold,
+                        det_box_height, det_box_width, cell_size, max_filter_height,
+                        max_filter_width, temp_dets, ws.saliency_images, ws.scratch_images,
+                        scanner.get_cascade_rank(), scanner.get_cascade_margin());
+
+                    for (unsigned long j = 0; j < temp_dets.size(); ++j)
+                    {
+                        rect_detection temp;
+                        temp.detection_confidence = temp_dets[j].first-thresh;
+                        temp.weight_index = i;
+                        temp.rect = temp_dets[j].second;
+                        dets_accum.push_back(temp);
+                    }
                 }
             }
+
+
+            // Do non-max suppression
+            if (num_detectors > 1)
+                std::sort(dets_accum.rbegin(), dets_accum.rend());
+            for (unsigned long i = 0; i < dets_accum.size(); ++i)
+            {
+                const test_box_overlap tester = detectors[dets_accum[i].weight_index].get_overlap_tester();
+                if (overlaps_any_box(tester, dets, dets_accum[i]))
+                    continue;
+
+                dets.push_back(dets_accum[i]);
+            }
         }
+    }
 
+// ----------------------------------------------------------------------------------------
 
-        // Do non-max suppression
-        if (detectors.size() > 1)
-            std::sort(dets_accum.rbegin(), dets_accum.rend());
-        for (unsigned long i = 0; i < dets_accum.size(); ++i)
+    template <
+        typename pyramid_type,
+        typename image_type
+        >
+    void evaluate_detectors (
+        const std::vector<object_detector<scan_fhog_pyramid<pyramid_type> > >& detectors,
+        const image_type& img,
+        std::vector<rect_detection>& dets,
+        fhog_detection_workspace<typename image_traits<image_type>::pixel_type>& workspace,
+        const double adjust_threshold = 0
+    )
+    {
+        if (detectors.size() == 0)
         {
-            const test_box_overlap tester = detectors[dets_accum[i].weight_index].get_overlap_tester();
-            if (impl::overlaps_any_box(tester, dets, dets_accum[i]))
-                continue;
-
-            dets.push_back(dets_accum[i]);
+            dets.clear();
+            return;
         }
+        impl::evaluate_detectors(&detectors[0], detectors.size(), img, dets, workspace, adjust_threshold);
+    }
+
+// ----------------------------------------------------------------------------------------
+
+    template <
+        typename pyramid_type,
+        typename image_type
+        >
+    void evaluate_detectors (
+        const object_detector<scan_fhog_pyramid<pyramid_type> >& detector,
+        const image_type& img,
+        std::vector<rect_detection>& dets,
+        fhog_detection_workspace<typename image_traits<image_type>::pixel_type>& workspace,
+        const double adjust_threshold = 0
+    )
+    {
+        impl::evaluate_detectors(&detector, 1, img, dets, workspace, adjust_threshold);
+    }
+
+// ----------------------------------------------------------------------------------------
+
+    template <
+        typename pyramid_type,
+        typename image_type
+        >
+    void evaluate_detectors (
+        const std::vector<object_detector<scan_fhog_pyramid<pyramid_type> > >& detectors,
+        const image_type& img,
+        std::vector<rect_detection>& dets,
+        const double adjust_threshold = 0
+    )
+    {
+        fhog_detection_workspace<typename image_traits<image_type>::pixel_type> workspace;
+        evaluate_detectors(detectors, img, dets, workspace, adjust_threshold);
     }
 
 // ----------------------------------------------------------------------------------------
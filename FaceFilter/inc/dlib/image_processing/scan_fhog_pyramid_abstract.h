@@ -218,6 +218,8 @@ namespace dlib
                 - get_min_pyramid_layer_width()  == 64
                 - get_min_pyramid_layer_height() == 64
                 - get_nuclear_norm_regularization_strength() == 0
+                - get_cascade_rank() == 0
+                - get_cascade_margin() == 1
 
             WHAT THIS OBJECT REPRESENTS
                 This object is a tool for running a fixed sized sliding window classifier
@@ -672,6 +674,63 @@ namespace dlib
                 - #get_nuclear_norm_regularization_strength() == strength
         !*/
 
+        unsigned long get_cascade_rank (
+        ) const;
+        /*!
+            ensures
+                - if (get_cascade_rank() == 0) then
+                    - detect() evaluates the full filter bank at every location in every
+                      layer of the HOG pyramid.  This is the default behavior.
+                - else
+                    - detect() runs a two stage cascade.  First, every location is scored
+                      using only the get_cascade_rank() largest separable (rank 1)
+                      components of each filter in the filter bank.  Then only the
+                      locations whose approximate score is >= thresh-get_cascade_margin()
+                      are scored with the full filter bank and reported if that exact
+                      score is >= thresh.  Since the approximate pass is much cheaper than
+                      the full pass this can make detect() a lot faster, at the risk of
+                      missing detections whose approximate score was too pessimistic.
+                - get_cascade_rank() <= 1.  The filters build_fhog_filterbank() makes
+                  from a trained detector have about 2 separable components each (the
+                  frontal face detector has 54 to 66 over its 31 filters), so a first
+                  stage of rank 2 already costs about as much as the full filter bank,
+                  and the second stage then only adds to it.  At rank 1 the first stage
+                  is about half the cost of the full bank.  Whatever recall rank 2 or
+                  more would buy, a larger get_cascade_margin() buys more cheaply.
+        !*/
+
+        void set_cascade_rank (
+            unsigned long rank
+        );
+        /*!
+            requires
+                - rank <= 1
+            ensures
+                - #get_cascade_rank() == rank
+        !*/
+
+        double get_cascade_margin (
+        ) const;
+        /*!
+            ensures
+                - returns the amount by which the approximate score computed in the first
+                  stage of the detection cascade may fall below the detection threshold
+                  while still being passed on to the second stage.  This is the knob that
+                  trades recall for speed.  Larger values miss fewer detections but send
+                  more windows to the expensive second stage.  Note that this value is
+                  only used when get_cascade_rank() != 0.
+        !*/
+
+        void set_cascade_margin (
+            double margin
+        );
+        /*!
+            requires
+                - margin >= 0
+            ensures
+                - #get_cascade_margin() == margin
+        !*/
+
     };
 
 // ----------------------------------------------------------------------------------------
@@ -750,6 +809,102 @@ namespace dlib
               requiring a mutex lock.
     !*/
 
+// ----------------------------------------------------------------------------------------
+
+    template <
+        typename pixel_type
+        >
+    class fhog_detection_workspace : noncopyable
+    {
+        /*!
+            WHAT THIS OBJECT REPRESENTS
+                This object holds all the buffers evaluate_detectors() needs to run an
+                fHOG detector over an image.  That is, the HOG feature pyramid, one
+                downsampled image per pyramid level, the scratch space used by the HOG
+                feature extractor and the saliency images produced by the filter bank.
+                Every pyramid level gets its own buffers, so when the same workspace is
+                used to process a stream of images that all have the same size (e.g.
+                frames from a video camera) no memory is allocated after the first
+                image.
+
+                pixel_type must be the pixel type of the images given to
+                evaluate_detectors() along with this workspace.  The contents of this
+                object are an implementation detail of evaluate_detectors().
+
+            THREAD SAFETY
+                A workspace may only be used by one call to evaluate_detectors() at a
+                time.  Give each thread its own workspace.
+        !*/
+    public:
+
+        void clear (
+        );
+        /*!
+            ensures
+                - releases all the memory held by this object.
+        !*/
+    };
+
+// ----------------------------------------------------------------------------------------
+
+    template <
+        typename pyramid_type,
+        typename image_type
+        >
+    void evaluate_detectors (
+        const std::vector<object_detector<scan_fhog_pyramid<pyramid_type>>>& detectors,
+        const image_type& img,
+        std::vector<rect_detection>& dets,
+        fhog_detection_workspace<typename image_traits<image_type>::pixel_type>& workspace,
+        const double adjust_threshold = 0
+    );
+    /*!
+        requires
+            - image_type == is an implementation of array2d/array2d_kernel_abstract.h
+            - img contains some kind of pixel type. 
+              (i.e. pixel_traits<typename image_type::type> is defined)
+        ensures
+            - Performs exactly the same computation as the evaluate_detectors() routine
+              defined above.  However, all the intermediate buffers live in workspace
+              rather than being created anew on each call.  So if you call this function
+              repeatedly with images of the same size and the same workspace then, once
+              the first call has sized the buffers, no further heap allocations are made
+              (beyond growing #dets should it see more detections than ever before).
+              This is only true when all the detectors use the default fHOG feature
+              extractor and a cell size larger than 1.
+            - #dets has the same contents as it would for the evaluate_detectors()
+              routine defined above.
+            - This function is threadsafe in the sense that multiple threads can call it
+              with the same instances of detectors and img without requiring a mutex lock
+              as long as each thread uses its own workspace.
+    !*/
+
+// ----------------------------------------------------------------------------------------
+
+    template <
+        typename pyramid_type,
+        typename image_type
+        >
+    void evaluate_detectors (
+        const object_detector<scan_fhog_pyramid<pyramid_type>>& detector,
+        const image_type& img,
+        std::vector<rect_detection>& dets,
+        fhog_detection_workspace<typename image_traits<image_type>::pixel_type>& workspace,
+        const double adjust_threshold = 0
+    );
+    /*!
+        requires
+            - image_type == is an implementation of array2d/array2d_kernel_abstract.h
+            - img contains some kind of pixel type. 
+              (i.e. pixel_traits<typename image_type::type> is defined)
+        ensures
+            - This function is identical to the above evaluate_detectors() routine except
+              that it runs a single detector.  So you can use it to run, for example, the
+              frontal_face_detector over each frame of a video without putting the
+              detector into a std::vector.  The results are the same as calling
+              detector(img, dets, adjust_threshold).
+    !*/
+
 // ----------------------------------------------------------------------------------------
 
     template <
@@ -702,6 +702,8 @@ namespace dlib
         void impl_extract_fhog_features(
             const image_type& img_, 
             out_type& hog, 
+            array2d<matrix<float,18,1> >& hist,
+            array2d<float>& norm,
             int cell_size,
             int filter_rows_padding,
             int filter_cols_padding
@@ -790,7 +792,7 @@ namespace dlib
             // edge) so we can avoid needing to do boundary checks when indexing into it
             // later on.  So some statements assign to the boundary but those values are
             // never used.
-            array2d<matrix<float,18,1> > hist(cells_nr+2, cells_nc+2);
+            hist.set_size(cells_nr+2, cells_nc+2);
             for (long r = 0; r < hist.nr(); ++r)
             {
                 for (long c = 0; c < hist.nc(); ++c)
@@ -799,7 +801,7 @@ namespace dlib
                 }
             }
 
-            array2d<float> norm(cells_nr, cells_nc);
+            norm.set_size(cells_nr, cells_nc);
             assign_all_pixels(norm, 0);
 
             // memory for HOG features
@@ -1045,6 +1047,23 @@ namespace dlib
             }
         }
 
+        template <
+            typename image_type, 
+            typename out_type
+            >
+        void impl_extract_fhog_features(
+            const image_type& img, 
+            out_type& hog, 
+            int cell_size,
+            int filter_rows_padding,
+            int filter_cols_padding
+        ) 
+        {
+            array2d<matrix<float,18,1> > hist;
+            array2d<float> norm;
+            impl_extract_fhog_features(img, hog, hist, norm, cell_size, filter_rows_padding, filter_cols_padding);
+        }
+
     // ------------------------------------------------------------------------------------
 
         inline void create_fhog_bar_images (
@@ -0,0 +1,43 @@
+/*
+ * draw_list.h
+ *
+ *  Collects the stickers of every face for a frame, then paints them all in
+ *  one sweep over the frame, band of rows by band of rows, so rows shared by
+ *  several faces or stacked stickers are brought into the cache once.
+ */
+
+#ifndef DRAW_LIST_H_
+#define DRAW_LIST_H_
+
+#include <vector>
+#include <dlib/threads.h>
+#include "nv12_compositor.h"
+#include "sticker_warp.h"
+#include "dirty_region.h"
+
+/* Rows painted together, even so a band never splits a chroma row. */
+#define DRAW_BAND_ROWS 32
+#define MAX_DRAWS 64
+
+typedef struct _drawcmd {
+	const nv12sticker* nv12; /* blended as is, NULL for a warped sticker */
+	int cx, cy; /* center of nv12 on the frame */
+	warpdraw warp; /* placement of a warped sticker */
+	int left, right; /* columns touched, even */
+	int top, bottom; /* rows touched, even */
+} drawcmd;
+
+typedef struct _drawlist {
+	std::vector<drawcmd> draws; /* in painting order */
+	dlib::thread_pool* pool; /* paints the bands, NULL to paint them in turn */
+} drawlist;
+
+void draw_list_init(drawlist* dl, unsigned long num_threads);
+void draw_list_release(drawlist* dl);
+void draw_list_clear(drawlist* dl);
+void draw_list_add_nv12(drawlist* dl, int width, int height, const nv12sticker* st, int cx, int cy);
+void draw_list_add_warp(drawlist* dl, int width, int height, const sticker* st, const sticker* base, const stickerlayout* layout, const dlib::full_object_detection& shape);
+void draw_list_paint(drawlist* dl, unsigned char* y, unsigned char* uv, int width, int height);
+void draw_list_mark(const drawlist* dl, dirtylist* dirty);
+
+#endif /* DRAW_LIST_H_ */
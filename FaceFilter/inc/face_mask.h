@@ -0,0 +1,35 @@
+/*
+ * face_mask.h
+ *
+ *  Rasterizes the face outline given by the landmarks into an antialiased
+ *  coverage mask, at the luma and at the chroma resolution of the frame,
+ *  for effects that only apply to the face.
+ */
+
+#ifndef FACE_MASK_H_
+#define FACE_MASK_H_
+
+#include <vector>
+#include <dlib/image_processing.h>
+
+/* The jaw line, closed by the eyebrows. */
+#define FACE_MASK_OUTLINE 0
+/* The convex hull of every landmark. */
+#define FACE_MASK_HULL 1
+
+/* Scanlines sampled per row, the horizontal coverage is exact. */
+#define FACE_MASK_SUBSAMPLES 4
+
+typedef struct _facemask {
+	int left, top; /* position of the mask on the frame, even */
+	int width, height; /* size of the luma mask, even, 0 if the face is off the frame */
+	std::vector<unsigned char> y; /* coverage of every luma pixel, 255 inside, width * height */
+	std::vector<unsigned char> uv; /* coverage of every chroma sample, width / 2 * height / 2 */
+	std::vector<int> cover; /* coverage changes along the row being rasterized */
+} facemask;
+
+bool face_mask_build(facemask* fm, const dlib::full_object_detection& shape, int kind, int frame_width, int frame_height);
+bool face_mask_union(facemask* fm, const facemask* masks, int count, int left, int top,
+		int right, int bottom);
+
+#endif /* FACE_MASK_H_ */
@@ -0,0 +1,50 @@
+/*
+ * face_tracker.h
+ *
+ *  Keeps one correlation tracker per face alive between camera face
+ *  detections so landmarks can be fitted on every preview frame.
+ */
+
+#ifndef FACE_TRACKER_H_
+#define FACE_TRACKER_H_
+
+#include <thread>
+#include <vector>
+#include <dlib/image_processing.h>
+#include <dlib/matrix.h>
+#include <dlib/threads.h>
+
+/* Tracks whose peak-to-sidelobe ratio falls below this are dropped. */
+#define TRACK_MIN_PSR 5.0
+/* A detection matches a track if they overlap at least this much, */
+#define TRACK_MATCH_IOU 0.3
+/* or if their centers are closer than this fraction of the detection width. */
+#define TRACK_MATCH_DIST 0.5
+/* A matched track overlapping its detection less than this is re-acquired. */
+#define TRACK_REACQUIRE_IOU 0.6
+#define MAX_TRACKS 10
+
+typedef struct _facetrack {
+	dlib::fast_correlation_tracker tracker;
+	dlib::rectangle box; /* position after the last update */
+	double psr; /* confidence returned by the last update */
+	unsigned long id; /* stays the same for the lifetime of the track */
+} facetrack;
+
+typedef struct _trackdata {
+	std::vector<facetrack> tracks;
+	std::vector<dlib::rectangle> detections; /* waiting to be merged */
+	bool has_detections;
+	dlib::mutex detections_lock;
+	dlib::thread_pool* pool;
+	dlib::matrix<long> cost; /* detection to track association scores */
+	double min_psr;
+	unsigned long next_id;
+} trackdata;
+
+void face_tracker_init(trackdata* td, unsigned long num_threads);
+void face_tracker_release(trackdata* td);
+void face_tracker_set_detections(trackdata* td, const std::vector<dlib::rectangle>& faces);
+void face_tracker_update(trackdata* td, const dlib::array2d<unsigned char>& img, std::vector<dlib::rectangle>& faces, std::vector<unsigned long>& ids);
+
+#endif /* FACE_TRACKER_H_ */
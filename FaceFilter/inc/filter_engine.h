@@ -0,0 +1,76 @@
+/*
+ * filter_engine.h
+ *
+ *  Runs a chain of filters over one plane of a frame in a single sweep.
+ *  Every row goes through all the stages while it is still in the cache,
+ *  and a stage that needs rows above and below keeps only those in a small
+ *  ring of rows, allocated once, so a frame costs no heap traffic at all.
+ *  Strips of rows are filtered on a thread pool, each with its own rings.
+ *  Point operations in a row are composed into one lookup table while the
+ *  chain is built, so any number of them costs a single table lookup.
+ *  The cartoon stages do a whole effect in one sweep of each plane: ink
+ *  lines over a posterized luma, and median filtered chroma.
+ */
+
+#ifndef FILTER_ENGINE_H_
+#define FILTER_ENGINE_H_
+
+#include <vector>
+#include <dlib/threads.h>
+#include "convolution.h"
+
+#define MAX_FILTER_STAGES 6
+/* Rows of context a stage may ask for above and below the row it filters. */
+#define FILTER_MAX_RADIUS CONV_MAX_RADIUS
+/* Strips of rows a plane is cut into for every thread, and their least height. */
+#define FILTER_STRIPS_PER_THREAD 2
+#define FILTER_MIN_STRIP_ROWS 32
+#define FILTER_MAX_STRIPS 64
+/* Luma of the ink lines of a cartoon stage, black. */
+#define FILTER_INK 16
+
+typedef struct _filterstage filterstage;
+
+/*
+ * Filters one row. rows holds the 2 * radius + 1 input rows centered on it,
+ * the edge rows repeated past the top and bottom, and padded as
+ * conv_pad_row() pads them. out may be rows[0] when the radius is 0. temp
+ * is room for width + 2 * CONV_PAD shorts.
+ */
+typedef void (*filter_row_fn)(const filterstage* stage, const unsigned char* const* rows,
+		unsigned char* out, int width, int step, short* temp);
+
+struct _filterstage {
+	filter_row_fn run;
+	int radius; /* rows of context above and below, 0 for a point operation */
+	convkernel conv; /* kernel of a convolution */
+	unsigned char lut[2][256]; /* point operation of the even and odd bytes: Cb and Cr in a chroma chain */
+	int threshold; /* Sobel magnitude inked by a cartoon stage */
+};
+
+typedef struct _filterchain {
+	filterstage stages[MAX_FILTER_STAGES]; /* applied in order */
+	int count;
+	int step; /* bytes between horizontal neighbours: 1 for luma, 2 for interleaved chroma */
+} filterchain;
+
+typedef struct _filterengine {
+	std::vector<unsigned char> rows; /* for every strip: ring, output row and temp row of every stage with a radius, then the halo */
+	dlib::thread_pool* pool; /* filters the strips, NULL to filter them in turn */
+} filterengine;
+
+void filter_chain_init(filterchain* fc, int step);
+bool filter_chain_add_invert(filterchain* fc);
+bool filter_chain_add_chroma(filterchain* fc, int u, int v);
+bool filter_chain_add_pinky(filterchain* fc);
+bool filter_chain_add_kernel(filterchain* fc, const int* k, int size, int shift);
+bool filter_chain_add_separable(filterchain* fc, const int* col, const int* row, int size, int shift);
+bool filter_chain_add_cartoon(filterchain* fc, int levels, int threshold);
+bool filter_chain_add_median(filterchain* fc);
+
+void filter_engine_init(filterengine* fe, unsigned long num_threads);
+void filter_engine_release(filterengine* fe);
+void filter_engine_run(filterengine* fe, const filterchain* fc, unsigned char* plane, int width, int height,
+		int stride);
+
+#endif /* FILTER_ENGINE_H_ */
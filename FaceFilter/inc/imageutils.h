@@ -11,18 +11,9 @@
 #include <image_util.h>
 #include <storage.h>
 #include <camera.h>
+#include "sticker_atlas.h"
 
-typedef struct _imageinfo{
-	unsigned char* data;
-	int size;
-	int width;
-	int height;
-	int error;
-}imageinfo;
-
-void _image_util_imgcpy(camera_preview_data_s* frame, imageinfo* imginfo, int p, int q);
-
-void _image_util_start_cb(imageinfo* imginfo);
+bool _image_util_decode_sticker(const char* path, dlib::array2d<dlib::rgb_alpha_pixel>& img);
 
 const char *_map_colorspace(image_util_colorspace_e color_space);
 
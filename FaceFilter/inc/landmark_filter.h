@@ -0,0 +1,40 @@
+/*
+ * landmark_filter.h
+ *
+ *  Smooths the landmarks of one face over time and extrapolates them to the
+ *  moment a frame is displayed.
+ */
+
+#ifndef LANDMARK_FILTER_H_
+#define LANDMARK_FILTER_H_
+
+#include <vector>
+#include <dlib/filtering.h>
+#include <dlib/image_processing.h>
+
+/* Acceleration noise of a landmark, in px^2/s^3. Higher follows fast motion better. */
+#define LMF_PROCESS_NOISE 20000.0
+/* Standard deviation of the shape predictor output, in px. Higher smooths more. */
+#define LMF_MEASUREMENT_NOISE 2.0
+/* Frame interval assumed when the timestamps do not give one, in ms. */
+#define LMF_DEFAULT_DT 33
+/* Longest time the landmarks are extrapolated past their frame, in ms. */
+#define LMF_MAX_LEAD 100
+
+typedef struct _lmfilter {
+	std::vector<dlib::kalman_filter<4, 2> > points; /* state: x, y, vx, vy */
+	dlib::rectangle rect; /* face box of the last measurement */
+	unsigned long id; /* face track the filter belongs to */
+	unsigned int time; /* timestamp of the last measurement, in ms */
+	double process_noise;
+	double measurement_noise;
+} lmfilter;
+
+void landmark_filter_init(lmfilter* f, unsigned long id, double process_noise, double measurement_noise);
+void landmark_filter_update(lmfilter* f, const dlib::full_object_detection& shape, unsigned int time);
+void landmark_filter_predict(const lmfilter* f, unsigned int time, dlib::full_object_detection& shape);
+
+lmfilter* landmark_filter_find(std::vector<lmfilter>& filters, unsigned long id);
+void landmark_filter_prune(std::vector<lmfilter>& filters, const std::vector<unsigned long>& ids);
+
+#endif /* LANDMARK_FILTER_H_ */
@@ -0,0 +1,55 @@
+/*
+ * landmark_flow.h
+ *
+ *  Follows the landmarks from frame to frame with pyramidal Lucas-Kanade
+ *  optical flow, so the shape predictor only has to run every few frames.
+ */
+
+#ifndef LANDMARK_FLOW_H_
+#define LANDMARK_FLOW_H_
+
+#include <vector>
+#include <dlib/array.h>
+#include <dlib/array2d.h>
+#include <dlib/image_processing.h>
+
+#define FLOW_LEVELS 3
+/* Window side, in pixels. Must be a multiple of 4. */
+#define FLOW_WIN 12
+#define FLOW_MAX_ITER 10
+/* Iterations stop once the update is smaller than this, in pixels. */
+#define FLOW_EPS 0.03f
+/* Residual reported for points that could not be tracked. */
+#define FLOW_LOST 255.0f
+
+/* A point whose mean absolute error is above this, in grey levels, is lost. */
+#define FLOW_MAX_RESIDUAL 6.0f
+
+/* Run the shape predictor at least every FLOW_REFIT_INTERVAL frames, */
+#define FLOW_REFIT_INTERVAL 5
+/* or as soon as this fraction of the points of a face is lost. */
+#define FLOW_MAX_LOST 0.1
+
+typedef struct _flowdata {
+	dlib::array<dlib::array2d<float> > prev; /* pyramid of the previous frame */
+	dlib::array<dlib::array2d<float> > cur; /* pyramid of the current frame */
+	bool has_prev;
+} flowdata;
+
+typedef struct _flowtrack {
+	unsigned long id; /* face track the landmarks belong to */
+	dlib::full_object_detection shape; /* landmarks on the current frame */
+	std::vector<dlib::vector<double, 2> > points; /* same, with sub-pixel precision */
+	std::vector<float> residuals; /* per point error of the last flow step */
+	int frames_since_fit; /* frames since the shape predictor last ran */
+} flowtrack;
+
+void landmark_flow_push_frame(flowdata* fd, const dlib::array2d<unsigned char>& img);
+double landmark_flow_track(const flowdata* fd, flowtrack* ft);
+bool landmark_flow_need_fit(const flowtrack* ft, const dlib::rectangle& face);
+void landmark_flow_set_shape(flowtrack* ft, const dlib::full_object_detection& shape);
+
+flowtrack* landmark_flow_find(std::vector<flowtrack>& tracks, unsigned long id);
+void landmark_flow_prune(std::vector<flowtrack>& tracks, const std::vector<unsigned long>& ids);
+
+#endif /* LANDMARK_FLOW_H_ */
@@ -0,0 +1,31 @@
+/*
+ * nv12_compositor.h
+ *
+ *  Blends premultiplied stickers straight into the NV12 preview frame, so
+ *  the frame never has to be converted to RGB and back.
+ */
+
+#ifndef NV12_COMPOSITOR_H_
+#define NV12_COMPOSITOR_H_
+
+#include <vector>
+#include <dlib/pixel.h>
+
+typedef struct _nv12sticker {
+	int width; /* in frame orientation, always even */
+	int height; /* in frame orientation, always even */
+	const unsigned char* y; /* premultiplied luma, width * height */
+	const unsigned char* ya; /* alpha of every luma sample */
+	const unsigned char* uv; /* premultiplied interleaved chroma, width * height / 2 */
+	const unsigned char* uva; /* alpha of every chroma byte, so U and V get the same value */
+	std::vector<unsigned char> data; /* the four planes in that order when built here, empty when mapped */
+} nv12sticker;
+
+/* Size of the four planes of a sticker, stored back to back. */
+#define NV12_STICKER_SIZE(width, height) (3 * (width) * (height))
+
+void nv12_sticker_build(const dlib::rgb_alpha_pixel* pixels, long rows, long cols, bool rotate, nv12sticker* st);
+void nv12_sticker_attach(const unsigned char* planes, int width, int height, nv12sticker* st);
+void nv12_blend_sticker(unsigned char* y, unsigned char* uv, int width, int height, const nv12sticker* st, int cx, int cy, int top_row, int bottom_row);
+
+#endif /* NV12_COMPOSITOR_H_ */
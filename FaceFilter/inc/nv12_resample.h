@@ -0,0 +1,24 @@
+/*
+ * nv12_resample.h
+ *
+ *  Bilinear resampling of a window of an NV12 frame into another frame,
+ *  written straight into the planes of the destination.
+ */
+
+#ifndef NV12_RESAMPLE_H_
+#define NV12_RESAMPLE_H_
+
+#include <vector>
+
+typedef struct _nv12resampler {
+	std::vector<unsigned short> luma_cols; /* source column of every destination column */
+	std::vector<unsigned short> luma_weights; /* and the weight of the column right of it, in 1/256 */
+	std::vector<unsigned short> chroma_cols, chroma_weights; /* the same for the chroma samples */
+	std::vector<unsigned char> rows; /* two source rows scaled to the destination width */
+} nv12resampler;
+
+void nv12_resample(nv12resampler* rs, const unsigned char* src_y, const unsigned char* src_uv,
+		int src_width, int src_height, int src_stride,
+		unsigned char* y, unsigned char* uv, int width, int height);
+
+#endif /* NV12_RESAMPLE_H_ */
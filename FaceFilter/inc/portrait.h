@@ -0,0 +1,64 @@
+/*
+ * portrait.h
+ *
+ *  Keeps the people of the preview sharp and blurs the background behind
+ *  them, as a portrait lens would. Where the people are is guessed from
+ *  the landmarks of their faces, then snapped to the edges of the picture
+ *  on a small proxy of the frame, so the cost hardly depends on its size.
+ */
+
+#ifndef PORTRAIT_H_
+#define PORTRAIT_H_
+
+#include <vector>
+#include <dlib/array2d.h>
+#include <dlib/threads.h>
+#include "face_mask.h"
+#include "nv12_resample.h"
+
+/* The mask of the people is computed on a proxy this many times smaller than the frame. */
+#define PORTRAIT_PROXY 8
+/* Where the hair ends above the chin, and half the width of the head and of the shoulders,
+ * in distances from the chin to the eyebrows. */
+#define PORTRAIT_HEAD_TOP 1.8f
+#define PORTRAIT_HEAD_WIDTH 0.8f
+#define PORTRAIT_SHOULDERS 1.6f
+/* Box radius, in proxy pixels, and variance, in luma levels squared, of the guided filter
+ * snapping the guess to the edges of the picture, and the times it runs, */
+#define PORTRAIT_SNAP_RADIUS 4
+#define PORTRAIT_SNAP_EPS 200
+#define PORTRAIT_SNAP_PASSES 2
+/* and of the one feathering the mask into the frame. */
+#define PORTRAIT_FEATHER_RADIUS 2
+#define PORTRAIT_FEATHER_EPS 100
+/* Box radius of the blur, on the frame at half size, and number of boxes approximating a Gaussian. */
+#define PORTRAIT_BLUR_RADIUS 6
+#define PORTRAIT_BLUR_PASSES 3
+/* Strips of rows the frame is cut into for every thread. */
+#define PORTRAIT_STRIPS_PER_THREAD 2
+#define PORTRAIT_MAX_STRIPS 64
+
+typedef struct _portrait {
+	int width, height; /* of the proxy, 0 until portrait_begin() */
+	int figures; /* people added since portrait_begin() */
+	std::vector<int> guide, squares; /* the proxy: means of the luma, and their squares */
+	dlib::array2d<unsigned char> seed; /* the guessed people, then snapped, 255 inside */
+	std::vector<int> input, products; /* the mask being filtered, and its products with the guide */
+	std::vector<int> sums[4]; /* box sums of the guide, its squares, the input and the products */
+	std::vector<float> a, b, mean_a, mean_b; /* coefficients of every box, then their box means */
+	std::vector<int> cols; /* proxy position of every frame column, see _portrait_position() */
+	facemask face; /* the hull of the face being added */
+	std::vector<unsigned char> small, temp; /* the frame at half size, NV12, being blurred */
+	std::vector<unsigned char> background; /* the blurred frame at full size, NV12 */
+	std::vector<unsigned short> sums_scratch; /* running sums of the blur down the columns, for every strip */
+	std::vector<float> lines; /* coefficients of the two proxy rows around a row, for every strip */
+	std::vector<unsigned char> alphas; /* alpha of the two luma rows over a chroma row, for every strip */
+	nv12resampler down, up;
+} portrait;
+
+void portrait_begin(portrait* pt, const unsigned char* y, int width, int height);
+bool portrait_add_figure(portrait* pt, const dlib::full_object_detection& shape, int width, int height);
+void portrait_apply(portrait* pt, unsigned char* y, unsigned char* uv, int width, int height,
+		dlib::thread_pool* pool);
+
+#endif /* PORTRAIT_H_ */
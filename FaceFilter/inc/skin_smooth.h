@@ -0,0 +1,35 @@
+/*
+ * skin_smooth.h
+ *
+ *  Smooths the skin of a face while keeping its edges, with a guided
+ *  filter of the luma plane guided by itself. Flat areas, whose variance
+ *  is small next to eps, are averaged; edges, whose variance is large,
+ *  are kept. Only the pixels under the face mask change.
+ */
+
+#ifndef SKIN_SMOOTH_H_
+#define SKIN_SMOOTH_H_
+
+#include <vector>
+#include "face_mask.h"
+
+/* The filter coefficients are computed on a guide this many times smaller. */
+#define SKIN_SUBSAMPLE 4
+/* Box radius in frame pixels, the size of the details smoothed away. */
+#define SKIN_RADIUS 12
+/* Variance, in luma levels squared, under which details count as skin. */
+#define SKIN_EPS 150
+
+typedef struct _skinsmooth {
+	std::vector<int> guide, squares, sums, square_sums; /* the subsampled guide and its box sums */
+	std::vector<float> a, b, mean_a, mean_b; /* coefficients of every box, then their box means */
+	std::vector<int> coef_a, coef_b; /* mean_a in 1/4096, mean_b in 1/16 */
+	std::vector<int> row_a, row_b; /* the coefficients of the row being filtered, on the guide */
+	std::vector<int> line_a, line_b; /* and at every column of the mask */
+	std::vector<int> cols; /* guide column and weight of every column, packed */
+} skinsmooth;
+
+void skin_smooth_face(skinsmooth* ss, unsigned char* y, int width, int height,
+		const facemask* fm, int radius, int eps);
+
+#endif /* SKIN_SMOOTH_H_ */
@@ -0,0 +1,31 @@
+/*
+ * sticker_anim.h
+ *
+ *  Plays a sequence of stickers (name0, name1, ...) as an animation. The
+ *  frames are the decoded stickers of the atlas, so playing only picks a
+ *  pointer: nothing is decoded or allocated once the sequence is loaded.
+ */
+
+#ifndef STICKER_ANIM_H_
+#define STICKER_ANIM_H_
+
+#include "sticker_atlas.h"
+#include "sticker_warp.h"
+
+#define ANIM_MAX_FRAMES 8
+/* How long every frame stays on screen, in milliseconds. */
+#define ANIM_FRAME_MS 120
+/* Frames between the phases of two faces, so they do not move in lockstep. */
+#define ANIM_FACE_STAGGER 3
+
+typedef struct _stickeranim {
+	const stickerlayout* layout; /* anchors, given on frames[0] */
+	int count; /* number of frames, 0 if the sequence is missing */
+	const sticker* frames[ANIM_MAX_FRAMES];
+} stickeranim;
+
+bool sticker_anim_load(const stickeratlas* atlas, const char* name, stickeranim* anim);
+unsigned long long sticker_anim_clock(void);
+const sticker* sticker_anim_frame(const stickeranim* anim, unsigned long id, unsigned long long now);
+
+#endif /* STICKER_ANIM_H_ */
@@ -0,0 +1,64 @@
+/*
+ * sticker_atlas.h
+ *
+ *  Decodes every sticker once at startup and keeps it as a premultiplied
+ *  mip chain, so the frame loop never touches the disk and only resamples
+ *  a mip level that is already close to the size it needs. Stickers can
+ *  also come from a mapped .ffsticker package, in which case they are
+ *  used in place and nothing is decoded at all.
+ */
+
+#ifndef STICKER_ATLAS_H_
+#define STICKER_ATLAS_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <dlib/array2d.h>
+#include <dlib/pixel.h>
+#include "nv12_compositor.h"
+
+/* Mip levels stop once either side would get smaller than this. */
+#define STICKER_MIN_MIP 8
+
+/* Sticker pixels brighter than this are the white background of a JPEG. */
+#define STICKER_WHITE_KEY 220
+
+#define MAX_ANCHORS 4
+
+typedef struct _stickerlayout {
+	const char* name; /* sticker, or sequence of animation frames, the layout applies to */
+	int count; /* number of anchors, at least 2 */
+	int parts[MAX_ANCHORS]; /* landmark of every anchor */
+	float anchors[MAX_ANCHORS][2]; /* anchor on the upright sticker, or on the first frame of a sequence, as fractions of its width and height */
+} stickerlayout;
+
+typedef struct _stickermip {
+	long rows;
+	long cols;
+	const dlib::rgb_alpha_pixel* pixels; /* premultiplied, row major */
+} stickermip;
+
+typedef struct _sticker {
+	std::string name; /* file name without directory and extension */
+	std::vector<stickermip> mips; /* mips[0] is the full size */
+	nv12sticker nv12; /* the full size, in NV12 */
+	std::vector<dlib::rgb_alpha_pixel> pixels; /* every mip level when decoded here, empty when mapped */
+} sticker;
+
+typedef struct _stickeratlas {
+	std::vector<sticker> stickers;
+	std::vector<stickerlayout> layouts; /* anchors that came with the stickers */
+	std::vector<std::pair<void*, size_t> > mappings; /* mapped packages, unmapped on release */
+} stickeratlas;
+
+/* Decodes one file. Pixels that have to stay see-through get alpha 0. */
+typedef bool (*sticker_decode_fn)(const char* path, dlib::array2d<dlib::rgb_alpha_pixel>& img);
+
+unsigned long sticker_atlas_load(stickeratlas* atlas, const std::vector<std::string>& paths, sticker_decode_fn decode, unsigned long num_threads);
+void sticker_atlas_release(stickeratlas* atlas);
+const sticker* sticker_atlas_find(const stickeratlas* atlas, const char* name);
+const stickerlayout* sticker_atlas_find_layout(const stickeratlas* atlas, const char* name);
+void sticker_atlas_scale(const sticker* st, long rows, long cols, dlib::array2d<dlib::rgb_alpha_pixel>& out);
+
+#endif /* STICKER_ATLAS_H_ */
@@ -0,0 +1,24 @@
+/*
+ * sticker_package.h
+ *
+ *  A .ffsticker package holds stickers already premultiplied, with every
+ *  mip level in RGBA and the full size in NV12, along with the anchors of
+ *  the stickers and sequences it contains. It is mapped and used in place,
+ *  so loading it costs page faults instead of decoding.
+ */
+
+#ifndef STICKER_PACKAGE_H_
+#define STICKER_PACKAGE_H_
+
+#include "sticker_atlas.h"
+
+#define FFSTICKER_MAGIC "FFSTICK"
+#define FFSTICKER_VERSION 1
+/* Longest name, terminating null included. */
+#define FFSTICKER_NAME_MAX 32
+#define FFSTICKER_MAX_MIPS 12
+
+unsigned long sticker_package_map(stickeratlas* atlas, const char* path);
+bool sticker_package_write(const stickeratlas* atlas, const char* path);
+
+#endif /* STICKER_PACKAGE_H_ */
@@ -0,0 +1,26 @@
+/*
+ * sticker_warp.h
+ *
+ *  Draws a sticker so that its anchor points land on the matching
+ *  landmarks, following the position, size and roll of the face.
+ */
+
+#ifndef STICKER_WARP_H_
+#define STICKER_WARP_H_
+
+#include <dlib/image_processing.h>
+#include "sticker_atlas.h"
+
+/* A sticker placed on a face, ready to be drawn. */
+typedef struct _warpdraw {
+	const stickermip* mip; /* mip level sampled */
+	int x0, y0, x1, y1; /* box drawn on the frame, all even */
+	int u0, v0; /* mip position of frame pixel (x0, y0), in 16.16 */
+	int du_dx, du_dy, dv_dx, dv_dy; /* mip steps for one frame pixel, in 16.16 */
+} warpdraw;
+
+const stickerlayout* sticker_layout_find(const char* name);
+bool sticker_warp_prepare(int width, int height, const sticker* st, const sticker* base, const stickerlayout* layout, const dlib::full_object_detection& shape, warpdraw* draw);
+void sticker_warp_rows(unsigned char* y, unsigned char* uv, int width, const warpdraw* draw, int top, int bottom);
+
+#endif /* STICKER_WARP_H_ */
@@ -0,0 +1,35 @@
+/*
+ * temporal_denoise.h
+ *
+ *  Averages the sensor noise of the preview away over time: every frame
+ *  is blended into the previous output, more strongly where nothing moves.
+ *  Motion is measured per 8x8 block, so moving parts follow the camera
+ *  without trails while still parts settle.
+ */
+
+#ifndef TEMPORAL_DENOISE_H_
+#define TEMPORAL_DENOISE_H_
+
+#include <vector>
+#include <dlib/threads.h>
+
+/* Side of the blocks motion is measured on, in luma pixels. */
+#define DENOISE_BLOCK 8
+/* Mean absolute difference, in luma levels, up to which a block counts as still, */
+#define DENOISE_STILL 5
+/* and from which it counts as moving. */
+#define DENOISE_MOVING 14
+/* Weight of the new frame in a still block, in 1/128. A moving block takes the new frame only. */
+#define DENOISE_STILL_WEIGHT 40
+
+typedef struct _denoiser {
+	int width, height; /* size of the frame the history holds, 0 before the first one */
+	std::vector<unsigned char> y, uv; /* the previous output, NV12 */
+	std::vector<unsigned char> weights; /* weight of the new frame in every block, in 1/128 */
+} denoiser;
+
+void denoise_reset(denoiser* dn);
+void denoise_frame(denoiser* dn, unsigned char* y, unsigned char* uv, int width, int height,
+		bool chroma, dlib::thread_pool* pool);
+
+#endif /* TEMPORAL_DENOISE_H_ */
@@ -0,0 +1,137 @@
+/*
+ * auto_framing.cpp
+ *
+ *  The window is a center and a width, the height following from the
+ *  aspect of the frame. Each of the three follows its target as a
+ *  critically damped spring: it gets there as fast as FRAMING_RESPONSE
+ *  allows without ever overshooting, and starts and stops smoothly. The
+ *  target only moves once the faces leave a dead zone around it, so a
+ *  nodding head does not shake the picture.
+ */
+
+#include "auto_framing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/**
+ * @brief Forgets the path, the next frame starts on the whole picture.
+ */
+void framing_reset(framing* fr)
+{
+	fr->started = false;
+}
+
+/* one step of a critically damped spring pulling x toward target */
+static void _framing_follow(double* x, double* v, double target, double dt)
+{
+	const double w = FRAMING_RESPONSE;
+	*v += (w * w * (target - *x) - 2.0 * w * *v) * dt;
+	*x += *v * dt;
+}
+
+/**
+ * @brief Moves the window after the faces of a new frame.
+ *
+ * @param fr            The virtual camera
+ * @param faces         The tracked faces, in the rotated gray image
+ * @param frame_width   The frame width
+ * @param frame_height  The frame height
+ * @param time          The timestamp of the frame, in ms
+ */
+void framing_update(framing* fr, const std::vector<dlib::rectangle>& faces,
+		int frame_width, int frame_height, unsigned int time)
+{
+	const double aspect = (double) frame_height / frame_width;
+
+	if (!fr->started) {
+		fr->x = fr->target_x = frame_width / 2.0;
+		fr->y = fr->target_y = frame_height / 2.0;
+		fr->size = fr->target_size = frame_width;
+		fr->vx = fr->vy = fr->vsize = 0.0;
+		fr->time = fr->face_time = time;
+		fr->started = true;
+	}
+
+	/* the box around every face, back from the gray image to the frame */
+	double left = frame_width, top = frame_height, right = 0.0, bottom = 0.0;
+	for (size_t i = 0; i < faces.size(); i++) {
+		left = std::min(left, (double) faces[i].top());
+		right = std::max(right, (double) faces[i].bottom() + 1);
+		top = std::min(top, (double) frame_height - 1 - faces[i].right());
+		bottom = std::max(bottom, (double) frame_height - faces[i].left());
+	}
+
+	if (!faces.empty()) {
+		const double size = std::max((right - left) * FRAMING_MARGIN,
+				(bottom - top) * FRAMING_MARGIN / aspect);
+		const double cx = (left + right) / 2.0, cy = (top + bottom) / 2.0;
+		const double slack = FRAMING_DEAD_ZONE * fr->target_size;
+		if (fabs(cx - fr->target_x) > slack || fabs(cy - fr->target_y) > slack * aspect
+				|| fabs(size - fr->target_size) > slack) {
+			fr->target_x = cx;
+			fr->target_y = cy;
+			fr->target_size = size;
+		}
+		fr->face_time = time;
+	} else if ((int) (time - fr->face_time) > FRAMING_HOLD_MS) {
+		fr->target_x = frame_width / 2.0;
+		fr->target_y = frame_height / 2.0;
+		fr->target_size = frame_width;
+	}
+	fr->target_size = std::max(frame_width / FRAMING_MAX_ZOOM, std::min(fr->target_size, (double) frame_width));
+
+	/* frames do not arrive at a fixed rate, and a long gap would make the springs jump */
+	int ms = (int) (time - fr->time);
+	if (ms <= 0)
+		ms = FRAMING_DEFAULT_DT;
+	const double dt = std::min(ms, 4 * FRAMING_DEFAULT_DT) / 1000.0;
+	fr->time = time;
+	_framing_follow(&fr->x, &fr->vx, fr->target_x, dt);
+	_framing_follow(&fr->y, &fr->vy, fr->target_y, dt);
+	_framing_follow(&fr->size, &fr->vsize, fr->target_size, dt);
+
+	/* the window, on even samples and inside the frame */
+	const double size = std::max(frame_width / FRAMING_MAX_ZOOM, std::min(fr->size, (double) frame_width));
+	fr->width = std::max(4, std::min((int) lround(size / 2.0) * 2, frame_width));
+	fr->height = std::max(4, std::min((int) lround(size * aspect / 2.0) * 2, frame_height));
+	fr->left = (int) lround((fr->x - fr->width / 2.0) / 2.0) * 2;
+	fr->top = (int) lround((fr->y - fr->height / 2.0) / 2.0) * 2;
+	fr->left = std::max(0, std::min(fr->left, frame_width - fr->width));
+	fr->top = std::max(0, std::min(fr->top, frame_height - fr->height));
+}
+
+/**
+ * @brief Tells whether the window is smaller than the frame.
+ * @details The stages that run before framing_apply() only need to cover
+ *          the window then.
+ */
+bool framing_active(const framing* fr, int frame_width, int frame_height)
+{
+	return fr->started && (fr->width < frame_width || fr->height < frame_height);
+}
+
+/**
+ * @brief Scales the window over the whole frame, in place.
+ * @details The window is copied out first, as the frame it is scaled into
+ *          holds it.
+ */
+void framing_apply(framing* fr, unsigned char* y, unsigned char* uv, int frame_width, int frame_height)
+{
+	if (!framing_active(fr, frame_width, frame_height))
+		return;
+
+	const int w = fr->width, h = fr->height;
+	if (fr->crop.size() < (size_t) w * h * 3 / 2)
+		fr->crop.resize((size_t) w * h * 3 / 2);
+	unsigned char* crop_y = &fr->crop[0];
+	unsigned char* crop_uv = crop_y + (size_t) w * h;
+
+	for (int j = 0; j < h; j++)
+		memcpy(crop_y + (size_t) j * w, y + (size_t) (fr->top + j) * frame_width + fr->left, w);
+	for (int j = 0; j < h / 2; j++)
+		memcpy(crop_uv + (size_t) j * w, uv + (size_t) (fr->top / 2 + j) * frame_width + fr->left, w);
+
+	nv12_resample(&fr->resampler, crop_y, crop_uv, w, h, w, y, uv, frame_width, frame_height);
+}
@@ -0,0 +1,406 @@
+/*
+ * color_lut.cpp
+ *
+ *  A .cube file maps RGB to RGB. At load time the mapping is sampled on a
+ *  grid of YUV nodes, through BT.601 limited range like the preview, into
+ *  a table of bytes. The nodes sit on multiples of a power of two, the last
+ *  one at 256, so a sample splits into a node and a weight with a shift and
+ *  a mask. Every 2x2 block of the frame then costs five lookups: one per
+ *  luma sample, and one for the chroma at the mean luma of the block.
+ *
+ *  A lookup is the tetrahedral interpolation of the cell around the sample:
+ *  the cell is cut along its main diagonal into six tetrahedra, the one
+ *  holding the sample is found by ordering its three weights, and only its
+ *  four corners are blended. That is half the corners of a trilinear
+ *  interpolation, and neutral grays stay on the diagonal.
+ */
+
+#include "color_lut.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <dlib/simd.h>
+
+typedef struct _cubefile {
+	int size;
+	float domain_min[3], domain_max[3];
+	std::vector<float> rgb; /* red varying fastest, then green */
+} cubefile;
+
+/**
+ * @brief Reads a .cube file.
+ * @details Keywords other than LUT_3D_SIZE and the domain are skipped, a
+ *          LUT_1D_SIZE makes the file unusable.
+ */
+static bool _cube_read(cubefile* cf, const char* path)
+{
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL)
+		return false;
+
+	char line[256];
+	size_t count = 0;
+	bool ok = true;
+	cf->size = 0;
+	cf->rgb.clear();
+	for (int c = 0; c < 3; c++) {
+		cf->domain_min[c] = 0.0f;
+		cf->domain_max[c] = 1.0f;
+	}
+
+	while (ok && fgets(line, sizeof(line), fp) != NULL) {
+		float r, g, b;
+		if (sscanf(line, "%f %f %f", &r, &g, &b) == 3) {
+			if (count >= cf->rgb.size()) {
+				ok = false;
+				break;
+			}
+			cf->rgb[count++] = r;
+			cf->rgb[count++] = g;
+			cf->rgb[count++] = b;
+		} else if (strncmp(line, "LUT_3D_SIZE", 11) == 0) {
+			ok = cf->size == 0 && sscanf(line + 11, "%d", &cf->size) == 1
+					&& cf->size >= 2 && cf->size <= COLOR_LUT_MAX_CUBE;
+			if (ok)
+				cf->rgb.resize((size_t) cf->size * cf->size * cf->size * 3);
+		} else if (strncmp(line, "DOMAIN_MIN", 10) == 0) {
+			ok = sscanf(line + 10, "%f %f %f", &cf->domain_min[0], &cf->domain_min[1],
+					&cf->domain_min[2]) == 3;
+		} else if (strncmp(line, "DOMAIN_MAX", 10) == 0) {
+			ok = sscanf(line + 10, "%f %f %f", &cf->domain_max[0], &cf->domain_max[1],
+					&cf->domain_max[2]) == 3;
+		} else if (strncmp(line, "LUT_1D_SIZE", 11) == 0) {
+			ok = false;
+		}
+	}
+	fclose(fp);
+
+	for (int c = 0; c < 3; c++)
+		ok = ok && cf->domain_max[c] > cf->domain_min[c];
+	return ok && cf->size > 0 && count == cf->rgb.size();
+}
+
+/**
+ * @brief Maps one RGB color through the file, trilinearly.
+ * @details Colors outside the domain are mapped at its edge and keep how
+ *          far out they were, so an identity file is an identity everywhere
+ *          and the YUV nodes that have no RGB color still grade smoothly.
+ */
+static void _cube_sample(const cubefile* cf, const float* in, float* out)
+{
+	const int n = cf->size;
+	float t[3], excess[3];
+	int i0[3];
+
+	for (int c = 0; c < 3; c++) {
+		const float range = cf->domain_max[c] - cf->domain_min[c];
+		const float v = (in[c] - cf->domain_min[c]) / range;
+		const float clamped = std::max(0.0f, std::min(v, 1.0f));
+		excess[c] = (v - clamped) * range;
+		const float p = clamped * (n - 1);
+		i0[c] = std::min((int) p, n - 2);
+		t[c] = p - i0[c];
+	}
+
+	for (int c = 0; c < 3; c++)
+		out[c] = excess[c];
+	for (int corner = 0; corner < 8; corner++) {
+		const int dr = corner & 1, dg = (corner >> 1) & 1, db = corner >> 2;
+		const float w = (dr ? t[0] : 1.0f - t[0]) * (dg ? t[1] : 1.0f - t[1])
+				* (db ? t[2] : 1.0f - t[2]);
+		const float* rgb = &cf->rgb[(((size_t) (i0[2] + db) * n + i0[1] + dg) * n + i0[0] + dr) * 3];
+		for (int c = 0; c < 3; c++)
+			out[c] += w * rgb[c];
+	}
+}
+
+static inline unsigned char _lut_byte(float v)
+{
+	return (unsigned char) std::max(0.0f, std::min(v + 0.5f, 255.0f));
+}
+
+/**
+ * @brief Loads a .cube file and bakes it into a table of the preview's YUV.
+ * @details Runs once per file, at startup. The table stays valid until the
+ *          next load, the frames only read it.
+ *
+ * @param cl    Receives the table. Left as it was if the file cannot be read.
+ * @param path  The .cube file, 3D and in RGB between its DOMAIN_MIN and
+ *              DOMAIN_MAX, 0 and 1 by default
+ * @param size  COLOR_LUT_SMALL or COLOR_LUT_LARGE
+ * @return      @c false if the size is neither or the file could not be read
+ */
+bool color_lut_load(colorlut* cl, const char* path, int size)
+{
+	if (size != COLOR_LUT_SMALL && size != COLOR_LUT_LARGE)
+		return false;
+
+	cubefile cf;
+	if (!_cube_read(&cf, path))
+		return false;
+
+	const int shift = size == COLOR_LUT_SMALL ? 4 : 3;
+	std::vector<unsigned char> nodes((size_t) size * size * size * 4, 0);
+	for (int iy = 0; iy < size; iy++) {
+		for (int iu = 0; iu < size; iu++) {
+			for (int iv = 0; iv < size; iv++) {
+				/* the last node is at 256, past the last level, like the others are spaced */
+				const float y = (float) (iy << shift) - 16.0f;
+				const float u = (float) (iu << shift) - 128.0f;
+				const float v = (float) (iv << shift) - 128.0f;
+				float rgb[3], graded[3];
+				rgb[0] = (1.164f * y + 1.596f * v) / 255.0f;
+				rgb[1] = (1.164f * y - 0.392f * u - 0.813f * v) / 255.0f;
+				rgb[2] = (1.164f * y + 2.017f * u) / 255.0f;
+				for (int c = 0; c < 3; c++)
+					rgb[c] = cf.domain_min[c] + rgb[c] * (cf.domain_max[c] - cf.domain_min[c]);
+
+				_cube_sample(&cf, rgb, graded);
+				for (int c = 0; c < 3; c++)
+					graded[c] = (graded[c] - cf.domain_min[c]) / (cf.domain_max[c] - cf.domain_min[c]) * 255.0f;
+
+				unsigned char* node = &nodes[(((size_t) iy * size + iu) * size + iv) * 4];
+				node[0] = _lut_byte(16.0f + 0.257f * graded[0] + 0.504f * graded[1] + 0.098f * graded[2]);
+				node[1] = _lut_byte(128.0f - 0.148f * graded[0] - 0.291f * graded[1] + 0.439f * graded[2]);
+				node[2] = _lut_byte(128.0f + 0.439f * graded[0] - 0.368f * graded[1] - 0.071f * graded[2]);
+			}
+		}
+	}
+
+	cl->size = size;
+	cl->shift = shift;
+	cl->nodes.swap(nodes);
+	return true;
+}
+
+/*
+ * The corners of the tetrahedron holding a sample, in nodes from the one
+ * below it, and their weights. The path from the lowest corner to the
+ * highest goes first along the axis of the largest weight and last along
+ * the axis of the smallest. Ties pick different axes for both, and the
+ * corner they leave ambiguous gets no weight.
+ */
+static inline void _lut_tetra(int fy, int fu, int fv, int dy, int du, int dv,
+		int* first, int* second, int* w)
+{
+	const int hi = std::max(fy, std::max(fu, fv));
+	const int lo = std::min(fy, std::min(fu, fv));
+	const int mid = fy + fu + fv - hi - lo;
+	*first = fy == hi ? dy : fu == hi ? du : dv;
+	*second = dy + du + dv - (fv == lo ? dv : fu == lo ? du : dy);
+	w[0] = 256 - hi;
+	w[1] = hi - mid;
+	w[2] = mid - lo;
+	w[3] = lo;
+}
+
+#if defined(DLIB_HAVE_NEON) || defined(DLIB_HAVE_SSE2)
+#if defined(DLIB_HAVE_NEON)
+typedef uint16x8_t lutvec;
+
+static inline lutvec _lut_dup(int v) { return vdupq_n_u16((unsigned short) v); }
+static inline lutvec _lut_add(lutvec a, lutvec b) { return vaddq_u16(a, b); }
+static inline lutvec _lut_sub(lutvec a, lutvec b) { return vsubq_u16(a, b); }
+static inline lutvec _lut_mul(lutvec a, lutvec b) { return vmulq_u16(a, b); }
+static inline lutvec _lut_max(lutvec a, lutvec b) { return vmaxq_u16(a, b); }
+static inline lutvec _lut_min(lutvec a, lutvec b) { return vminq_u16(a, b); }
+static inline lutvec _lut_and(lutvec a, lutvec b) { return vandq_u16(a, b); }
+static inline lutvec _lut_eq(lutvec a, lutvec b) { return vceqq_u16(a, b); }
+static inline lutvec _lut_select(lutvec m, lutvec a, lutvec b) { return vbslq_u16(m, a, b); }
+static inline lutvec _lut_shl(lutvec a, int n) { return vshlq_u16(a, vdupq_n_s16((short) n)); }
+static inline lutvec _lut_shr(lutvec a, int n) { return vshlq_u16(a, vdupq_n_s16((short) -n)); }
+static inline lutvec _lut_load(const unsigned short* p) { return vld1q_u16(p); }
+static inline void _lut_store(unsigned short* p, lutvec a) { vst1q_u16(p, a); }
+
+/* the even and odd bytes of 16 */
+static inline void _lut_load_pairs(const unsigned char* p, lutvec* even, lutvec* odd)
+{
+	const uint8x8x2_t v = vld2_u8(p);
+	*even = vmovl_u8(v.val[0]);
+	*odd = vmovl_u8(v.val[1]);
+}
+
+static inline void _lut_store_pairs(unsigned char* p, lutvec even, lutvec odd)
+{
+	uint8x8x2_t v;
+	v.val[0] = vmovn_u16(even);
+	v.val[1] = vmovn_u16(odd);
+	vst2_u8(p, v);
+}
+#else
+typedef __m128i lutvec;
+
+static inline lutvec _lut_dup(int v) { return _mm_set1_epi16((short) v); }
+static inline lutvec _lut_add(lutvec a, lutvec b) { return _mm_add_epi16(a, b); }
+static inline lutvec _lut_sub(lutvec a, lutvec b) { return _mm_sub_epi16(a, b); }
+static inline lutvec _lut_mul(lutvec a, lutvec b) { return _mm_mullo_epi16(a, b); }
+/* the signed comparisons of SSE2 are enough, every operand is below 32768 */
+static inline lutvec _lut_max(lutvec a, lutvec b) { return _mm_max_epi16(a, b); }
+static inline lutvec _lut_min(lutvec a, lutvec b) { return _mm_min_epi16(a, b); }
+static inline lutvec _lut_and(lutvec a, lutvec b) { return _mm_and_si128(a, b); }
+static inline lutvec _lut_eq(lutvec a, lutvec b) { return _mm_cmpeq_epi16(a, b); }
+static inline lutvec _lut_select(lutvec m, lutvec a, lutvec b)
+{
+	return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+static inline lutvec _lut_shl(lutvec a, int n) { return _mm_sll_epi16(a, _mm_cvtsi32_si128(n)); }
+static inline lutvec _lut_shr(lutvec a, int n) { return _mm_srl_epi16(a, _mm_cvtsi32_si128(n)); }
+static inline lutvec _lut_load(const unsigned short* p) { return _mm_loadu_si128((const __m128i*) p); }
+static inline void _lut_store(unsigned short* p, lutvec a) { _mm_storeu_si128((__m128i*) p, a); }
+
+static inline void _lut_load_pairs(const unsigned char* p, lutvec* even, lutvec* odd)
+{
+	const __m128i v = _mm_loadu_si128((const __m128i*) p);
+	*even = _mm_and_si128(v, _mm_set1_epi16(0xff));
+	*odd = _mm_srli_epi16(v, 8);
+}
+
+static inline void _lut_store_pairs(unsigned char* p, lutvec even, lutvec odd)
+{
+	_mm_storeu_si128((__m128i*) p, _mm_or_si128(even, _mm_slli_epi16(odd, 8)));
+}
+#endif
+
+/*
+ * Eight lookups at once. The tetrahedra are picked in vectors as
+ * _lut_tetra() picks them, the corners are read one by one, and blended in
+ * vectors again: with weights adding up to 256 a sum of bytes fits 16 bits.
+ */
+typedef struct _lutlanes {
+	lutvec w[4]; /* weight of every corner */
+	unsigned short corners[4][8]; /* node of every corner of every lane */
+} lutlanes;
+
+static inline void _lut_tetra8(lutlanes* l, lutvec node, lutvec fy, lutvec fu, lutvec fv,
+		lutvec dy, lutvec du, lutvec dv, lutvec all)
+{
+	const lutvec hi = _lut_max(fy, _lut_max(fu, fv));
+	const lutvec lo = _lut_min(fy, _lut_min(fu, fv));
+	const lutvec mid = _lut_sub(_lut_add(fy, _lut_add(fu, fv)), _lut_add(hi, lo));
+	const lutvec first = _lut_select(_lut_eq(fy, hi), dy, _lut_select(_lut_eq(fu, hi), du, dv));
+	const lutvec last = _lut_select(_lut_eq(fv, lo), dv, _lut_select(_lut_eq(fu, lo), du, dy));
+
+	_lut_store(l->corners[0], node);
+	_lut_store(l->corners[1], _lut_add(node, first));
+	_lut_store(l->corners[2], _lut_add(node, _lut_sub(all, last)));
+	_lut_store(l->corners[3], _lut_add(node, all));
+	l->w[0] = _lut_sub(_lut_dup(256), hi);
+	l->w[1] = _lut_sub(hi, mid);
+	l->w[2] = _lut_sub(mid, lo);
+	l->w[3] = lo;
+}
+
+static inline lutvec _lut_blend8(const lutlanes* l, const unsigned char* nodes, int channel)
+{
+	unsigned short v[4][8];
+	for (int k = 0; k < 4; k++)
+		for (int i = 0; i < 8; i++)
+			v[k][i] = nodes[l->corners[k][i] * 4 + channel];
+
+	lutvec sum = _lut_dup(128);
+	for (int k = 0; k < 4; k++)
+		sum = _lut_add(sum, _lut_mul(_lut_load(v[k]), l->w[k]));
+	return _lut_shr(sum, 8);
+}
+#endif
+
+/**
+ * @brief Grades two rows of luma and the row of chroma between them.
+ */
+static void _lut_rows(const colorlut* cl, unsigned char* y0, unsigned char* y1,
+		unsigned char* uv, int width)
+{
+	const unsigned char* nodes = &cl->nodes[0];
+	const int shift = cl->shift, mask = (1 << shift) - 1, up = 8 - shift;
+	const int dv = 1, du = cl->size, dy = cl->size * cl->size, all = dy + du + dv;
+	int x = 0;
+
+#if defined(DLIB_HAVE_NEON) || defined(DLIB_HAVE_SSE2)
+	/* eight blocks, 16 columns, at a time */
+	const lutvec vmask = _lut_dup(mask), vdy = _lut_dup(dy), vdu = _lut_dup(du);
+	const lutvec vdv = _lut_dup(dv), vall = _lut_dup(all);
+	for (; x + 16 <= width; x += 16) {
+		lutvec cb, cr, luma[4], out[4];
+		lutlanes l;
+		_lut_load_pairs(uv + x, &cb, &cr);
+		_lut_load_pairs(y0 + x, &luma[0], &luma[1]);
+		_lut_load_pairs(y1 + x, &luma[2], &luma[3]);
+
+		const lutvec fu = _lut_shl(_lut_and(cb, vmask), up);
+		const lutvec fv = _lut_shl(_lut_and(cr, vmask), up);
+		const lutvec cell = _lut_add(_lut_mul(_lut_shr(cb, shift), vdu), _lut_shr(cr, shift));
+
+		for (int k = 0; k < 4; k++) {
+			const lutvec node = _lut_add(_lut_mul(_lut_shr(luma[k], shift), vdy), cell);
+			_lut_tetra8(&l, node, _lut_shl(_lut_and(luma[k], vmask), up), fu, fv, vdy, vdu, vdv, vall);
+			out[k] = _lut_blend8(&l, nodes, 0);
+		}
+		_lut_store_pairs(y0 + x, out[0], out[1]);
+		_lut_store_pairs(y1 + x, out[2], out[3]);
+
+		const lutvec sum = _lut_add(_lut_add(luma[0], luma[1]), _lut_add(luma[2], luma[3]));
+		const lutvec v = _lut_shr(_lut_add(sum, _lut_dup(2)), 2);
+		const lutvec node = _lut_add(_lut_mul(_lut_shr(v, shift), vdy), cell);
+		_lut_tetra8(&l, node, _lut_shl(_lut_and(v, vmask), up), fu, fv, vdy, vdu, vdv, vall);
+		_lut_store_pairs(uv + x, _lut_blend8(&l, nodes, 1), _lut_blend8(&l, nodes, 2));
+	}
+#endif
+
+	for (; x + 1 < width; x += 2) {
+		const int cb = uv[x], cr = uv[x + 1];
+		const int fu = (cb & mask) << up, fv = (cr & mask) << up;
+		const int cell = (cb >> shift) * du + (cr >> shift) * dv;
+		unsigned char* const luma[4] = { y0 + x, y0 + x + 1, y1 + x, y1 + x + 1 };
+		int sum = 0;
+
+		for (int k = 0; k < 4; k++) {
+			const int v = *luma[k];
+			const unsigned char* n = nodes + ((v >> shift) * dy + cell) * 4;
+			int first, second, w[4];
+			_lut_tetra((v & mask) << up, fu, fv, dy, du, dv, &first, &second, w);
+			*luma[k] = (n[0] * w[0] + n[first * 4] * w[1] + n[second * 4] * w[2]
+					+ n[all * 4] * w[3] + 128) >> 8;
+			sum += v;
+		}
+
+		/* the chroma of the block, graded at its mean luma */
+		const int v = (sum + 2) >> 2;
+		const unsigned char* n = nodes + ((v >> shift) * dy + cell) * 4;
+		int first, second, w[4];
+		_lut_tetra((v & mask) << up, fu, fv, dy, du, dv, &first, &second, w);
+		for (int c = 1; c <= 2; c++)
+			uv[x + c - 1] = (n[c] * w[0] + n[first * 4 + c] * w[1] + n[second * 4 + c] * w[2]
+					+ n[all * 4 + c] * w[3] + 128) >> 8;
+	}
+}
+
+/**
+ * @brief Grades a frame, in place.
+ *
+ * @param cl      The table, see color_lut_load(). Nothing is done if it is empty.
+ * @param y       The luma plane, or the top left of a window of it
+ * @param uv      The interleaved chroma plane, or the top left of the same window
+ * @param width   The frame or window width, even
+ * @param height  The frame or window height, even
+ * @param stride  The bytes from one row to the next in both planes
+ * @param pool    Grades strips of rows on its threads, NULL to grade them in turn
+ */
+void color_lut_apply(const colorlut* cl, unsigned char* y, unsigned char* uv, int width, int height,
+		int stride, dlib::thread_pool* pool)
+{
+	if (cl->size == 0)
+		return;
+
+	/* every pair of rows stands on its own */
+	auto grade = [&](long begin, long end) {
+		for (long j = begin; j < end; j++)
+			_lut_rows(cl, y + (size_t) (2 * j) * stride, y + (size_t) (2 * j + 1) * stride,
+					uv + (size_t) j * stride, width);
+	};
+	if (pool != NULL && pool->num_threads_in_pool() > 1)
+		dlib::parallel_for_blocked(*pool, 0, height / 2, grade);
+	else
+		grade(0, height / 2);
+}
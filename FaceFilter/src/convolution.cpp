@@ -0,0 +1,269 @@
+/*
+ * convolution.cpp
+ *
+ *  The rows handed to conv_row() carry CONV_PAD bytes of their own edge
+ *  samples on either side, written once per row by conv_pad_row(), so no
+ *  loop ever checks a border. Every pass is a sum of taps: each tap is a
+ *  weight and a source row shifted by a whole number of samples. Sums are
+ *  kept in 32 bits, eight samples at a time: NEON multiplies and
+ *  accumulates widening, SSE2 interleaves the samples of two taps and lets
+ *  pmaddwd do two taps at once. A separable kernel keeps its vertical
+ *  sums in 16 bits, which the vertical weights are limited for.
+ */
+
+#include "convolution.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <dlib/simd.h>
+
+/* the vertical sums of a separable kernel stay within 16 bits with these weights */
+#define CONV_MAX_COL_SUM 128
+/* and the horizontal sums of them, plus the rounding, within 32 bits with these */
+#define CONV_MAX_ROW_SUM 65535
+
+static inline void _conv_store(unsigned char* out, int v)
+{
+	*out = (unsigned char) std::max(0, std::min(v, 255));
+}
+
+static inline void _conv_store(short* out, int v)
+{
+	*out = (short) std::max(-32768, std::min(v, 32767));
+}
+
+#if defined(DLIB_HAVE_NEON)
+static inline int16x8_t _conv_load8(const unsigned char* p)
+{
+	return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+}
+
+static inline int16x8_t _conv_load8(const short* p)
+{
+	return vld1q_s16(p);
+}
+
+static inline void _conv_store8(unsigned char* p, int32x4_t lo, int32x4_t hi)
+{
+	vst1_u8(p, vqmovun_s16(vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi))));
+}
+
+static inline void _conv_store8(short* p, int32x4_t lo, int32x4_t hi)
+{
+	vst1q_s16(p, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+}
+#elif defined(DLIB_HAVE_SSE2)
+static inline __m128i _conv_load8(const unsigned char* p)
+{
+	return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) p), _mm_setzero_si128());
+}
+
+static inline __m128i _conv_load8(const short* p)
+{
+	return _mm_loadu_si128((const __m128i*) p);
+}
+
+static inline void _conv_store8(unsigned char* p, __m128i lo, __m128i hi)
+{
+	const __m128i s = _mm_packs_epi32(lo, hi);
+	_mm_storel_epi64((__m128i*) p, _mm_packus_epi16(s, s));
+}
+
+static inline void _conv_store8(short* p, __m128i lo, __m128i hi)
+{
+	_mm_storeu_si128((__m128i*) p, _mm_packs_epi32(lo, hi));
+}
+#endif
+
+/**
+ * @brief Sets out[x] to the rounded and saturated sum of w[t] * src[t][x] >> shift,
+ *        for x0 <= x < x1.
+ */
+template <typename S, typename D>
+static void _conv_taps(const S* const* src, const short* w, int n, int shift,
+		D* out, int x0, int x1)
+{
+	int x = x0;
+
+#if defined(DLIB_HAVE_NEON)
+	const int32x4_t count = vdupq_n_s32(-shift);
+	for (; x + 8 <= x1; x += 8) {
+		int32x4_t lo = vdupq_n_s32(0), hi = lo;
+		for (int t = 0; t < n; t++) {
+			const int16x8_t v = _conv_load8(src[t] + x);
+			lo = vmlal_n_s16(lo, vget_low_s16(v), w[t]);
+			hi = vmlal_n_s16(hi, vget_high_s16(v), w[t]);
+		}
+		/* vrshl rounds, the same as adding half before the shift */
+		_conv_store8(out + x, vrshlq_s32(lo, count), vrshlq_s32(hi, count));
+	}
+#elif defined(DLIB_HAVE_SSE2)
+	/* the weights of taps t and t + 1 in the low and high half of every 32 bit lane */
+	__m128i pairs[(CONV_MAX_TAPS + 1) / 2];
+	for (int t = 0; t < n; t += 2) {
+		const unsigned hi = t + 1 < n ? (unsigned short) w[t + 1] : 0;
+		pairs[t / 2] = _mm_set1_epi32((int) (hi << 16 | (unsigned short) w[t]));
+	}
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi32((1 << shift) >> 1);
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	for (; x + 8 <= x1; x += 8) {
+		__m128i lo = zero, hi = zero;
+		for (int t = 0; t < n; t += 2) {
+			const __m128i a = _conv_load8(src[t] + x);
+			const __m128i b = t + 1 < n ? _conv_load8(src[t + 1] + x) : zero;
+			lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), pairs[t / 2]));
+			hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), pairs[t / 2]));
+		}
+		_conv_store8(out + x, _mm_sra_epi32(_mm_add_epi32(lo, half), count),
+				_mm_sra_epi32(_mm_add_epi32(hi, half), count));
+	}
+#endif
+
+	for (; x < x1; x++) {
+		int sum = 0;
+		for (int t = 0; t < n; t++)
+			sum += w[t] * src[t][x];
+		_conv_store(out + x, (sum + ((1 << shift) >> 1)) >> shift);
+	}
+}
+
+/**
+ * @brief Sets up a full kernel.
+ *
+ * @param ck     The kernel
+ * @param k      size * size weights, row major, top left first
+ * @param size   3 or 5
+ * @param shift  The weights are in units of 1 / (1 << shift)
+ * @return       @c false if the size or a weight is out of range
+ */
+bool conv_kernel_init(convkernel* ck, const int* k, int size, int shift)
+{
+	if ((size != 3 && size != 5) || shift < 0 || shift > 24)
+		return false;
+
+	ck->radius = size / 2;
+	ck->shift = shift;
+	ck->separable = false;
+	ck->taps = 0;
+	for (int j = 0; j < size; j++) {
+		for (int i = 0; i < size; i++) {
+			const int w = k[j * size + i];
+			if (w == 0)
+				continue;
+			if (w < -32768 || w > 32767)
+				return false;
+			ck->weights[ck->taps] = (short) w;
+			ck->dy[ck->taps] = (signed char) (j - ck->radius);
+			ck->dx[ck->taps] = (signed char) (i - ck->radius);
+			ck->taps++;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Sets up a separable kernel, the outer product of col and row.
+ *
+ * @param ck     The kernel
+ * @param col    size vertical weights, top first. Their absolute values may
+ *               add up to 128 at most.
+ * @param row    size horizontal weights, left first. Their absolute values
+ *               may add up to 65535 at most, so that 255 times both sums
+ *               stays below 2^31.
+ * @param size   3 or 5
+ * @param shift  The products of a vertical and a horizontal weight are in
+ *               units of 1 / (1 << shift)
+ * @return       @c false if the size or a weight is out of range
+ */
+bool conv_kernel_init_separable(convkernel* ck, const int* col, const int* row, int size, int shift)
+{
+	if ((size != 3 && size != 5) || shift < 0 || shift > 24)
+		return false;
+
+	int col_sum = 0, row_sum = 0;
+	for (int i = 0; i < size; i++) {
+		if (row[i] < -32768 || row[i] > 32767)
+			return false;
+		col_sum += abs(col[i]);
+		row_sum += abs(row[i]);
+	}
+	if (col_sum > CONV_MAX_COL_SUM || row_sum > CONV_MAX_ROW_SUM)
+		return false;
+
+	ck->radius = size / 2;
+	ck->shift = shift;
+	ck->separable = true;
+	ck->taps = 0;
+	for (int i = 0; i < size; i++) {
+		ck->col[i] = (short) col[i];
+		ck->row[i] = (short) row[i];
+	}
+	return true;
+}
+
+/**
+ * @brief Repeats the edge samples of a row into the CONV_PAD bytes left and right of it.
+ *
+ * @param row    The row, with room before and after it
+ * @param width  The row length in bytes, at least step
+ * @param step   1 for luma, 2 for interleaved chroma: Cb is repeated into the Cb slots
+ *               and Cr into the Cr slots
+ */
+void conv_pad_row(unsigned char* row, int width, int step)
+{
+	for (int i = 1; i <= CONV_PAD; i++) {
+		row[-i] = row[(step - i % step) % step];
+		row[width - 1 + i] = row[width - step + (width - 1 + i) % step];
+	}
+}
+
+/**
+ * @brief Convolves one row.
+ *
+ * @param ck     The kernel
+ * @param rows   The 2 * radius + 1 rows centered on the one filtered, padded by
+ *               conv_pad_row()
+ * @param out    Receives the row
+ * @param width  The row length in bytes
+ * @param step   1 for luma, 2 for interleaved chroma
+ * @param temp   Room for width + 2 * CONV_PAD shorts, used by separable kernels
+ */
+void conv_row(const convkernel* ck, const unsigned char* const* rows, unsigned char* out,
+		int width, int step, short* temp)
+{
+	const int r = ck->radius;
+	short w[CONV_MAX_TAPS];
+	int n = 0;
+
+	if (!ck->separable) {
+		const unsigned char* src[CONV_MAX_TAPS];
+		for (int t = 0; t < ck->taps; t++) {
+			src[t] = rows[ck->dy[t] + r] + ck->dx[t] * step;
+			w[t] = ck->weights[t];
+		}
+		_conv_taps(src, w, ck->taps, ck->shift, out, 0, width);
+		return;
+	}
+
+	/* vertical sums, out to the columns the horizontal taps reach */
+	const unsigned char* src[2 * CONV_MAX_RADIUS + 1];
+	for (int j = 0; j <= 2 * r; j++) {
+		if (ck->col[j] != 0) {
+			src[n] = rows[j];
+			w[n++] = ck->col[j];
+		}
+	}
+	short* sums = temp + CONV_PAD;
+	_conv_taps(src, w, n, 0, sums, -r * step, width + r * step);
+
+	const short* hsrc[2 * CONV_MAX_RADIUS + 1];
+	n = 0;
+	for (int i = 0; i <= 2 * r; i++) {
+		if (ck->row[i] != 0) {
+			hsrc[n] = sums + (i - r) * step;
+			w[n++] = ck->row[i];
+		}
+	}
+	_conv_taps(hsrc, w, n, ck->shift, out, 0, width);
+}
@@ -18,10 +18,100 @@
 #include "data.h"
 #include "landmark.h"
 #include "imageutils.h"
+#include "face_tracker.h"
+#include "landmark_filter.h"
+#include "landmark_flow.h"
+#include "sticker_atlas.h"
+#include "sticker_package.h"
+#include "nv12_compositor.h"
+#include "sticker_anim.h"
+#include "draw_list.h"
+#include "dirty_region.h"
+#include "filter_engine.h"
+#include "face_mask.h"
+#include "skin_smooth.h"
+#include "color_lut.h"
+#include "temporal_denoise.h"
+#include "auto_framing.h"
+#include "portrait.h"
+
+#include <algorithm>
+#include <dirent.h>
+
+/* Set to 1 to outline the dirty regions of every frame. */
+#define SHOW_DIRTY_REGIONS 0
+
+/* Set to 1 to average the sensor noise of the preview out over time, before anything else runs. */
+#define DENOISE_PREVIEW 0
+/* Set to 1 to denoise the chroma as well as the luma. */
+#define DENOISE_CHROMA 1
+
+/* Sticker package of the resource directory, see dlib/ffsticker_pack.cpp. */
+#define STICKER_PACKAGE "stickers.ffsticker"
+
+#define STICKER_SETS 6
+#define MAX_SET_STICKERS 4
+
+/* sticker sequences drawn for every value of the sticker button, 0 being none */
+static const char *const sticker_set_names[STICKER_SETS][MAX_SET_STICKERS] = {
+	{ NULL },
+	{ "deer_nose", "deer_left", "deer_right", NULL },
+	{ "hat", NULL },
+	{ "glasses01", NULL },
+	{ "hat", "glasses01", NULL },
+	{ "deer_nose", "deer_left", "deer_right", "glasses01" },
+};
+
+/* kernels of the filter chains, see _build_filters() */
+static const int emboss_kernel[9] = { 2, 1, 0, 1, 1, -1, 0, -1, -2 };
+/* 0.1065, 0.787, 0.1065 down and across, in 1/128 and 1/256 */
+static const int gaussian_col[3] = { 14, 100, 14 };
+static const int gaussian_row[3] = { 27, 202, 27 };
+#define GAUSSIAN_SHIFT 15
+/* flat tones of the cartoon, and the Sobel magnitude inked: an edge of about 40 luma levels */
+#define CARTOON_LEVELS 5
+#define CARTOON_THRESHOLD 160
+
+/* Value of the filter button that smooths the skin of the faces, see face_landmark(). */
+#define FILTER_BEAUTY 10
+/* Value of the filter button that blurs the background behind the faces, see face_landmark(). */
+#define FILTER_PORTRAIT 11
+/* Value of the filter button that draws the frame as a cartoon. */
+#define FILTER_CARTOON 12
+
+/* Color grading looks of the resource directory, the filter values after MAX_FILTER. */
+#define MAX_LOOKS 8
+#define LOOK_SIZE COLOR_LUT_SMALL
 
 typedef struct _camdata {
 	camera_h g_camera; /* Camera handle */
 	std::vector<dlib::rectangle> faces; /* detected faces */
+	std::vector<dlib::rectangle> tracked; /* tracked faces of the current frame */
+	std::vector<unsigned long> track_ids; /* ids of the tracked faces */
+	std::vector<lmfilter> lmfilters; /* landmark smoothing, one per tracked face */
+	unsigned int latency; /* time the preview callback takes, averaged, in ms */
+	std::vector<flowtrack> flowtracks; /* landmarks followed by optical flow, one per tracked face */
+	flowdata flow; /* luma pyramids of the last two frames */
+	stickeratlas stickers; /* every sticker of the resource directory, decoded */
+	const nv12sticker *overlay; /* sticker drawn on the faces, ready to blend */
+	stickeranim anims[STICKER_SETS][MAX_SET_STICKERS]; /* sticker_set_names, resolved, count 0 ends a set */
+	dlib::array2d<unsigned char> gray; /* rotated luma plane of the current frame */
+	trackdata tracker; /* face trackers */
+	drawlist draws; /* stickers of the current frame */
+	dirtylist dirty; /* parts of the current frame the effects touch */
+	filterchain luma_filters[MAX_FILTER + 1]; /* filter of every value of the filter button, 0 being none */
+	filterchain chroma_filters[MAX_FILTER + 1];
+	filterengine filter_rows; /* row scratch of the filters */
+	std::vector<dlib::full_object_detection> shapes; /* landmarks of the faces of the current frame */
+	std::vector<facemask> masks; /* faces smoothed by FILTER_BEAUTY, one per tracked face */
+	facemask region; /* the faces of one dirty region, smoothed at once */
+	skinsmooth skin; /* buffers of the skin smoothing */
+	portrait bokeh; /* mask and background of FILTER_PORTRAIT */
+	colorlut looks[MAX_LOOKS]; /* .cube files of the resource directory, baked, sorted by name */
+	int look_count;
+	denoiser denoise; /* history of the temporal denoising */
+	framing camera_path; /* virtual camera of the auto framing */
+	bool auto_frame; /* the zoom button is past the camera zoom, on auto framing */
 	dlib::shape_predictor sp; /* shape predictor */
 
 	Evas_Object *cam_display;
@@ -41,7 +131,6 @@ typedef struct _camdata {
 	int count;
 } camdata;
 
-static imageinfo imgarr[10];
 static camdata cam_data;
 //static rgbmat rgb_frame;
 
@@ -413,8 +502,18 @@ static void __camera_cb_zoom(void *data, Evas_Object *obj, void *event_info) {
 		PRINT_MSG("Could not get current zoom value.");
 	}
 
-	/* Set new value of the camera zoom attribute */
-	zoom = zoom == max ? min : ++zoom;
+	/* Past the largest camera zoom comes auto framing, then the smallest zoom again. */
+	if (cam_data.auto_frame) {
+		cam_data.auto_frame = false;
+		zoom = min;
+		PRINT_MSG("Auto framing off");
+	} else if (zoom == max) {
+		framing_reset(&cam_data.camera_path);
+		cam_data.auto_frame = true;
+		zoom = min;
+		PRINT_MSG("Auto framing on");
+	} else
+		++zoom;
 	error_code = camera_attr_set_zoom(cam_data.g_camera, zoom);
 	if (CAMERA_ERROR_NONE != error_code) {
 		if (CAMERA_ERROR_NOT_SUPPORTED != error_code) {
@@ -456,7 +555,8 @@ static void __camera_cb_preview(void *data, Evas_Object *obj,
 		EVAS_HINT_EXPAND, EVAS_HINT_EXPAND);
 		evas_object_show(cam_data.cam_display_box);
 
-		/* Start the camera preview. */
+		/* Start the camera preview, on a history of its own. */
+		denoise_reset(&cam_data.denoise);
 		error_code = camera_start_preview(cam_data.g_camera);
 		if (CAMERA_ERROR_NONE != error_code) {
 			DLOG_PRINT_ERROR("camera_start_preview", error_code);
@@ -513,7 +613,7 @@ static void __camera_cb_preview(void *data, Evas_Object *obj,
  */
 static int camera_attr_get_filter_range(int *min, int *max) {
 	*min = 0;
-	*max = MAX_FILTER;
+	*max = MAX_FILTER + cam_data.look_count;
 	return 0;
 }
 
@@ -535,329 +635,12 @@ static int camera_attr_set_filter(int filter) {
 	return 0;
 }
 
-void _chroma_mod_sepia(unsigned char* data, uint64_t size) {
-	uint64_t i = 0;
-
-	for (i = 0; i < size; i++) {
-		int Cval = (int) (data[i]);
-
-		if (i % 2 == 0) //Even byte reflects Cb chroma value
-				{
-			Cval = 114; //Setting the Cb value to look like sepia
-		} else //Odd byte reflects Cr chroma value
-		{
-			Cval = 144; //Setting the Cr value to look like sepia
-		}
-		data[i] = (unsigned char) Cval;
-	}
-}
-
-void _grayscale_mod(unsigned char* data, uint64_t size) {
-	uint64_t i = 0;
-	for (i = 0; i < size; i++) {
-		data[i] = 128;
-	}
-}
-
-void _invert_mod(unsigned char* data, uint64_t size) {
-	uint_fast64_t i = 0; // can't find difference between uint64 vs fast64
-	for (i = 0; i < size; i++) {
-		data[i] = 255 - data[i];
-	}
-}
-
-void _nored_mod(unsigned char* data, uint64_t size) {
-	uint_fast64_t i = 0; // can't find difference between uint64 vs fast64
-	for (i = 0; i < size; i++) {
-		if (i % 2 == 1)
-			data[i] = 128;
-	}
-}
-
-void _noblue_mod(unsigned char* data, uint64_t size) {
-	uint_fast64_t i = 0; // can't find difference between uint64 vs fast64
-	for (i = 0; i < size; i++) {
-		if (i % 2 == 0)
-			data[i] = 128;
-	}
-}
-
-void _emboss_mod(unsigned char* data, uint64_t size) {
-	uint64_t x = 0;
-	uint64_t w = (uint64_t) cam_data.width;
-	float mask[9] = { -2.0f, -1.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 2.0f };
-
-	unsigned char* ndata;
-	ndata = (unsigned char*) malloc(sizeof(unsigned char) * size);
-
-	for (x = 0; x < size; x++) {
-		float val[9] = { 0, };
-		if (x < w + 1)
-			val[0] = 0;
-		else
-			val[0] = data[x - w - 1] * mask[8];
-
-		if (x < w)
-			val[1] = 0;
-		else
-			val[1] = data[x - w] * mask[7];
-
-		if (x < w - 1)
-			val[2] = 0;
-		else
-			val[2] = data[x - w + 1] * mask[6];
-
-		if (x < 1)
-			val[3] = 0;
-		else
-			val[3] = data[x - 1] * mask[5];
-
-		val[4] = data[x] * mask[4];
-
-		if (x + 1 > size)
-			val[5] = 0;
-		else
-			val[5] = data[x + 1] * mask[3];
-
-		if (x + w - 1 > size)
-			val[6] = 0;
-		else
-			val[6] = data[x + w - 1] * mask[2];
-
-		if (x + w > size)
-			val[7] = 0;
-		else
-			val[7] = data[x + w] * mask[1];
-
-		if (x + w + 1 > size)
-			val[8] = 0;
-		else
-			val[8] = data[x + w + 1] * mask[0];
-
-		float sum = 0;
-		for (int i = 0; i < 9; i++)
-			sum += val[i];
-
-		ndata[x] = (unsigned char) sum;
-		//ndata[x] =(unsigned char) (sum/8);
-	}
-	memcpy(data, ndata, sizeof(unsigned char) * size);
-}
-void _emboss_mod_uv(unsigned char* data, uint64_t size) {
-	uint64_t x = 0;
-	uint64_t w = (uint64_t) cam_data.width;
-	float mask[9] = { -2.0f, -1.0f, 0.0f, -1.0f, 1.0f, 1.0f, 0.0f, 1.0f, 2.0f };
-
-	unsigned char* ndata;
-	ndata = (unsigned char*) malloc(sizeof(unsigned char) * size);
-
-	for (x = 0; x < size; x++) {
-		float val[9] = { 0, };
-		if (x < w + 2)
-			val[0] = 0;
-		else
-			val[0] = data[x - w - 2] * mask[8];
-
-		if (x < w)
-			val[1] = 0;
-		else
-			val[1] = data[x - w] * mask[7];
-
-		if (x < w - 2)
-			val[2] = 0;
-		else
-			val[2] = data[x - w + 2] * mask[6];
-
-		if (x < 2)
-			val[3] = 0;
-		else
-			val[3] = data[x - 2] * mask[5];
-
-		val[4] = data[x] * mask[4];
-
-		if (x + 2 > size)
-			val[5] = 0;
-		else
-			val[5] = data[x + 2] * mask[3];
-
-		if (x + w - 2 > size)
-			val[6] = 0;
-		else
-			val[6] = data[x + w - 2] * mask[2];
-
-		if (x + w > size)
-			val[7] = 0;
-		else
-			val[7] = data[x + w] * mask[1];
-
-		if (x + w + 2 > size)
-			val[8] = 0;
-		else
-			val[8] = data[x + w + 2] * mask[0];
-
-		float sum = 0;
-		for (int i = 0; i < 9; i++)
-			sum += val[i];
-
-		ndata[x] = (unsigned char) sum;
-		//ndata[x] =(unsigned char) (sum/8);
-	}
-	memcpy(data, ndata, sizeof(unsigned char) * size);
-}
-
-void _gaussian_mod(unsigned char* data, uint64_t size) {
-	uint64_t x = 0;
-	uint64_t w = (uint64_t) cam_data.width;
-//	float xmask[5] = {.0003, .1065, .7866, .1065, .0003};
-	float mask[9] = { .0113, .0838, .0113, .0838, .6193, .0838, .0113, .0838,
-			.0113 };
-
-	unsigned char* ndata;
-	ndata = (unsigned char*) malloc(sizeof(unsigned char) * size);
-
-	for (x = 0; x < size; x++) {
-		float val[9] = { 0, };
-		if (x < w + 1)
-			val[0] = 0;
-		else
-			val[0] = data[x - w - 1] * mask[8];
-
-		if (x < w)
-			val[1] = 0;
-		else
-			val[1] = data[x - w] * mask[7];
-
-		if (x < w - 1)
-			val[2] = 0;
-		else
-			val[2] = data[x - w + 1] * mask[6];
-
-		if (x < 1)
-			val[3] = 0;
-		else
-			val[3] = data[x - 1] * mask[5];
-
-		val[4] = data[x] * mask[4];
-
-		if (x + 1 > size)
-			val[5] = 0;
-		else
-			val[5] = data[x + 1] * mask[3];
-
-		if (x + w - 1 > size)
-			val[6] = 0;
-		else
-			val[6] = data[x + w - 1] * mask[2];
-
-		if (x + w > size)
-			val[7] = 0;
-		else
-			val[7] = data[x + w] * mask[1];
-
-		if (x + w + 1 > size)
-			val[8] = 0;
-		else
-			val[8] = data[x + w + 1] * mask[0];
-
-		float sum = 0;
-		for (int i = 0; i < 8; i++)
-			sum += val[i];
-
-		ndata[x] = (unsigned char) sum;
-		//ndata[x] =(unsigned char) (sum/8);
-	}
-	memcpy(data, ndata, sizeof(unsigned char) * size);
-}
-
-void _gaussian_mod_uv(unsigned char* data, uint64_t size) {
-	uint64_t x = 0;
-	uint64_t w = (uint64_t) cam_data.width;
-	float mask[9] = { .0113, .0838, .0113, .0838, .6193, .0838, .0113, .0838,
-			.0113 };
-
-	unsigned char* ndata = (unsigned char*) malloc(
-			sizeof(unsigned char) * size);
-
-	for (x = 0; x < size; x++) {
-		float val[9] = { 0, };
-		if (x < 8)
-			val[0] = 0;
-		else
-			val[0] = data[x - 8] * mask[8];
-
-		if (x < 6)
-			val[1] = 0;
-		else
-			val[1] = data[x - 6] * mask[7];
-
-		if (x < 4)
-			val[2] = 0;
-		else
-			val[2] = data[x - 4] * mask[6];
-
-		if (x < 2)
-			val[3] = 0;
-		else
-			val[3] = data[x - 2] * mask[5];
-
-		val[4] = data[x] * mask[4];
-
-		if (x + 2 > size)
-			val[5] = 0;
-		else
-			val[5] = data[x + 2] * mask[3];
-
-		if (x + 4 > size)
-			val[6] = 0;
-		else
-			val[6] = data[x + 4] * mask[2];
-
-		if (x + 6 > size)
-			val[7] = 0;
-		else
-			val[7] = data[x + 6] * mask[1];
-
-		if (x + 8 > size)
-			val[8] = 0;
-		else
-			val[8] = data[x + 8] * mask[0];
-
-		float sum = 0;
-		for (int i = 0; i < 8; i++)
-			sum += val[i];
-
-		ndata[x] = (unsigned char) sum;
-	}
-
-	memcpy(data, ndata, sizeof(unsigned char) * size);
-}
-
-void _pinky_mod(unsigned char* data, uint64_t size) {
-	uint_fast64_t i = 0; // can't find difference between uint64 vs fast64
-	for (i = 0; i < size; i++) {
-		if (data[i] < 128)
-			data[i] *= 1.2;
-	}
-}
-
-void _pinky_mod_uv(unsigned char* data, uint64_t size) {
-	uint_fast64_t i = 0; // can't find difference between uint64 vs fast64
-	for (i = 0; i < size; i++) {
-		if (data[i] % 2 == 0)
-			data[i] *= 1.2;
-	}
-}
-
 static void __camera_cb_filter(void *data, Evas_Object *obj, void *event_info) {
 	/*
 	 * Get the minimal and maximal supported value for the camera filter
 	 */
 	int min, max;
 
-//	_image_util_start_cb(NULL);
-
-	return;
-
 	int error_code = camera_attr_get_filter_range(&min, &max);
 	if (CAMERA_ERROR_NONE != error_code) {
 		DLOG_PRINT_ERROR("camera_attr_get_filter_range", error_code);
@@ -886,12 +669,6 @@ static void __camera_cb_filter(void *data, Evas_Object *obj, void *event_info) {
 					"Camera filter is not supported on this device.");
 	} else
 		PRINT_MSG("Filter set to %d", filter);
-
-	/* TODO: Apply filter to preview image */
-	//if (camera_set_preview_cb(cam_data.g_camera, _camera_preview_callback, NULL)
-	//		== CAMERA_ERROR_NONE) {
-	//PRINT_MSG("ready to modify");
-	//}
 }
 
 static int camera_attr_get_sticker_range(int* min, int* max) {
@@ -932,26 +709,66 @@ static void _camera_face_detected_cb(camera_detected_face_s* faces, int count,
 		//PRINT_MSG("Face[%d]_x: %d, Face[%d]_y: %d\n", i, faces[i].x, i,	faces[i].y);
 	}
 
+	/* detections only spawn or re-acquire tracks, see face_tracker.cpp */
+	face_tracker_set_detections(&cam_data.tracker, cam_data.faces);
+
 	time = (double) (clock() - begin) / CLOCKS_PER_SEC;
 	//PRINT_MSG("face format conversion takes %f sec", time);
 }
 
-void face_landmark(camera_preview_data_s *frame, int count)
+/**
+ * @brief Copies the luma plane of the frame into a rotated grayscale image.
+ * @details The trackers and the shape predictor share this image, so it is
+ *          built once per frame and reuses its buffer between frames.
+ */
+static void _frame_to_gray(camera_preview_data_s *frame, dlib::array2d<unsigned char>& img)
 {
-	//clock_t begin;
-	dlib::array2d<u_int64_t> img;
 	img.set_size(frame->width, frame->height);
 	if (frame->data.double_plane.y_size != frame->width * frame->height) {
 		PRINT_MSG("Error: y_size: %d, width: %d, height: %d",
 				frame->data.double_plane.y_size, frame->width, frame->height);
-		//return NULL;
 	}
 
-
 	for (int i = 0; i < frame->data.double_plane.y_size; i++) {
 		// img[i % frame->width][ i / frame->width] = (frame->data.double_plane.y)[i];
 		img[i % frame->width][frame->height - i / frame->width-1] = (frame->data.double_plane.y)[i];
 	}
+}
+
+/**
+ * @brief Smooths the skin of the faces, one dirty face region at a time.
+ * @details Faces that overlap end up in the same merged region, and their
+ *          masks are combined, so no pixel is smoothed twice.
+ *
+ * @param frame  The frame
+ * @param masks  The number of faces in cam_data.masks
+ */
+static void _smooth_skin(camera_preview_data_s *frame, int masks)
+{
+	for (size_t i = 0; i < cam_data.dirty.rects.size(); i++) {
+		const dirtyrect& r = cam_data.dirty.rects[i];
+		if ((r.kinds & DIRTY_FACE) == 0)
+			continue;
+		if (face_mask_union(&cam_data.region, &cam_data.masks[0], masks, r.left, r.top, r.right, r.bottom))
+			skin_smooth_face(&cam_data.skin, frame->data.double_plane.y, frame->width, frame->height,
+					&cam_data.region, SKIN_RADIUS, SKIN_EPS);
+	}
+}
+
+void face_landmark(camera_preview_data_s *frame, int count)
+{
+	//clock_t begin;
+	const dlib::array2d<unsigned char>& img = cam_data.gray;
+	const unsigned long long now = sticker_anim_clock();
+	const unsigned int lead = std::min(cam_data.latency, (unsigned int) LMF_MAX_LEAD);
+
+	draw_list_clear(&cam_data.draws);
+	cam_data.shapes.resize(count);
+	if (cam_data.masks.size() < (size_t) count)
+		cam_data.masks.resize(count);
+	int masks = 0;
+	if (cam_data.filter == FILTER_PORTRAIT)
+		portrait_begin(&cam_data.bokeh, frame->data.double_plane.y, frame->width, frame->height);
 
 	//float time = (double) (clock() - begin) / CLOCKS_PER_SEC; // TM1: 0.3 sec
 	//PRINT_MSG("frame format conversion takes %f sec", time);
@@ -959,75 +776,155 @@ void face_landmark(camera_preview_data_s *frame, int count)
 	// Now we will go ask the shape_predictor to tell us the pose of
 	// each face we detected.
 	for (unsigned long i = 0; i < count; ++i) {
-		//begin = clock();
-		dlib::full_object_detection shape = cam_data.sp(img, cam_data.faces[i]);
-		//time = (double) (clock() - begin) / CLOCKS_PER_SEC; // TM1: 0.1 sec
-		//PRINT_MSG("Finding landmark takes %f sec", time);
+		/* follow the landmarks with the flow, and only fit them again when it drifts */
+		flowtrack* ft = landmark_flow_find(cam_data.flowtracks, cam_data.track_ids[i]);
+		landmark_flow_track(&cam_data.flow, ft);
+		if (landmark_flow_need_fit(ft, cam_data.tracked[i])) {
+			//begin = clock();
+			landmark_flow_set_shape(ft, cam_data.sp(img, cam_data.tracked[i]));
+			//time = (double) (clock() - begin) / CLOCKS_PER_SEC; // TM1: 0.1 sec
+			//PRINT_MSG("Finding landmark takes %f sec", time);
+		}
+		dlib::full_object_detection& shape = cam_data.shapes[i];
+		shape = ft->shape;
+
+		/*
+		 * smooth out the jitter of the shape predictor, and extrapolate the
+		 * landmarks to when the frame is shown, after the callback returns
+		 */
+		lmfilter* lf = landmark_filter_find(cam_data.lmfilters, cam_data.track_ids[i]);
+		landmark_filter_update(lf, shape, frame->timestamp);
+		landmark_filter_predict(lf, frame->timestamp + lead, shape);
+
+		/* the skin is smoothed once every face is in, see _smooth_skin() */
+		if (cam_data.filter == FILTER_BEAUTY
+				&& face_mask_build(&cam_data.masks[masks], shape, FACE_MASK_OUTLINE, frame->width, frame->height)) {
+			const facemask* fm = &cam_data.masks[masks++];
+			dirty_list_add(&cam_data.dirty, fm->left, fm->top, fm->left + fm->width,
+					fm->top + fm->height, DIRTY_FACE);
+		}
+
+		if (cam_data.filter == FILTER_PORTRAIT)
+			portrait_add_figure(&cam_data.bokeh, shape, frame->width, frame->height);
 
-		draw_landmark(frame, shape);
 		int x = shape.part(i)(1);
 		int y = frame->height - shape.part(i)(0);
-		if(imgarr != NULL && imgarr[0].size > 0)
-		{
-			_image_util_imgcpy(frame, &imgarr[0], x, y);
-		}
+		if (cam_data.overlay != NULL)
+			draw_list_add_nv12(&cam_data.draws, frame->width, frame->height, cam_data.overlay, x, y);
 
-		 switch(cam_data.sticker) {
-		 case 1:
-		 //sticker_mustache(shape);
-		 break;
-		 case 2:
-		 //sticker_hairband(shape);
-		 break;
-		 case 3:
-		 //sticker_ear(shape);
-		 break;
-		 case 4:
-		 //sticker_hat(shape);
-		 break;
-		 case 5:
-		 //sticker_glasses(shape);
-		 break;
-		 default:
-		 break;
-		 }
+		/* stickers follow the position, size and roll of the face, every face animates on its own */
+		for (int k = 0; k < MAX_SET_STICKERS; k++) {
+			const stickeranim* anim = &cam_data.anims[cam_data.sticker][k];
+			if (anim->count == 0)
+				break;
+			draw_list_add_warp(&cam_data.draws, frame->width, frame->height,
+					sticker_anim_frame(anim, cam_data.track_ids[i], now),
+					anim->frames[0], anim->layout, shape);
+		}
 	}
+
+	/* every region of the frame is known now, region stages from here on only visit these */
+	draw_list_mark(&cam_data.draws, &cam_data.dirty);
+	dirty_list_merge(&cam_data.dirty);
+
+	/* the skin is smoothed under the landmarks and the stickers */
+	if (cam_data.filter == FILTER_BEAUTY)
+		_smooth_skin(frame, masks);
+	for (int i = 0; i < count; i++)
+		draw_landmark(frame, cam_data.shapes[i]);
+
+	/* the background is blurred once every face is in, under the stickers */
+	if (cam_data.filter == FILTER_PORTRAIT)
+		portrait_apply(&cam_data.bokeh, frame->data.double_plane.y, frame->data.double_plane.uv,
+				frame->width, frame->height, cam_data.filter_rows.pool);
+
+	/* every sticker of every face in one sweep over the frame */
+	draw_list_paint(&cam_data.draws, frame->data.double_plane.y, frame->data.double_plane.uv,
+			frame->width, frame->height);
 }
 
 void _camera_preview_callback(camera_preview_data_s *frame, void *user_data) {
 	if (frame->format == CAMERA_PIXEL_FORMAT_NV12
 			&& frame->num_of_planes == 2) {
+		const unsigned long long start = sticker_anim_clock();
+
+		/* the trackers and the landmarks see the denoised frame, so they jitter less */
+		if (DENOISE_PREVIEW)
+			denoise_frame(&cam_data.denoise, frame->data.double_plane.y,
+					frame->data.double_plane.uv, frame->width, frame->height,
+					DENOISE_CHROMA, cam_data.filter_rows.pool);
+
+		/* follow the faces into this frame */
+		_frame_to_gray(frame, cam_data.gray);
+		face_tracker_update(&cam_data.tracker, cam_data.gray, cam_data.tracked,
+				cam_data.track_ids);
+
+		dirty_list_begin(&cam_data.dirty, frame->width, frame->height);
+		for (size_t i = 0; i < cam_data.tracked.size(); i++) {
+			/* back from the rotated gray image to the frame */
+			const dlib::rectangle& r = cam_data.tracked[i];
+			dirty_list_add(&cam_data.dirty, r.top(), frame->height - 1 - r.right(),
+					r.bottom() + 1, frame->height - r.left(), DIRTY_FACE);
+		}
+		landmark_filter_prune(cam_data.lmfilters, cam_data.track_ids);
+		landmark_flow_prune(cam_data.flowtracks, cam_data.track_ids);
+
+		/* the virtual camera follows the faces found on the whole frame */
+		int left = 0, top = 0, width = frame->width, height = frame->height;
+		if (cam_data.auto_frame) {
+			framing_update(&cam_data.camera_path, cam_data.tracked, frame->width, frame->height,
+					frame->timestamp);
+			if (framing_active(&cam_data.camera_path, frame->width, frame->height)) {
+				left = cam_data.camera_path.left;
+				top = cam_data.camera_path.top;
+				width = cam_data.camera_path.width;
+				height = cam_data.camera_path.height;
+			}
+		}
+
+		/*
+		 * the filter goes under the stickers, the faces are followed on the
+		 * unfiltered gray image, and only what is shown gets filtered
+		 */
+		unsigned char* y = frame->data.double_plane.y + (size_t) top * frame->width + left;
+		unsigned char* uv = frame->data.double_plane.uv + (size_t) (top / 2) * frame->width + left;
+		if (cam_data.filter > MAX_FILTER) {
+			color_lut_apply(&cam_data.looks[cam_data.filter - MAX_FILTER - 1], y, uv,
+					width, height, frame->width, cam_data.filter_rows.pool);
+		} else {
+			filter_engine_run(&cam_data.filter_rows, &cam_data.luma_filters[cam_data.filter],
+					y, width, height, frame->width);
+			filter_engine_run(&cam_data.filter_rows, &cam_data.chroma_filters[cam_data.filter],
+					uv, width, height / 2, frame->width);
+		}
 
-		std::vector<dlib::rectangle> buf =
-				*((std::vector<dlib::rectangle>*) user_data);
-		size_t count = buf.size();
+		size_t count = cam_data.tracked.size();
 		/* get face landmark */
 		if (count > 0) {
+			/* faces that appear after a gap are fitted before the flow runs on them */
+			landmark_flow_push_frame(&cam_data.flow, cam_data.gray);
 			//clock_t sTime = clock();
 			face_landmark(frame, count);
 			//float time = (double) (clock() - sTime) / CLOCKS_PER_SEC; // 0.3 sec in TM1
 			//PRINT_MSG("Face landmark takes %f sec", time);
 
-			switch (cam_data.sticker) {
-			case 0: //
-				break;
-			case 1: // mustache
-				break;
-			case 2: // hat
-				break;
-			case 3: // ear
-				break;
-			case 4: // glasses
-				break;
-			case 5: // hairband
-				break;
-			default:
-				break;
-			}
-
 			//time_t eTime = clock();
 			//float gap = (float) (eTime - sTime) / (CLOCKS_PER_SEC);
 		}
+
+		/* merged by face_landmark(), empty without faces */
+		if (SHOW_DIRTY_REGIONS)
+			dirty_list_draw(&cam_data.dirty, frame->data.double_plane.y,
+					frame->data.double_plane.uv);
+
+		/* last, the window is scaled over the frame, stickers and all */
+		if (cam_data.auto_frame)
+			framing_apply(&cam_data.camera_path, frame->data.double_plane.y,
+					frame->data.double_plane.uv, frame->width, frame->height);
+
+		/* the frame is shown once this returns, the next landmarks are predicted that far ahead */
+		const unsigned int elapsed = (unsigned int) (sticker_anim_clock() - start);
+		cam_data.latency = (3 * cam_data.latency + elapsed) / 4;
 	} else {
 		dlog_print(DLOG_ERROR, LOG_TAG,
 				"This preview frame format is not supported!");
@@ -1160,6 +1057,13 @@ void camera_pop_cb() {
 
 	/* Unregister camera preview callback. */
 
+	/* Stop the face trackers. */
+	face_tracker_release(&cam_data.tracker);
+	draw_list_release(&cam_data.draws);
+	filter_engine_release(&cam_data.filter_rows);
+	sticker_atlas_release(&cam_data.stickers);
+	cam_data.overlay = NULL;
+
 	/* Destroy camera handle. */
 	camera_destroy(cam_data.g_camera);
 	cam_data.g_camera = NULL;
@@ -1195,6 +1099,143 @@ void _post_render_cb(void *data, Evas *e, Evas_Object *obj, void *event_info) {
 	evas_object_move(*cam_data_image, 0, y);
 }
 
+/**
+ * @brief Loads the stickers of the resource directory into the atlas.
+ * @details Runs once at startup. The sticker package is mapped if there is
+ *          one. Otherwise every sticker JPEG is decoded, with one decoding
+ *          thread per core. Either way the preview callback never has to
+ *          read or scale a file.
+ */
+static void _load_stickers(void)
+{
+	char *resource_path = app_get_resource_path();
+	std::string package = std::string(resource_path) + STICKER_PACKAGE;
+
+	unsigned long count = sticker_package_map(&cam_data.stickers, package.c_str());
+	if (count > 0) {
+		PRINT_MSG("Mapped %lu stickers", count);
+	} else {
+		std::vector<std::string> paths;
+
+		DIR *dir = opendir(resource_path);
+		if (dir == NULL) {
+			PRINT_MSG("Could not open the resource directory.");
+			free(resource_path);
+			return;
+		}
+
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL) {
+			const char *ext = strrchr(entry->d_name, '.');
+			if (ext != NULL && strcmp(ext, ".jpg") == 0)
+				paths.push_back(std::string(resource_path) + entry->d_name);
+		}
+		closedir(dir);
+
+		count = sticker_atlas_load(&cam_data.stickers, paths,
+				_image_util_decode_sticker, std::thread::hardware_concurrency());
+		PRINT_MSG("Loaded %lu of %zu stickers", count, paths.size());
+	}
+	free(resource_path);
+
+	/* rot is stored in the orientation of the frame already */
+	const sticker* st = sticker_atlas_find(&cam_data.stickers, "rot");
+	cam_data.overlay = st != NULL ? &st->nv12 : NULL;
+
+	/* resolve the names once, the frame loop only follows pointers */
+	for (int i = 0; i < STICKER_SETS; i++) {
+		int n = 0;
+		for (int k = 0; k < MAX_SET_STICKERS && sticker_set_names[i][k] != NULL; k++) {
+			if (sticker_anim_load(&cam_data.stickers, sticker_set_names[i][k], &cam_data.anims[i][n]))
+				n++;
+			else
+				PRINT_MSG("Sticker %s is missing", sticker_set_names[i][k]);
+		}
+		for (; n < MAX_SET_STICKERS; n++)
+			cam_data.anims[i][n].count = 0;
+	}
+}
+
+/**
+ * @brief Bakes the color grading looks of the resource directory.
+ * @details Runs once at startup, every .cube file becomes a filter value
+ *          after MAX_FILTER. Switching filters only picks a baked table.
+ */
+static void _load_looks(void)
+{
+	char *resource_path = app_get_resource_path();
+	std::vector<std::string> names;
+
+	DIR *dir = opendir(resource_path);
+	if (dir != NULL) {
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL) {
+			const char *ext = strrchr(entry->d_name, '.');
+			if (ext != NULL && strcmp(ext, ".cube") == 0)
+				names.push_back(entry->d_name);
+		}
+		closedir(dir);
+	}
+	std::sort(names.begin(), names.end());
+
+	cam_data.look_count = 0;
+	for (size_t i = 0; i < names.size() && cam_data.look_count < MAX_LOOKS; i++) {
+		const std::string path = std::string(resource_path) + names[i];
+		if (color_lut_load(&cam_data.looks[cam_data.look_count], path.c_str(), LOOK_SIZE))
+			cam_data.look_count++;
+		else
+			PRINT_MSG("Could not load the look %s", names[i].c_str());
+	}
+	free(resource_path);
+}
+
+/**
+ * @brief Builds the luma and chroma chain of every filter.
+ * @details Runs once at startup. The preview callback only picks the
+ *          chains of the current filter.
+ */
+static void _build_filters(void)
+{
+	for (int i = 0; i <= MAX_FILTER; i++) {
+		filter_chain_init(&cam_data.luma_filters[i], 1);
+		filter_chain_init(&cam_data.chroma_filters[i], 2);
+	}
+
+	/* 1: sepia */
+	filter_chain_add_chroma(&cam_data.chroma_filters[1], 114, 144);
+	/* 2: grayscale */
+	filter_chain_add_chroma(&cam_data.chroma_filters[2], 128, 128);
+	/* 3: negative */
+	filter_chain_add_invert(&cam_data.luma_filters[3]);
+	filter_chain_add_invert(&cam_data.chroma_filters[3]);
+	/* 4: no red */
+	filter_chain_add_chroma(&cam_data.chroma_filters[4], -1, 128);
+	/* 5: no blue */
+	filter_chain_add_chroma(&cam_data.chroma_filters[5], 128, -1);
+	/* 6: emboss */
+	filter_chain_add_kernel(&cam_data.luma_filters[6], emboss_kernel, 3, 0);
+	filter_chain_add_kernel(&cam_data.chroma_filters[6], emboss_kernel, 3, 0);
+	/* 7: blur */
+	filter_chain_add_separable(&cam_data.luma_filters[7], gaussian_col, gaussian_row, 3,
+			GAUSSIAN_SHIFT);
+	filter_chain_add_separable(&cam_data.chroma_filters[7], gaussian_col, gaussian_row, 3,
+			GAUSSIAN_SHIFT);
+	/* 8: pinky */
+	filter_chain_add_pinky(&cam_data.luma_filters[8]);
+	filter_chain_add_pinky(&cam_data.chroma_filters[8]);
+	/* 9: soft emboss in sepia, both kernels in the same sweep */
+	filter_chain_add_separable(&cam_data.luma_filters[9], gaussian_col, gaussian_row, 3,
+			GAUSSIAN_SHIFT);
+	filter_chain_add_kernel(&cam_data.luma_filters[9], emboss_kernel, 3, 0);
+	filter_chain_add_chroma(&cam_data.chroma_filters[9], 114, 144);
+	/* FILTER_BEAUTY: no chain, the faces are smoothed once their landmarks are known */
+	/* FILTER_PORTRAIT: no chain, the background is blurred once every face is known */
+	/* FILTER_CARTOON: ink lines over flat tones, and flattened chroma */
+	filter_chain_add_cartoon(&cam_data.luma_filters[FILTER_CARTOON], CARTOON_LEVELS, CARTOON_THRESHOLD);
+	filter_chain_add_median(&cam_data.chroma_filters[FILTER_CARTOON]);
+
+}
+
 /**
  * @brief Creates the main view of the application.
  *
@@ -1369,6 +1410,14 @@ void create_buttons_in_main_window(void) {
 		PRINT_MSG("Could not get the path to the Camera directory.");
 	}
 
-	_image_util_start_cb(&imgarr[0]);
-	PRINT_MSG("Got the imgarr : %d", imgarr[0].size);
+	_load_stickers();
+	_build_filters();
+	_load_looks();
+
+	/* One tracker update per face runs on this pool. */
+	face_tracker_init(&cam_data.tracker, std::thread::hardware_concurrency());
+	/* and the bands of the stickers on this one */
+	draw_list_init(&cam_data.draws, std::thread::hardware_concurrency());
+	/* the strips of the filters on this one */
+	filter_engine_init(&cam_data.filter_rows, std::thread::hardware_concurrency());
 }
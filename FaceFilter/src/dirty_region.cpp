@@ -0,0 +1,115 @@
+/*
+ * dirty_region.cpp
+ *
+ *  Regions are kept on even coordinates so every one of them covers whole
+ *  2x2 blocks, and a region stage can work on luma and chroma alike.
+ *  Overlapping regions are merged into their bounding box: a stage that
+ *  is not idempotent, a blur for instance, must not see a pixel twice.
+ */
+
+#include "dirty_region.h"
+
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @brief Starts the list of a new frame, keeping the storage of the last one.
+ */
+void dirty_list_begin(dirtylist* dl, int width, int height)
+{
+	if (dl->rects.capacity() < MAX_DIRTY)
+		dl->rects.reserve(MAX_DIRTY);
+	dl->rects.clear();
+	dl->width = width;
+	dl->height = height;
+}
+
+/**
+ * @brief Adds the region [left, right) x [top, bottom), in frame coordinates.
+ * @details The region is grown to even coordinates and clipped to the frame.
+ *          Regions outside of the frame are dropped.
+ */
+void dirty_list_add(dirtylist* dl, int left, int top, int right, int bottom, unsigned kind)
+{
+	dirtyrect r;
+	r.left = std::max(left - (left & 1), 0);
+	r.top = std::max(top - (top & 1), 0);
+	r.right = std::min(right + (right & 1), dl->width);
+	r.bottom = std::min(bottom + (bottom & 1), dl->height);
+	r.kinds = kind;
+	if (r.left < r.right && r.top < r.bottom)
+		dl->rects.push_back(r);
+}
+
+static bool _dirty_overlap(const dirtyrect& a, const dirtyrect& b)
+{
+	return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
+
+/**
+ * @brief Merges overlapping regions until none overlap.
+ */
+void dirty_list_merge(dirtylist* dl)
+{
+	std::vector<dirtyrect>& rects = dl->rects;
+	bool merged = true;
+
+	while (merged) {
+		merged = false;
+		for (size_t i = 0; i < rects.size(); i++) {
+			for (size_t k = i + 1; k < rects.size(); k++) {
+				if (!_dirty_overlap(rects[i], rects[k]))
+					continue;
+				rects[i].left = std::min(rects[i].left, rects[k].left);
+				rects[i].top = std::min(rects[i].top, rects[k].top);
+				rects[i].right = std::max(rects[i].right, rects[k].right);
+				rects[i].bottom = std::max(rects[i].bottom, rects[k].bottom);
+				rects[i].kinds |= rects[k].kinds;
+				rects[k] = rects.back();
+				rects.pop_back();
+				/* the grown region may now overlap one that was checked already */
+				merged = true;
+				k = i;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Outlines every region on the frame, for debugging.
+ * @details Sticker regions are drawn green and face regions magenta, and a
+ *          region that is both is drawn white. The outline is one chroma
+ *          sample (two pixels) wide, inside the region.
+ */
+void dirty_list_draw(const dirtylist* dl, unsigned char* y, unsigned char* uv)
+{
+	const int width = dl->width;
+
+	for (size_t i = 0; i < dl->rects.size(); i++) {
+		const dirtyrect& r = dl->rects[i];
+		/* BT.601 limited range green, magenta and white */
+		unsigned char luma = 145, cb = 54, cr = 34;
+		if (r.kinds == DIRTY_FACE) {
+			luma = 105;
+			cb = 202;
+			cr = 222;
+		} else if (r.kinds != DIRTY_STICKER) {
+			luma = 235;
+			cb = 128;
+			cr = 128;
+		}
+
+		for (int row = r.top; row < r.bottom; row += 2) {
+			const bool edge = row == r.top || row + 2 == r.bottom;
+			/* the whole row on the top and bottom edges, the two sides elsewhere */
+			const int step = edge ? 2 : std::max(r.right - 2 - r.left, 2);
+			unsigned char* c = uv + (row / 2) * width;
+			for (int col = r.left; col < r.right; col += step) {
+				y[row * width + col] = y[row * width + col + 1] = luma;
+				y[(row + 1) * width + col] = y[(row + 1) * width + col + 1] = luma;
+				c[col] = cb;
+				c[col + 1] = cr;
+			}
+		}
+	}
+}
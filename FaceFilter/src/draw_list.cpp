@@ -0,0 +1,144 @@
+/*
+ * draw_list.cpp
+ *
+ *  Every band goes through the commands in the order they were added and
+ *  paints the rows each one has in the band. A pixel therefore sees the
+ *  same blends in the same order as when every sticker is painted over the
+ *  whole frame in turn, and the result is identical. Bands share no row,
+ *  luma or chroma, so they can be painted in parallel.
+ */
+
+#include "draw_list.h"
+
+#include <algorithm>
+
+/**
+ * @brief Prepares an empty list.
+ *
+ * @param dl           The list
+ * @param num_threads  The number of threads painting the bands, 1 or less
+ *                     to paint them on the calling thread
+ */
+void draw_list_init(drawlist* dl, unsigned long num_threads)
+{
+	dl->draws.clear();
+	dl->draws.reserve(MAX_DRAWS);
+
+	if (dl->pool == NULL && num_threads > 1)
+		dl->pool = new dlib::thread_pool(num_threads);
+}
+
+void draw_list_release(drawlist* dl)
+{
+	delete dl->pool;
+	dl->pool = NULL;
+	dl->draws.clear();
+}
+
+/**
+ * @brief Drops the commands of the last frame, keeping their storage.
+ */
+void draw_list_clear(drawlist* dl)
+{
+	dl->draws.clear();
+}
+
+/**
+ * @brief Adds a sticker blended unwarped, centered on (cx, cy).
+ */
+void draw_list_add_nv12(drawlist* dl, int width, int height, const nv12sticker* st, int cx, int cy)
+{
+	drawcmd cmd;
+	cmd.nv12 = st;
+	cmd.cx = cx;
+	cmd.cy = cy;
+	/* the same even position nv12_blend_sticker() moves it to */
+	cmd.left = cx - st->width / 2;
+	cmd.left -= cmd.left & 1;
+	cmd.top = cy - st->height / 2;
+	cmd.top -= cmd.top & 1;
+	cmd.right = std::min(cmd.left + st->width, width);
+	cmd.bottom = std::min(cmd.top + st->height, height);
+	cmd.left = std::max(cmd.left, 0);
+	cmd.top = std::max(cmd.top, 0);
+	if (cmd.left < cmd.right && cmd.top < cmd.bottom)
+		dl->draws.push_back(cmd);
+}
+
+/**
+ * @brief Adds a sticker warped onto a face, see sticker_warp_prepare().
+ */
+void draw_list_add_warp(drawlist* dl, int width, int height, const sticker* st,
+		const sticker* base, const stickerlayout* layout,
+		const dlib::full_object_detection& shape)
+{
+	drawcmd cmd;
+	cmd.nv12 = NULL;
+	if (!sticker_warp_prepare(width, height, st, base, layout, shape, &cmd.warp))
+		return;
+	cmd.left = cmd.warp.x0;
+	cmd.right = cmd.warp.x1;
+	cmd.top = cmd.warp.y0;
+	cmd.bottom = cmd.warp.y1;
+	dl->draws.push_back(cmd);
+}
+
+static void _draw_list_band(const drawlist* dl, unsigned char* y, unsigned char* uv,
+		int width, int height, int top, int bottom)
+{
+	for (size_t i = 0; i < dl->draws.size(); i++) {
+		const drawcmd& cmd = dl->draws[i];
+		if (cmd.bottom <= top || cmd.top >= bottom)
+			continue;
+		if (cmd.nv12 != NULL)
+			nv12_blend_sticker(y, uv, width, height, cmd.nv12, cmd.cx, cmd.cy, top, bottom);
+		else
+			sticker_warp_rows(y, uv, width, &cmd.warp, top, bottom);
+	}
+}
+
+/**
+ * @brief Paints every command of the list into an NV12 frame.
+ * @details Only the bands between the first and the last row touched are
+ *          visited.
+ *
+ * @param dl      The list
+ * @param y       The luma plane of the frame
+ * @param uv      The interleaved chroma plane of the frame
+ * @param width   The frame width, even
+ * @param height  The frame height, even
+ */
+void draw_list_paint(drawlist* dl, unsigned char* y, unsigned char* uv, int width, int height)
+{
+	if (dl->draws.empty())
+		return;
+
+	int top = height, bottom = 0;
+	for (size_t i = 0; i < dl->draws.size(); i++) {
+		top = std::min(top, dl->draws[i].top);
+		bottom = std::max(bottom, dl->draws[i].bottom);
+	}
+	const long bands = (bottom - top + DRAW_BAND_ROWS - 1) / DRAW_BAND_ROWS;
+
+	const auto band = [&](long b) {
+		const int band_top = top + b * DRAW_BAND_ROWS;
+		_draw_list_band(dl, y, uv, width, height, band_top,
+				std::min(band_top + DRAW_BAND_ROWS, bottom));
+	};
+	if (dl->pool != NULL && bands > 1)
+		dlib::parallel_for(*dl->pool, 0, bands, band);
+	else
+		for (long b = 0; b < bands; b++)
+			band(b);
+}
+
+/**
+ * @brief Marks the box of every command as a dirty sticker region.
+ */
+void draw_list_mark(const drawlist* dl, dirtylist* dirty)
+{
+	for (size_t i = 0; i < dl->draws.size(); i++) {
+		const drawcmd& cmd = dl->draws[i];
+		dirty_list_add(dirty, cmd.left, cmd.top, cmd.right, cmd.bottom, DIRTY_STICKER);
+	}
+}
@@ -0,0 +1,357 @@
+/*
+ * face_mask.cpp
+ *
+ *  Every row is sampled by FACE_MASK_SUBSAMPLES scanlines. Along a scanline
+ *  a span [xa, xb) covers pixel i by min(i + 1, xb) - max(i, xa), which is
+ *  written as four changes of coverage around xa and xb. A single running
+ *  sum over the row then gives the coverage of every pixel, so the cost is
+ *  one pass over the mask plus a few operations per edge and scanline.
+ */
+
+#include "face_mask.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+#define FACE_MASK_MAX_POINTS 68
+
+/* The jaw from ear to ear, then the eyebrows back from right to left. */
+static const int outline[] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+	26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+};
+
+typedef struct _maskpoint {
+	float x, y;
+} maskpoint;
+
+static bool _mask_point_less(const maskpoint& a, const maskpoint& b)
+{
+	return a.x < b.x || (a.x == b.x && a.y < b.y);
+}
+
+static float _mask_cross(const maskpoint& o, const maskpoint& a, const maskpoint& b)
+{
+	return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+/**
+ * @brief Replaces the points with their convex hull (monotone chain).
+ * @return The number of hull points
+ */
+static int _mask_hull(maskpoint* pts, int n)
+{
+	maskpoint hull[2 * FACE_MASK_MAX_POINTS];
+	int k = 0;
+
+	std::sort(pts, pts + n, _mask_point_less);
+	for (int i = 0; i < n; i++) {
+		while (k >= 2 && _mask_cross(hull[k - 2], hull[k - 1], pts[i]) <= 0)
+			k--;
+		hull[k++] = pts[i];
+	}
+	for (int i = n - 2, lower = k + 1; i >= 0; i--) {
+		while (k >= lower && _mask_cross(hull[k - 2], hull[k - 1], pts[i]) <= 0)
+			k--;
+		hull[k++] = pts[i];
+	}
+
+	/* the last point closes the hull on the first one */
+	std::copy(hull, hull + k - 1, pts);
+	return k - 1;
+}
+
+typedef struct _maskedge {
+	float y0, y1; /* the edge spans y0 <= y < y1 */
+	float x0; /* x at y0 */
+	float dxdy;
+} maskedge;
+
+static bool _mask_edge_less(const maskedge& a, const maskedge& b)
+{
+	return a.y0 < b.y0;
+}
+
+/* Changes of coverage over one row, and where the row is fully covered. */
+typedef struct _maskrow {
+	int* cover; /* in 1/256 of a pixel per scanline */
+	int lo, hi; /* the changes are all in [lo, hi) */
+	int in_lo, in_hi; /* every scanline covers [in_lo, in_hi) fully */
+	bool simple; /* every scanline crossed the outline in a single span */
+} maskrow;
+
+/**
+ * @brief Adds the coverage of [xa, xb) on one scanline.
+ */
+static inline void _mask_span(maskrow* row, float xa, float xb, int width)
+{
+	xa = std::max(xa, 0.0f);
+	xb = std::min(xb, (float) width);
+	if (xa >= xb) {
+		row->simple = false;
+		return;
+	}
+
+	const int a = (int) (xa * 256), b = (int) (xb * 256);
+	const int ia = a >> 8, ib = b >> 8;
+	row->cover[ia] += 256 - (a & 255);
+	row->cover[ia + 1] += a & 255;
+	row->cover[ib] -= 256 - (b & 255);
+	row->cover[ib + 1] -= b & 255;
+
+	row->lo = std::min(row->lo, ia);
+	row->hi = std::max(row->hi, ib + 2);
+	row->in_lo = std::max(row->in_lo, (a + 255) >> 8);
+	row->in_hi = std::min(row->in_hi, ib);
+}
+
+/**
+ * @brief Turns the changes of coverage of a row into the mask, clearing them.
+ * @details Only the pixels around the edges are summed up, the rest of the
+ *          row is filled.
+ */
+static void _mask_resolve(maskrow* row, unsigned char* out, int width)
+{
+	int* cover = row->cover;
+	const int lo = std::min(row->lo, width), hi = std::min(row->hi, width + 2);
+	const int full = 256 * FACE_MASK_SUBSAMPLES;
+	int sum = 0;
+
+	if (lo >= hi) {
+		std::fill(out, out + width, 0);
+		return;
+	}
+	std::fill(out, out + lo, 0);
+
+	int c = lo;
+	if (row->simple && row->in_lo < row->in_hi) {
+		for (; c < row->in_lo; c++) {
+			sum += cover[c];
+			cover[c] = 0;
+			out[c] = std::min(255, sum / FACE_MASK_SUBSAMPLES);
+		}
+		/* a span may start right on the first fully covered pixel */
+		cover[c] = 0;
+		std::fill(out + c, out + row->in_hi, 255);
+		c = row->in_hi;
+		sum = full;
+	}
+	for (; c < hi; c++) {
+		sum += cover[c];
+		cover[c] = 0;
+		if (c < width)
+			out[c] = std::min(255, sum / FACE_MASK_SUBSAMPLES);
+	}
+	if (hi < width)
+		std::fill(out + hi, out + width, 0);
+}
+
+/**
+ * @brief Rasterizes a face into a coverage mask.
+ * @details The mask only spans the bounding box of the face. Its buffers
+ *          keep their storage from one frame to the next, so a mask that is
+ *          built every frame stops allocating once it has seen its largest
+ *          face.
+ *
+ * @param fm            Receives the mask
+ * @param shape         The 68 landmarks of the face, on the rotated gray image
+ * @param kind          FACE_MASK_OUTLINE or FACE_MASK_HULL
+ * @param frame_width   The frame width, even
+ * @param frame_height  The frame height, even
+ *
+ * @return @c false if the shape has no 68 landmarks or the face is off the
+ *         frame, in which case the mask is empty
+ */
+bool face_mask_build(facemask* fm, const dlib::full_object_detection& shape, int kind,
+		int frame_width, int frame_height)
+{
+	fm->width = fm->height = 0;
+	if (shape.num_parts() != FACE_MASK_MAX_POINTS)
+		return false;
+
+	maskpoint pts[FACE_MASK_MAX_POINTS];
+	int n = 0;
+	if (kind == FACE_MASK_HULL) {
+		for (int i = 0; i < FACE_MASK_MAX_POINTS; i++) {
+			const dlib::point& p = shape.part(i);
+			/* the gray image is the frame turned by 90 degrees, pixel centers at +0.5 */
+			pts[n].x = p.y() + 0.5f;
+			pts[n++].y = frame_height - 1 - p.x() + 0.5f;
+		}
+		n = _mask_hull(pts, n);
+	} else {
+		for (size_t i = 0; i < sizeof(outline) / sizeof(outline[0]); i++) {
+			const dlib::point& p = shape.part(outline[i]);
+			pts[n].x = p.y() + 0.5f;
+			pts[n++].y = frame_height - 1 - p.x() + 0.5f;
+		}
+	}
+
+	float l = pts[0].x, t = pts[0].y, r = pts[0].x, b = pts[0].y;
+	for (int i = 1; i < n; i++) {
+		l = std::min(l, pts[i].x);
+		t = std::min(t, pts[i].y);
+		r = std::max(r, pts[i].x);
+		b = std::max(b, pts[i].y);
+	}
+	int x0 = std::max(0, (int) std::floor(l)), y0 = std::max(0, (int) std::floor(t));
+	int x1 = std::min(frame_width, (int) std::ceil(r)), y1 = std::min(frame_height, (int) std::ceil(b));
+	x0 -= x0 & 1;
+	y0 -= y0 & 1;
+	x1 += x1 & 1;
+	y1 += y1 & 1;
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+	fm->left = x0;
+	fm->top = y0;
+	fm->width = x1 - x0;
+	fm->height = y1 - y0;
+	fm->y.resize(fm->width * fm->height);
+	fm->uv.resize(fm->width * fm->height / 4);
+	fm->cover.assign(fm->width + 2, 0);
+
+	/* the edges by the row they start on, so only the ones crossing a scanline are visited */
+	maskedge edges[FACE_MASK_MAX_POINTS];
+	int num_edges = 0;
+	for (int i = 0, j = n - 1; i < n; j = i++) {
+		const maskpoint& p = pts[j].y < pts[i].y ? pts[j] : pts[i];
+		const maskpoint& q = pts[j].y < pts[i].y ? pts[i] : pts[j];
+		if (p.y == q.y)
+			continue;
+		edges[num_edges].y0 = p.y;
+		edges[num_edges].y1 = q.y;
+		edges[num_edges].x0 = p.x - x0;
+		edges[num_edges++].dxdy = (q.x - p.x) / (q.y - p.y);
+	}
+	std::sort(edges, edges + num_edges, _mask_edge_less);
+
+	const maskedge* active[FACE_MASK_MAX_POINTS];
+	int num_active = 0, next = 0;
+	maskrow mr;
+	mr.cover = &fm->cover[0];
+
+	for (int row = 0; row < fm->height; row++) {
+		mr.lo = fm->width;
+		mr.hi = 0;
+		mr.in_lo = 0;
+		mr.in_hi = fm->width;
+		mr.simple = true;
+
+		for (int s = 0; s < FACE_MASK_SUBSAMPLES; s++) {
+			const float sy = y0 + row + (s + 0.5f) / FACE_MASK_SUBSAMPLES;
+			while (next < num_edges && edges[next].y0 <= sy)
+				active[num_active++] = &edges[next++];
+
+			float xs[FACE_MASK_MAX_POINTS];
+			int m = 0;
+			for (int k = 0; k < num_active; k++) {
+				const maskedge* e = active[k];
+				if (e->y1 <= sy) {
+					active[k--] = active[--num_active];
+					continue;
+				}
+				xs[m++] = e->x0 + (sy - e->y0) * e->dxdy;
+			}
+
+			std::sort(xs, xs + m);
+			if (m != 2)
+				mr.simple = false;
+			for (int k = 0; k + 1 < m; k += 2)
+				_mask_span(&mr, xs[k], xs[k + 1], fm->width);
+		}
+
+		_mask_resolve(&mr, &fm->y[row * fm->width], fm->width);
+	}
+
+	/* a chroma sample covers a 2x2 block of luma pixels, four of them are averaged at a time */
+	const uint64_t lanes = 0x00ff00ff00ff00ffULL;
+	for (int row = 0; row < fm->height / 2; row++) {
+		const unsigned char* r0 = &fm->y[2 * row * fm->width];
+		const unsigned char* r1 = r0 + fm->width;
+		unsigned char* out = &fm->uv[row * (fm->width / 2)];
+		int c = 0;
+		for (; 2 * c + 8 <= fm->width; c += 4) {
+			uint64_t a, b;
+			memcpy(&a, r0 + 2 * c, sizeof(a));
+			memcpy(&b, r1 + 2 * c, sizeof(b));
+			uint64_t sum = (a & lanes) + ((a >> 8) & lanes) + (b & lanes) + ((b >> 8) & lanes)
+					+ 0x0002000200020002ULL;
+			sum = (sum >> 2) & lanes;
+			sum |= sum >> 8;
+			const uint32_t packed = (uint32_t) (sum & 0xffff) | (uint32_t) ((sum >> 16) & 0xffff0000);
+			memcpy(out + c, &packed, sizeof(packed));
+		}
+		for (; c < fm->width / 2; c++)
+			out[c] = (r0[2 * c] + r0[2 * c + 1] + r1[2 * c] + r1[2 * c + 1] + 2) >> 2;
+	}
+	return true;
+}
+
+/**
+ * @brief Combines the masks of several faces over a region of the frame.
+ * @details A pixel that faces overlap is as covered as the face covering it
+ *          most. The mask is cut down to the part of the region the faces
+ *          reach, so a stage working on it does not pay for the rest.
+ *
+ * @param fm      Receives the combined mask
+ * @param masks   The masks of the faces, built by face_mask_build()
+ * @param count   The number of masks
+ * @param left    The first column of the region, even
+ * @param top     The first row of the region, even
+ * @param right   One past the last column of the region, even
+ * @param bottom  One past the last row of the region, even
+ *
+ * @return @c false if no face reaches into the region, in which case the
+ *         mask is empty
+ */
+bool face_mask_union(facemask* fm, const facemask* masks, int count, int left, int top,
+		int right, int bottom)
+{
+	int x0 = right, y0 = bottom, x1 = left, y1 = top;
+	for (int i = 0; i < count; i++) {
+		const facemask& m = masks[i];
+		const int l = std::max(m.left, left), r = std::min(m.left + m.width, right);
+		const int t = std::max(m.top, top), b = std::min(m.top + m.height, bottom);
+		if (l >= r || t >= b)
+			continue;
+		x0 = std::min(x0, l);
+		y0 = std::min(y0, t);
+		x1 = std::max(x1, r);
+		y1 = std::max(y1, b);
+	}
+	fm->width = fm->height = 0;
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+	fm->left = x0;
+	fm->top = y0;
+	fm->width = x1 - x0;
+	fm->height = y1 - y0;
+	fm->y.assign(fm->width * fm->height, 0);
+	fm->uv.assign(fm->width * fm->height / 4, 0);
+
+	for (int i = 0; i < count; i++) {
+		const facemask& m = masks[i];
+		const int l = std::max(m.left, x0), r = std::min(m.left + m.width, x1);
+		const int t = std::max(m.top, y0), b = std::min(m.top + m.height, y1);
+		if (l >= r || t >= b)
+			continue;
+		for (int row = t; row < b; row++) {
+			const unsigned char* src = &m.y[(row - m.top) * m.width + l - m.left];
+			unsigned char* dst = &fm->y[(row - y0) * fm->width + l - x0];
+			for (int k = 0; k < r - l; k++)
+				dst[k] = std::max(dst[k], src[k]);
+		}
+		/* every corner is even, so the chroma samples line up */
+		for (int row = t / 2; row < b / 2; row++) {
+			const unsigned char* src = &m.uv[(row - m.top / 2) * (m.width / 2) + (l - m.left) / 2];
+			unsigned char* dst = &fm->uv[(row - y0 / 2) * (fm->width / 2) + (l - x0) / 2];
+			for (int k = 0; k < (r - l) / 2; k++)
+				dst[k] = std::max(dst[k], src[k]);
+		}
+	}
+	return true;
+}
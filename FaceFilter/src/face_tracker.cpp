@@ -0,0 +1,180 @@
+/*
+ * face_tracker.cpp
+ *
+ *  The camera face detector reports faces only every few frames and its
+ *  boxes jitter, so every face gets its own correlation tracker that is
+ *  advanced on each preview frame.  Detections are only used to spawn new
+ *  tracks or to re-acquire tracks that drifted away from their face.
+ */
+
+#include "face_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <dlib/optimization/max_cost_assignment.h>
+
+/* max_cost_assignment() wants integers, scores are scaled by this */
+#define TRACK_COST_SCALE 1000
+
+static double _face_tracker_iou(const dlib::rectangle& a, const dlib::rectangle& b)
+{
+	double inter = a.intersect(b).area();
+	double uni = a.area() + b.area() - inter;
+	return uni > 0 ? inter / uni : 0;
+}
+
+static bool _face_tracker_lost(const facetrack& t)
+{
+	return t.psr < 0;
+}
+
+/**
+ * @brief Scores how likely a detection and a track are the same face.
+ * @details Overlap alone fails when a face moves faster than its tracker,
+ *          so the distance between the centers counts as much as the IoU.
+ *
+ * @return A score in [0, 2 * TRACK_COST_SCALE], or 0 if they can not match
+ */
+static long _face_tracker_score(const dlib::rectangle& det, const dlib::rectangle& box)
+{
+	const double iou = _face_tracker_iou(det, box);
+	const double dist = std::sqrt((double) (dlib::center(det) - dlib::center(box)).length_squared());
+	const double near = 1 - dist / (TRACK_MATCH_DIST * det.width());
+
+	if (iou < TRACK_MATCH_IOU && near <= 0)
+		return 0;
+	return (long) (TRACK_COST_SCALE * (iou + std::max(near, 0.0))) + 1;
+}
+
+void face_tracker_init(trackdata* td, unsigned long num_threads)
+{
+	td->tracks.clear();
+	td->tracks.reserve(MAX_TRACKS);
+	td->detections.clear();
+	td->has_detections = false;
+	td->min_psr = TRACK_MIN_PSR;
+	td->next_id = 0;
+
+	if (td->pool == NULL)
+		td->pool = new dlib::thread_pool(num_threads);
+}
+
+void face_tracker_release(trackdata* td)
+{
+	delete td->pool;
+	td->pool = NULL;
+	td->tracks.clear();
+}
+
+/**
+ * @brief Hands the latest camera detections to the tracker.
+ * @details Called from the face detection callback, which runs on a
+ *          different thread than the preview callback. The detections are
+ *          merged on the next face_tracker_update().
+ */
+void face_tracker_set_detections(trackdata* td, const std::vector<dlib::rectangle>& faces)
+{
+	dlib::auto_mutex lock(td->detections_lock);
+	td->detections = faces;
+	td->has_detections = true;
+}
+
+/**
+ * @brief Advances all tracks to the given frame.
+ *
+ * @param td     The tracker state
+ * @param img    The rotated luma plane of the preview frame
+ * @param faces  Receives the box of every live track
+ * @param ids    Receives the id of every live track, in the same order
+ */
+void face_tracker_update(trackdata* td, const dlib::array2d<unsigned char>& img,
+		std::vector<dlib::rectangle>& faces, std::vector<unsigned long>& ids)
+{
+	std::vector<facetrack>& tracks = td->tracks;
+	const double min_psr = td->min_psr;
+
+	/* 1. follow every live track into the new frame */
+	dlib::parallel_for(*td->pool, 0, tracks.size(), [&](long i) {
+		facetrack& t = tracks[i];
+		t.psr = t.tracker.update(img);
+		t.box = t.tracker.get_position();
+		/* a track pushed off the image gets a NaN score, drop it too */
+		if (!(t.psr >= min_psr))
+			t.psr = -1;
+	}, 1);
+
+	/* two tracks that slid onto the same face: keep the confident one */
+	for (size_t i = 0; i < tracks.size(); i++) {
+		for (size_t j = i + 1; j < tracks.size(); j++) {
+			if (_face_tracker_lost(tracks[i]) || _face_tracker_lost(tracks[j]))
+				continue;
+			if (_face_tracker_iou(tracks[i].box, tracks[j].box) > 0.5) {
+				if (tracks[i].psr < tracks[j].psr)
+					tracks[i].psr = -1;
+				else
+					tracks[j].psr = -1;
+			}
+		}
+	}
+
+	tracks.erase(std::remove_if(tracks.begin(), tracks.end(), _face_tracker_lost),
+			tracks.end());
+
+	/* 2. merge the detections reported since the last frame */
+	std::vector<dlib::rectangle> detections;
+	{
+		dlib::auto_mutex lock(td->detections_lock);
+		if (td->has_detections) {
+			detections.swap(td->detections);
+			td->has_detections = false;
+		}
+	}
+
+	/* give every detection to at most one track, maximizing the total score */
+	const long n = std::max(detections.size(), tracks.size());
+	std::vector<long> assignment;
+	if (!detections.empty()) {
+		td->cost.set_size(n, n);
+		td->cost = 0;
+		for (size_t d = 0; d < detections.size(); d++) {
+			for (size_t i = 0; i < tracks.size(); i++)
+				td->cost(d, i) = _face_tracker_score(detections[d], tracks[i].box);
+		}
+		assignment = dlib::max_cost_assignment(td->cost);
+	}
+
+	const size_t num_tracks = tracks.size();
+	std::vector<size_t> restart;
+	for (size_t d = 0; d < detections.size(); d++) {
+		size_t idx = assignment[d];
+
+		if (idx >= num_tracks || td->cost(d, idx) == 0) {
+			/* a new face */
+			if (tracks.size() >= MAX_TRACKS)
+				continue;
+			tracks.push_back(facetrack());
+			tracks.back().id = td->next_id++;
+			idx = tracks.size() - 1;
+		} else if (_face_tracker_iou(detections[d], tracks[idx].box) >= TRACK_REACQUIRE_IOU) {
+			/* the track is still on its face */
+			continue;
+		}
+
+		tracks[idx].box = detections[d];
+		restart.push_back(idx);
+	}
+
+	/* starting a track is as costly as an update, so run them in parallel too */
+	dlib::parallel_for(*td->pool, 0, restart.size(), [&](long i) {
+		facetrack& t = tracks[restart[i]];
+		t.tracker.start_track(img, t.box);
+		t.psr = min_psr;
+	}, 1);
+
+	faces.clear();
+	ids.clear();
+	for (size_t i = 0; i < tracks.size(); i++) {
+		faces.push_back(tracks[i].box);
+		ids.push_back(tracks[i].id);
+	}
+}
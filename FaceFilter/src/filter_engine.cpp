@@ -0,0 +1,620 @@
+/*
+ * filter_engine.cpp
+ *
+ *  Rows are pushed through the chain from the top of the plane down. A
+ *  point stage filters the row it is given in place. A stage with a radius
+ *  copies the row into its ring, and once the rows below are in as well it
+ *  filters the row radius rows up into its output row and pushes that on.
+ *  The last stage writes the row back into the plane. A row of the plane is
+ *  only written once every ring that needs it holds a copy, so the sweep
+ *  works in place.
+ */
+
+#include "filter_engine.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <dlib/simd.h>
+
+/**
+ * @brief Prepares an empty chain.
+ *
+ * @param fc    The chain
+ * @param step  1 for a luma plane, 2 for an interleaved chroma plane
+ */
+void filter_chain_init(filterchain* fc, int step)
+{
+	fc->count = 0;
+	fc->step = step;
+}
+
+static filterstage* _filter_chain_add(filterchain* fc, filter_row_fn run, int radius)
+{
+	if (fc->count >= MAX_FILTER_STAGES || radius > FILTER_MAX_RADIUS)
+		return NULL;
+
+	filterstage* st = &fc->stages[fc->count++];
+	st->run = run;
+	st->radius = radius;
+	return st;
+}
+
+/* a point operation, on byte value v of channel c: 0 for luma and Cb, 1 for Cr */
+typedef int (*filter_point_fn)(int v, int c, int u_new, int v_new);
+
+static int _point_invert(int v, int c, int u_new, int v_new)
+{
+	return 255 - v;
+}
+
+/* u_new and v_new replace Cb and Cr, negative keeps them */
+static int _point_chroma(int v, int c, int u_new, int v_new)
+{
+	const int n = c == 0 ? u_new : v_new;
+	return n < 0 ? v : n;
+}
+
+/* lifts the shadows by a fifth */
+static int _point_pinky_luma(int v, int c, int u_new, int v_new)
+{
+	return v < 128 ? v * 6 / 5 : v;
+}
+
+/* scales even chroma values up by a fifth, a tint towards magenta */
+static int _point_pinky_chroma(int v, int c, int u_new, int v_new)
+{
+	return v & 1 ? v : std::min(v * 6 / 5, 255);
+}
+
+/*
+ * Looks every byte up in the table of its parity. On AArch64 the even and
+ * odd bytes are split with vld2 and looked up 64 table bytes at a time with
+ * tbl, four lookups for 16 bytes. Elsewhere a plain table lookup is used:
+ * pshufb only holds 16 bytes of table, and the 16 lookups a 256 byte table
+ * takes are slower than the scalar loop, on SSSE3 and AVX2 alike, and so
+ * are the eight 32 byte vtbx lookups of ARMv7.
+ */
+static void _filter_lut(const filterstage* stage, const unsigned char* const* rows,
+		unsigned char* out, int width, int step, short* temp)
+{
+	const unsigned char* in = rows[0];
+	const unsigned char* lut0 = stage->lut[0];
+	const unsigned char* lut1 = stage->lut[1];
+	int x = 0;
+
+#if defined(DLIB_HAVE_NEON) && defined(__aarch64__)
+	uint8x16x4_t t[2][4];
+	for (int c = 0; c < 2; c++)
+		for (int k = 0; k < 4; k++)
+			for (int j = 0; j < 4; j++)
+				t[c][k].val[j] = vld1q_u8(stage->lut[c] + 64 * k + 16 * j);
+	for (; x + 32 <= width; x += 32) {
+		uint8x16x2_t v = vld2q_u8(in + x);
+		for (int c = 0; c < 2; c++) {
+			/* out of range indices leave the lane alone */
+			const uint8x16_t i = v.val[c];
+			uint8x16_t r = vqtbl4q_u8(t[c][0], i);
+			r = vqtbx4q_u8(r, t[c][1], vsubq_u8(i, vdupq_n_u8(64)));
+			r = vqtbx4q_u8(r, t[c][2], vsubq_u8(i, vdupq_n_u8(128)));
+			v.val[c] = vqtbx4q_u8(r, t[c][3], vsubq_u8(i, vdupq_n_u8(192)));
+		}
+		vst2q_u8(out + x, v);
+	}
+#endif
+
+	for (; x + 1 < width; x += 2) {
+		out[x] = lut0[in[x]];
+		out[x + 1] = lut1[in[x + 1]];
+	}
+	if (x < width)
+		out[x] = lut0[in[x]];
+}
+
+static void _filter_conv(const filterstage* stage, const unsigned char* const* rows,
+		unsigned char* out, int width, int step, short* temp)
+{
+	conv_row(&stage->conv, rows, out, width, step, temp);
+}
+
+/*
+ * |gx| + |gy| of the Sobel kernels, as dlib's sobel_edge_detector() has
+ * them, over the 3x3 neighbourhood a0 b0 c0 / a1 . c1 / a2 b2 c2. The
+ * magnitude is at most 2040, so 16 bits hold every sum.
+ */
+#if defined(DLIB_HAVE_NEON)
+static inline int16x8_t _filter_sobel(int16x8_t a0, int16x8_t b0, int16x8_t c0, int16x8_t a1,
+		int16x8_t c1, int16x8_t a2, int16x8_t b2, int16x8_t c2)
+{
+	const int16x8_t gx = vaddq_s16(vaddq_s16(vsubq_s16(c0, a0), vsubq_s16(c2, a2)),
+			vshlq_n_s16(vsubq_s16(c1, a1), 1));
+	const int16x8_t gy = vsubq_s16(vaddq_s16(vaddq_s16(a2, c2), vshlq_n_s16(b2, 1)),
+			vaddq_s16(vaddq_s16(a0, c0), vshlq_n_s16(b0, 1)));
+	return vaddq_s16(vabsq_s16(gx), vabsq_s16(gy));
+}
+
+static inline int16x8_t _filter_widen(uint8x8_t v)
+{
+	return vreinterpretq_s16_u16(vmovl_u8(v));
+}
+#elif defined(DLIB_HAVE_SSE2)
+static inline __m128i _filter_abs16(__m128i v)
+{
+	return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+static inline __m128i _filter_sobel(__m128i a0, __m128i b0, __m128i c0, __m128i a1,
+		__m128i c1, __m128i a2, __m128i b2, __m128i c2)
+{
+	const __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(c0, a0), _mm_sub_epi16(c2, a2)),
+			_mm_slli_epi16(_mm_sub_epi16(c1, a1), 1));
+	const __m128i gy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(a2, c2), _mm_slli_epi16(b2, 1)),
+			_mm_add_epi16(_mm_add_epi16(a0, c0), _mm_slli_epi16(b0, 1)));
+	return _mm_add_epi16(_filter_abs16(gx), _filter_abs16(gy));
+}
+#endif
+
+/*
+ * Posterizes the row with the table of the stage, then inks every pixel
+ * whose Sobel magnitude passes the threshold, 16 pixels at a time. The
+ * row is still in the cache for the second loop, so the effect is one
+ * sweep over the plane. A luma chain only.
+ */
+static void _filter_cartoon(const filterstage* stage, const unsigned char* const* rows,
+		unsigned char* out, int width, int step, short* temp)
+{
+	const unsigned char* r0 = rows[0];
+	const unsigned char* r1 = rows[1];
+	const unsigned char* r2 = rows[2];
+	_filter_lut(stage, &rows[1], out, width, step, temp);
+	int x = 0;
+
+#if defined(DLIB_HAVE_NEON)
+	const int16x8_t threshold = vdupq_n_s16((short) stage->threshold);
+	const uint8x16_t ink = vdupq_n_u8(FILTER_INK);
+	for (; x + 16 <= width; x += 16) {
+		uint8x16_t v[8];
+		v[0] = vld1q_u8(r0 + x - 1);
+		v[1] = vld1q_u8(r0 + x);
+		v[2] = vld1q_u8(r0 + x + 1);
+		v[3] = vld1q_u8(r1 + x - 1);
+		v[4] = vld1q_u8(r1 + x + 1);
+		v[5] = vld1q_u8(r2 + x - 1);
+		v[6] = vld1q_u8(r2 + x);
+		v[7] = vld1q_u8(r2 + x + 1);
+		int16x8_t lo[8], hi[8];
+		for (int k = 0; k < 8; k++) {
+			lo[k] = _filter_widen(vget_low_u8(v[k]));
+			hi[k] = _filter_widen(vget_high_u8(v[k]));
+		}
+		const uint16x8_t edge_lo = vcgtq_s16(_filter_sobel(lo[0], lo[1], lo[2], lo[3], lo[4], lo[5], lo[6], lo[7]),
+				threshold);
+		const uint16x8_t edge_hi = vcgtq_s16(_filter_sobel(hi[0], hi[1], hi[2], hi[3], hi[4], hi[5], hi[6], hi[7]),
+				threshold);
+		const uint8x16_t edge = vcombine_u8(vmovn_u16(edge_lo), vmovn_u16(edge_hi));
+		vst1q_u8(out + x, vbslq_u8(edge, ink, vld1q_u8(out + x)));
+	}
+#elif defined(DLIB_HAVE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i threshold = _mm_set1_epi16((short) stage->threshold);
+	const __m128i ink = _mm_set1_epi8((char) FILTER_INK);
+	for (; x + 16 <= width; x += 16) {
+		__m128i v[8];
+		v[0] = _mm_loadu_si128((const __m128i*) (r0 + x - 1));
+		v[1] = _mm_loadu_si128((const __m128i*) (r0 + x));
+		v[2] = _mm_loadu_si128((const __m128i*) (r0 + x + 1));
+		v[3] = _mm_loadu_si128((const __m128i*) (r1 + x - 1));
+		v[4] = _mm_loadu_si128((const __m128i*) (r1 + x + 1));
+		v[5] = _mm_loadu_si128((const __m128i*) (r2 + x - 1));
+		v[6] = _mm_loadu_si128((const __m128i*) (r2 + x));
+		v[7] = _mm_loadu_si128((const __m128i*) (r2 + x + 1));
+		__m128i lo[8], hi[8];
+		for (int k = 0; k < 8; k++) {
+			lo[k] = _mm_unpacklo_epi8(v[k], zero);
+			hi[k] = _mm_unpackhi_epi8(v[k], zero);
+		}
+		const __m128i edge_lo = _mm_cmpgt_epi16(_filter_sobel(lo[0], lo[1], lo[2], lo[3], lo[4], lo[5], lo[6], lo[7]),
+				threshold);
+		const __m128i edge_hi = _mm_cmpgt_epi16(_filter_sobel(hi[0], hi[1], hi[2], hi[3], hi[4], hi[5], hi[6], hi[7]),
+				threshold);
+		const __m128i edge = _mm_packs_epi16(edge_lo, edge_hi);
+		const __m128i tone = _mm_loadu_si128((const __m128i*) (out + x));
+		_mm_storeu_si128((__m128i*) (out + x),
+				_mm_or_si128(_mm_and_si128(edge, ink), _mm_andnot_si128(edge, tone)));
+	}
+#endif
+
+	for (; x < width; x++) {
+		const int gx = r0[x + 1] - r0[x - 1] + 2 * (r1[x + 1] - r1[x - 1]) + r2[x + 1] - r2[x - 1];
+		const int gy = r2[x - 1] + 2 * r2[x] + r2[x + 1] - r0[x - 1] - 2 * r0[x] - r0[x + 1];
+		if (abs(gx) + abs(gy) > stage->threshold)
+			out[x] = FILTER_INK;
+	}
+}
+
+/* puts the smaller of a and b in a, the larger in b */
+static inline void _filter_sort(int& a, int& b)
+{
+	const int t = std::min(a, b);
+	b = std::max(a, b);
+	a = t;
+}
+
+#if defined(DLIB_HAVE_NEON)
+static inline void _filter_sort(uint8x16_t& a, uint8x16_t& b)
+{
+	const uint8x16_t t = vminq_u8(a, b);
+	b = vmaxq_u8(a, b);
+	a = t;
+}
+#elif defined(DLIB_HAVE_SSE2)
+static inline void _filter_sort(__m128i& a, __m128i& b)
+{
+	const __m128i t = _mm_min_epu8(a, b);
+	b = _mm_max_epu8(a, b);
+	a = t;
+}
+#endif
+
+/* the median of nine, with the 19 exchanges of Paeth's network */
+template <typename T>
+static inline T _filter_median9(T* p)
+{
+	_filter_sort(p[1], p[2]); _filter_sort(p[4], p[5]); _filter_sort(p[7], p[8]);
+	_filter_sort(p[0], p[1]); _filter_sort(p[3], p[4]); _filter_sort(p[6], p[7]);
+	_filter_sort(p[1], p[2]); _filter_sort(p[4], p[5]); _filter_sort(p[7], p[8]);
+	_filter_sort(p[0], p[3]); _filter_sort(p[5], p[8]); _filter_sort(p[4], p[7]);
+	_filter_sort(p[3], p[6]); _filter_sort(p[1], p[4]); _filter_sort(p[2], p[5]);
+	_filter_sort(p[4], p[7]); _filter_sort(p[4], p[2]); _filter_sort(p[6], p[4]);
+	_filter_sort(p[4], p[2]);
+	return p[4];
+}
+
+/*
+ * The 3x3 median of every byte, its neighbours step bytes away, so an
+ * interleaved chroma plane keeps Cb and Cr apart. The network is only
+ * byte minimums and maximums, 16 bytes to an instruction.
+ */
+static void _filter_median(const filterstage* stage, const unsigned char* const* rows,
+		unsigned char* out, int width, int step, short* temp)
+{
+	int x = 0;
+
+#if defined(DLIB_HAVE_NEON)
+	for (; x + 16 <= width; x += 16) {
+		uint8x16_t p[9];
+		for (int j = 0; j < 3; j++) {
+			p[3 * j] = vld1q_u8(rows[j] + x - step);
+			p[3 * j + 1] = vld1q_u8(rows[j] + x);
+			p[3 * j + 2] = vld1q_u8(rows[j] + x + step);
+		}
+		vst1q_u8(out + x, _filter_median9(p));
+	}
+#elif defined(DLIB_HAVE_SSE2)
+	for (; x + 16 <= width; x += 16) {
+		__m128i p[9];
+		for (int j = 0; j < 3; j++) {
+			p[3 * j] = _mm_loadu_si128((const __m128i*) (rows[j] + x - step));
+			p[3 * j + 1] = _mm_loadu_si128((const __m128i*) (rows[j] + x));
+			p[3 * j + 2] = _mm_loadu_si128((const __m128i*) (rows[j] + x + step));
+		}
+		_mm_storeu_si128((__m128i*) (out + x), _filter_median9(p));
+	}
+#endif
+
+	for (; x < width; x++) {
+		int p[9];
+		for (int j = 0; j < 3; j++) {
+			p[3 * j] = rows[j][x - step];
+			p[3 * j + 1] = rows[j][x];
+			p[3 * j + 2] = rows[j][x + step];
+		}
+		out[x] = (unsigned char) _filter_median9(p);
+	}
+}
+
+/**
+ * @brief Adds a point operation, composed into the table of the last stage when that
+ *        is a point stage too.
+ */
+static bool _filter_chain_add_point(filterchain* fc, filter_point_fn op, int u_new, int v_new)
+{
+	filterstage* st = fc->count > 0 ? &fc->stages[fc->count - 1] : NULL;
+	if (st == NULL || st->run != _filter_lut) {
+		st = _filter_chain_add(fc, _filter_lut, 0);
+		if (st == NULL)
+			return false;
+		for (int v = 0; v < 256; v++)
+			st->lut[0][v] = st->lut[1][v] = v;
+	}
+
+	/* in a luma chain every byte is luma, and both tables stay the same */
+	for (int c = 0; c < 2; c++)
+		for (int v = 0; v < 256; v++)
+			st->lut[c][v] = op(st->lut[c][v], fc->step == 2 ? c : 0, u_new, v_new);
+	return true;
+}
+
+bool filter_chain_add_invert(filterchain* fc)
+{
+	return _filter_chain_add_point(fc, _point_invert, 0, 0);
+}
+
+/**
+ * @brief Adds a stage that replaces the chroma of a chroma chain.
+ *
+ * @param fc  The chain, with a step of 2
+ * @param u   The new U, or -1 to keep it
+ * @param v   The new V, or -1 to keep it
+ */
+bool filter_chain_add_chroma(filterchain* fc, int u, int v)
+{
+	if (fc->step != 2)
+		return false;
+	return _filter_chain_add_point(fc, _point_chroma, u, v);
+}
+
+bool filter_chain_add_pinky(filterchain* fc)
+{
+	return _filter_chain_add_point(fc, fc->step == 1 ? _point_pinky_luma : _point_pinky_chroma,
+			0, 0);
+}
+
+/**
+ * @brief Adds a convolution, see conv_kernel_init().
+ */
+bool filter_chain_add_kernel(filterchain* fc, const int* k, int size, int shift)
+{
+	convkernel ck;
+	if (!conv_kernel_init(&ck, k, size, shift))
+		return false;
+	filterstage* st = _filter_chain_add(fc, _filter_conv, ck.radius);
+	if (st == NULL)
+		return false;
+	st->conv = ck;
+	return true;
+}
+
+/**
+ * @brief Adds a separable convolution, see conv_kernel_init_separable().
+ */
+bool filter_chain_add_separable(filterchain* fc, const int* col, const int* row, int size, int shift)
+{
+	convkernel ck;
+	if (!conv_kernel_init_separable(&ck, col, row, size, shift))
+		return false;
+	filterstage* st = _filter_chain_add(fc, _filter_conv, ck.radius);
+	if (st == NULL)
+		return false;
+	st->conv = ck;
+	return true;
+}
+/**
+ * @brief Adds a cartoon stage: posterized luma under ink lines on the edges.
+ *
+ * @param fc         The chain, with a step of 1
+ * @param levels     The number of flat tones, from 2 to 256
+ * @param threshold  The Sobel magnitude, |gx| + |gy| from 0 to 2040, above
+ *                   which a pixel is inked
+ */
+bool filter_chain_add_cartoon(filterchain* fc, int levels, int threshold)
+{
+	if (fc->step != 1 || levels < 2 || levels > 256 || threshold < 0 || threshold > 2040)
+		return false;
+	filterstage* st = _filter_chain_add(fc, _filter_cartoon, 1);
+	if (st == NULL)
+		return false;
+
+	/* every tone is the middle of the band of values it replaces */
+	for (int v = 0; v < 256; v++)
+		st->lut[0][v] = st->lut[1][v] = (unsigned char) ((2 * (v * levels >> 8) + 1) * 128 / levels);
+	st->threshold = threshold;
+	return true;
+}
+
+/**
+ * @brief Adds a 3x3 median, which flattens small detail and keeps edges.
+ */
+bool filter_chain_add_median(filterchain* fc)
+{
+	return _filter_chain_add(fc, _filter_median, 1) != NULL;
+}
+
+/* padded row length, even so the temp row of shorts stays aligned */
+static int _filter_stride(int width)
+{
+	return (width + 2 * CONV_PAD + 1) & ~1;
+}
+
+/* ring rows, the output row and a temp row of shorts */
+static size_t _filter_stage_bytes(int radius, int width)
+{
+	return radius == 0 ? 0 : (size_t) (2 * radius + 4) * _filter_stride(width);
+}
+
+/**
+ * @brief Sets up the engine.
+ * @details The row scratch grows to what the largest chain needs the first
+ *          time that chain runs, and is reused from then on.
+ *
+ * @param fe           The engine
+ * @param num_threads  The number of threads filtering the strips, 1 or less to
+ *                     filter them on the calling thread
+ */
+void filter_engine_init(filterengine* fe, unsigned long num_threads)
+{
+	if (fe->pool == NULL && num_threads > 1)
+		fe->pool = new dlib::thread_pool(num_threads);
+}
+
+void filter_engine_release(filterengine* fe)
+{
+	delete fe->pool;
+	fe->pool = NULL;
+	std::vector<unsigned char>().swap(fe->rows);
+}
+
+typedef struct _filtersweep {
+	const filterchain* fc;
+	unsigned char* plane;
+	int width;
+	int height;
+	int stride; /* bytes between the rows of the plane */
+	int top, bottom; /* rows written, the strip */
+	int lo[MAX_FILTER_STAGES + 1], hi[MAX_FILTER_STAGES + 1]; /* rows every stage gets */
+	unsigned char* rings[MAX_FILTER_STAGES]; /* 2 * radius + 1 rows, the output row, the temp row */
+	unsigned char* halo; /* copies of the rows lo[0]..top and bottom..hi[0] */
+} filtersweep;
+
+/**
+ * @brief Pushes row index through the stages from s on.
+ */
+static void _filter_push(const filtersweep* fs, int s, unsigned char* row, int index)
+{
+	const int width = fs->width;
+	const int stride = _filter_stride(width);
+
+	for (; s < fs->fc->count; s++) {
+		const filterstage* st = &fs->fc->stages[s];
+		const int r = st->radius;
+		if (r == 0) {
+			st->run(st, &row, row, width, fs->fc->step, NULL);
+			continue;
+		}
+
+		/* the borders are taken care of here, once per row */
+		const int size = 2 * r + 1;
+		unsigned char* ring = fs->rings[s] + CONV_PAD;
+		memcpy(ring + (index % size) * stride, row, width);
+		conv_pad_row(ring + (index % size) * stride, width, fs->fc->step);
+
+		/*
+		 * The row r rows up has all its context now. The rows of the last
+		 * r at the bottom of the plane have theirs too, and so would rows
+		 * past the bottom of the strip, which the next stage does not need.
+		 */
+		const int last = index == fs->hi[s] - 1 ? fs->hi[s + 1] - 1 : index - r;
+		for (int o = std::max(index - r, fs->lo[s + 1]); o <= last; o++) {
+			const unsigned char* rows[2 * FILTER_MAX_RADIUS + 1];
+			for (int j = 0; j < size; j++) {
+				const int i = std::max(0, std::min(o - r + j, fs->height - 1));
+				rows[j] = ring + (i % size) * stride;
+			}
+			unsigned char* out = ring + size * stride;
+			short* temp = (short*) (fs->rings[s] + (size + 1) * stride);
+			st->run(st, rows, out, width, fs->fc->step, temp);
+			_filter_push(fs, s + 1, out, o);
+		}
+		return;
+	}
+
+	if (index < fs->top || index >= fs->bottom)
+		return;
+	unsigned char* dst = fs->plane + (size_t) index * fs->stride;
+	if (row != dst)
+		memcpy(dst, row, width);
+}
+
+/**
+ * @brief Filters the rows of one strip, reading the rows around it from its halo.
+ */
+static void _filter_strip(const filtersweep* fs)
+{
+	for (int i = fs->lo[0]; i < fs->hi[0]; i++) {
+		unsigned char* row;
+		if (i < fs->top)
+			row = fs->halo + (size_t) (i - fs->lo[0]) * fs->width;
+		else if (i >= fs->bottom)
+			row = fs->halo + (size_t) (fs->top - fs->lo[0] + i - fs->bottom) * fs->width;
+		else
+			row = fs->plane + (size_t) i * fs->stride;
+		_filter_push(fs, 0, row, i);
+	}
+}
+
+/**
+ * @brief Runs a chain over a plane, in place.
+ * @details The plane is cut into strips of rows, one or two per thread,
+ *          filtered in parallel. A strip is swept like the whole plane
+ *          would be, starting and ending as many rows out as the kernels of
+ *          the chain reach together. Those rows belong to the strips
+ *          around it, which may write them at any time, so they are copied
+ *          before any strip starts.
+ *
+ * @param fe      The engine, set up by filter_engine_init()
+ * @param fc      The chain. Nothing is done when it is empty.
+ * @param plane   The first row of the plane, or of a window of it
+ * @param width   The row length in bytes
+ * @param height  The number of rows
+ * @param stride  The bytes from one row to the next, at least width
+ */
+void filter_engine_run(filterengine* fe, const filterchain* fc, unsigned char* plane,
+		int width, int height, int stride)
+{
+	if (fc->count == 0 || width < fc->step || height <= 0)
+		return;
+
+	int reach = 0;
+	size_t ring_bytes = 0;
+	for (int s = 0; s < fc->count; s++) {
+		reach += fc->stages[s].radius;
+		ring_bytes += _filter_stage_bytes(fc->stages[s].radius, width);
+	}
+
+	int strips = 1;
+	if (fe->pool != NULL)
+		strips = std::max(1, std::min((int) fe->pool->num_threads_in_pool() * FILTER_STRIPS_PER_THREAD,
+				height / FILTER_MIN_STRIP_ROWS));
+	strips = std::min(strips, FILTER_MAX_STRIPS);
+
+	/* grows the first time a chain this large runs, and never again */
+	const size_t strip_bytes = ring_bytes + (size_t) 2 * reach * width;
+	if (fe->rows.size() < strips * strip_bytes)
+		fe->rows.resize(strips * strip_bytes);
+
+	filtersweep sweeps[FILTER_MAX_STRIPS];
+	for (int k = 0; k < strips; k++) {
+		filtersweep* fs = &sweeps[k];
+		fs->fc = fc;
+		fs->plane = plane;
+		fs->width = width;
+		fs->height = height;
+		fs->stride = stride;
+		fs->top = (int) ((long) height * k / strips);
+		fs->bottom = (int) ((long) height * (k + 1) / strips);
+
+		fs->lo[0] = std::max(fs->top - reach, 0);
+		fs->hi[0] = std::min(fs->bottom + reach, height);
+		for (int s = 0; s < fc->count; s++) {
+			/* a stage gives up radius rows at either end, except at the edges of the plane */
+			const int r = fc->stages[s].radius;
+			fs->lo[s + 1] = fs->lo[s] == 0 ? 0 : fs->lo[s] + r;
+			fs->hi[s + 1] = fs->hi[s] == height ? height : fs->hi[s] - r;
+		}
+
+		unsigned char* scratch = &fe->rows[0] + k * strip_bytes;
+		for (int s = 0; s < fc->count; s++) {
+			fs->rings[s] = NULL;
+			if (fc->stages[s].radius > 0) {
+				fs->rings[s] = scratch;
+				scratch += _filter_stage_bytes(fc->stages[s].radius, width);
+			}
+		}
+
+		/* before any strip writes a row */
+		fs->halo = scratch;
+		const int above = fs->top - fs->lo[0];
+		for (int i = fs->lo[0]; i < fs->top; i++)
+			memcpy(fs->halo + (size_t) (i - fs->lo[0]) * width, plane + (size_t) i * stride, width);
+		for (int i = fs->bottom; i < fs->hi[0]; i++)
+			memcpy(fs->halo + (size_t) (above + i - fs->bottom) * width, plane + (size_t) i * stride, width);
+	}
+
+	if (strips > 1)
+		dlib::parallel_for_blocked(*fe->pool, 0, strips, [&](long begin, long end) {
+			for (long k = begin; k < end; k++)
+				_filter_strip(&sweeps[k]);
+		}, 1);
+	else
+		_filter_strip(&sweeps[0]);
+}
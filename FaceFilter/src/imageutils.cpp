@@ -3,114 +3,38 @@
 #include <image_util.h>
 #include <storage.h>
 
-#define BUFLEN 256
-
-static char sample_file_path[BUFLEN];
-static const char *image_util_source_filename = "rot.jpg";
-
-void _image_util_imgcpy(camera_preview_data_s* frame, imageinfo* imginfo, int p, int q)
+/**
+ * @brief Decodes a sticker JPEG for the sticker atlas.
+ * @details JPEG has no alpha channel, so the white background is keyed out.
+ *          Safe to call from several threads at once.
+ */
+bool _image_util_decode_sticker(const char* path, dlib::array2d<dlib::rgb_alpha_pixel>& img)
 {
-	int sh = imginfo->height;
-	int sw = imginfo->width;
-	int sy_size = sh*sw;
-
-	int fh = frame->height;
-	int fw = frame->width;
-
-	p -= sw/2;
-	q -= sh/2;
-
-	int pt = p + q*fw;
-	int pti = 0;
-
-#ifdef ALPHA
-	// copy Y plane
-	for(int i=0;i<sw;i++)
-	{
-		if(pt > frame->data.double_plane.y_size || pti > sy_size)
-			break;
-		memcpy(frame->data.double_plane.y + pt, imginfo->data + pti, sizeof(unsigned char)*sh);
-		pt += fw;
-		pti += sh;
-	}
-
-	// copy UV plane
-	p /=2;
-	q /=2;
-	pt = (p + q*fw/2)*2;
-	pti = sy_size;
-
-	for(int i=0;i<sw/2;i++)
-	{
-		if(pt > frame->data.double_plane.uv_size || pti > imginfo->size)
-			break;
-		memcpy(frame->data.double_plane.uv + pt, imginfo->data + pti, sizeof(unsigned char)*sh);
-		pt += fw;
-		pti += sh;
-	}
-#else
-	for(int i=0;i<sw;i++)
-	{
-		if(pt >= frame->data.double_plane.y_size || pti >= sy_size)
-			break;
-		for(int j=0;j<sh;j++)
-		{
-			if(pt+j < frame->data.double_plane.y_size && pti+j < sy_size)
-				if(imginfo->data[pti+j] <= 220)
-					frame->data.double_plane.y[pt+j] = imginfo->data[pti+j];
-		}
-		pt += fw;
-		pti += sh;
+	unsigned char *img_source = NULL;
+	int width, height;
+	unsigned int size_decode;
+
+	int error_code = image_util_decode_jpeg(path, IMAGE_UTIL_COLORSPACE_RGBA8888, &img_source, &width, &height, &size_decode);
+	if (error_code != IMAGE_UTIL_ERROR_NONE) {
+		DLOG_PRINT_ERROR("image_util_decode_jpeg", error_code);
+		return false;
 	}
 
-	// copy UV plane
-	p /=2;
-	q /=2;
-	pt = (p + q*fw/2)*2-1;
-	pti = sy_size;
-
-	for(int i=0;i<sw/2;i++)
-	{
-		if(pt >= frame->data.double_plane.uv_size || pti >= imginfo->size)
-			break;
-		for(int j=0;j<sh;j++)
-		{
-			if(pt+j < frame->data.double_plane.uv_size && pti+j < imginfo->size)
-				frame->data.double_plane.uv[pt+j] = imginfo->data[pti+j];
+	img.set_size(height, width);
+	const unsigned char* src = img_source;
+	for (int r = 0; r < height; r++) {
+		for (int c = 0; c < width; c++, src += 4) {
+			dlib::rgb_alpha_pixel& px = img[r][c];
+			px.red = src[0];
+			px.green = src[1];
+			px.blue = src[2];
+			/* BT.601 luma */
+			px.alpha = (77 * src[0] + 150 * src[1] + 29 * src[2]) >> 8 > STICKER_WHITE_KEY ? 0 : 255;
 		}
-		pt += fw;
-		pti += sh;
 	}
-#endif
-}
-
-void _image_util_start_cb(imageinfo* imginfo)
-{
-    /* Decode the given JPEG file to the img_source buffer. */
-    unsigned char *img_source = NULL;
-    int width, height;
-    unsigned int size_decode;
-
-    char *resource_path = app_get_resource_path();
-    snprintf(sample_file_path, BUFLEN, "%s%s", resource_path, image_util_source_filename);
-
-    int error_code = image_util_decode_jpeg(sample_file_path, IMAGE_UTIL_COLORSPACE_NV12, &img_source, &width, &height, &size_decode);
-    if (error_code != IMAGE_UTIL_ERROR_NONE) {
-        DLOG_PRINT_ERROR("image_util_decode_jpeg", error_code);
-        imginfo->error = error_code;
-        return;
-    }
-
-    imginfo->error = error_code;
-    imginfo->size = size_decode;
-    imginfo->width = width;
-    imginfo->height = height;
-	imginfo->data = (unsigned char*)malloc(sizeof(unsigned char)*imginfo->size);
-	memcpy(imginfo->data, img_source, sizeof(unsigned char)*imginfo->size);
-
-    DLOG_PRINT_DEBUG_MSG("Decoded image width: %d height: %d size: %d", width, height, size_decode);
 
-    /* no need to transform RGB->NV12, just decode into NV12 */
+	free(img_source);
+	return true;
 }
 
 const char *_map_colorspace(image_util_colorspace_e color_space)
@@ -0,0 +1,167 @@
+/*
+ * landmark_filter.cpp
+ *
+ *  Every landmark gets its own constant velocity Kalman filter. Filtering
+ *  removes the frame to frame jitter of the shape predictor, and the velocity
+ *  estimate lets the landmarks be extrapolated to the time a frame is shown,
+ *  which hides the time spent fitting them.
+ */
+
+#include "landmark_filter.h"
+
+#include <cmath>
+
+/**
+ * @brief Sets up the filter of a new face.
+ * @details The per point filters are created on the first update, once the
+ *          number of landmarks is known.
+ */
+void landmark_filter_init(lmfilter* f, unsigned long id, double process_noise,
+		double measurement_noise)
+{
+	f->points.clear();
+	f->id = id;
+	f->time = 0;
+	f->process_noise = process_noise;
+	f->measurement_noise = measurement_noise;
+}
+
+/**
+ * @brief Corrects the filter with a new shape predictor output.
+ *
+ * @param f      The filter of the face
+ * @param shape  The landmarks fitted on the frame
+ * @param time   The timestamp of the frame, in ms
+ */
+void landmark_filter_update(lmfilter* f, const dlib::full_object_detection& shape,
+		unsigned int time)
+{
+	const double r = f->measurement_noise * f->measurement_noise;
+
+	if (f->points.size() != shape.num_parts()) {
+		dlib::matrix<double, 2, 4> H;
+		H = 1, 0, 0, 0,
+			0, 1, 0, 0;
+		dlib::matrix<double, 2, 2> R;
+		R = r, 0,
+			0, r;
+		/* the first position comes from the measurement, the speed is unknown */
+		dlib::matrix<double, 4, 4> P;
+		P = r, 0, 0, 0,
+			0, r, 0, 0,
+			0, 0, 1e6, 0,
+			0, 0, 0, 1e6;
+
+		dlib::matrix<double, 4, 1> x;
+		f->points.assign(shape.num_parts(), dlib::kalman_filter<4, 2>());
+		for (unsigned long i = 0; i < f->points.size(); i++) {
+			f->points[i].set_observation_model(H);
+			f->points[i].set_measurement_noise(R);
+			f->points[i].set_estimation_error_covariance(P);
+			x = shape.part(i).x(), shape.part(i).y(), 0, 0;
+			f->points[i].set_state(x);
+		}
+		f->rect = shape.get_rect();
+		f->time = time;
+		return;
+	}
+
+	/* frames do not arrive at a fixed rate, so rebuild the model for this interval */
+	int ms = (int) (time - f->time);
+	if (ms <= 0)
+		ms = LMF_DEFAULT_DT;
+	const double dt = ms / 1000.0;
+	const double q = f->process_noise;
+
+	dlib::matrix<double, 4, 4> A;
+	A = 1, 0, dt, 0,
+		0, 1, 0, dt,
+		0, 0, 1, 0,
+		0, 0, 0, 1;
+	/* white noise acceleration */
+	const double q3 = q * dt * dt * dt / 3, q2 = q * dt * dt / 2, q1 = q * dt;
+	dlib::matrix<double, 4, 4> Q;
+	Q = q3, 0, q2, 0,
+		0, q3, 0, q2,
+		q2, 0, q1, 0,
+		0, q2, 0, q1;
+
+	dlib::matrix<double, 2, 1> z;
+	for (unsigned long i = 0; i < f->points.size(); i++) {
+		dlib::kalman_filter<4, 2>& kf = f->points[i];
+		kf.set_transition_model(A);
+		kf.set_process_noise(Q);
+		/* kalman_filter predicted with the previous interval, redo it with this one */
+		kf.set_state(A * kf.get_current_state());
+
+		z = shape.part(i).x(), shape.part(i).y();
+		kf.update(z);
+	}
+
+	f->rect = shape.get_rect();
+	f->time = time;
+}
+
+/**
+ * @brief Extrapolates the landmarks to the given time.
+ *
+ * @param f      The filter of the face
+ * @param time   The time the landmarks are needed for, in ms. Passing the
+ *               time of the last update gives the smoothed landmarks.
+ * @param shape  Receives the predicted landmarks
+ */
+void landmark_filter_predict(const lmfilter* f, unsigned int time,
+		dlib::full_object_detection& shape)
+{
+	const double dt = (int) (time - f->time) / 1000.0;
+
+	if (shape.num_parts() != f->points.size())
+		shape = dlib::full_object_detection(f->rect,
+				std::vector<dlib::point>(f->points.size()));
+	else
+		shape.get_rect() = f->rect;
+
+	for (unsigned long i = 0; i < f->points.size(); i++) {
+		const dlib::matrix<double, 4, 1>& x = f->points[i].get_current_state();
+		shape.part(i) = dlib::point(std::floor(x(0) + x(2) * dt + 0.5),
+				std::floor(x(1) + x(3) * dt + 0.5));
+	}
+}
+
+/**
+ * @brief Returns the filter of the given face, creating it if needed.
+ */
+lmfilter* landmark_filter_find(std::vector<lmfilter>& filters, unsigned long id)
+{
+	for (size_t i = 0; i < filters.size(); i++) {
+		if (filters[i].id == id)
+			return &filters[i];
+	}
+
+	filters.push_back(lmfilter());
+	landmark_filter_init(&filters.back(), id, LMF_PROCESS_NOISE,
+			LMF_MEASUREMENT_NOISE);
+	return &filters.back();
+}
+
+/**
+ * @brief Drops the filters of faces that are no longer tracked.
+ */
+void landmark_filter_prune(std::vector<lmfilter>& filters,
+		const std::vector<unsigned long>& ids)
+{
+	for (size_t i = 0; i < filters.size();) {
+		bool alive = false;
+		for (size_t j = 0; j < ids.size(); j++) {
+			if (ids[j] == filters[i].id)
+				alive = true;
+		}
+
+		if (alive) {
+			i++;
+		} else {
+			filters[i] = filters.back();
+			filters.pop_back();
+		}
+	}
+}
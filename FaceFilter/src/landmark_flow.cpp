@@ -0,0 +1,284 @@
+/*
+ * landmark_flow.cpp
+ *
+ *  Pyramidal Lucas-Kanade (Bouguet's formulation) on float luma pyramids.
+ *  The template patch and its gradients are sampled once per point and
+ *  level, then each iteration only resamples the current frame. The patch
+ *  rows are processed four pixels at a time with dlib::simd4f, which maps
+ *  to NEON on the device and SSE on the emulator.
+ */
+
+#include "landmark_flow.h"
+
+#include <cmath>
+#include <dlib/simd.h>
+#include <dlib/image_transforms.h>
+
+#define FLOW_MIN_EIG 1.0f
+
+/* the template is sampled with a one pixel border for the gradients */
+#define TPL_W (FLOW_WIN + 4)
+#define TPL_H (FLOW_WIN + 2)
+
+/**
+ * @brief Bilinearly samples a w x h patch whose top left corner is at (x, y).
+ * @details Every pixel of the patch shares the same sub-pixel offset, so the
+ *          four interpolation weights are computed once per patch.
+ *
+ * @return @c false if the patch does not fit inside the image
+ */
+static bool _flow_sample(const dlib::array2d<float>& img, float x, float y,
+		int w, int h, float* out)
+{
+	const int ix = (int) std::floor(x);
+	const int iy = (int) std::floor(y);
+	if (ix < 0 || iy < 0 || ix + w + 1 > img.nc() || iy + h + 1 > img.nr())
+		return false;
+
+	const float fx = x - ix, fy = y - iy;
+	const dlib::simd4f w00((1 - fx) * (1 - fy)), w01(fx * (1 - fy));
+	const dlib::simd4f w10((1 - fx) * fy), w11(fx * fy);
+
+	for (int r = 0; r < h; r++) {
+		const float* r0 = &img[iy + r][ix];
+		const float* r1 = &img[iy + r + 1][ix];
+		for (int c = 0; c < w; c += 4) {
+			dlib::simd4f a, b, d, e;
+			a.load(r0 + c);
+			b.load(r0 + c + 1);
+			d.load(r1 + c);
+			e.load(r1 + c + 1);
+			(w00 * a + w01 * b + w10 * d + w11 * e).store(out + r * w + c);
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Tracks one point on one pyramid level.
+ *
+ * @param prev  The previous frame at this level
+ * @param cur   The current frame at this level
+ * @param p     The point on the previous frame
+ * @param q     In: the initial guess on the current frame. Out: the result.
+ * @param res   Receives the mean absolute intensity error of the window
+ *
+ * @return @c false if the point left the image or sits on a flat patch
+ */
+static bool _flow_track_level(const dlib::array2d<float>& prev,
+		const dlib::array2d<float>& cur, const dlib::vector<double, 2>& p,
+		dlib::vector<double, 2>& q, float& res)
+{
+	const float half = (FLOW_WIN - 1) / 2.0f;
+	float tpl[TPL_W * TPL_H];
+	float ix[FLOW_WIN * FLOW_WIN], iy[FLOW_WIN * FLOW_WIN], t[FLOW_WIN * FLOW_WIN];
+	float j[FLOW_WIN * FLOW_WIN];
+
+	if (!_flow_sample(prev, p.x() - half - 1, p.y() - half - 1, TPL_W, TPL_H, tpl))
+		return false;
+
+	/* template and its central difference gradients */
+	dlib::simd4f gxx(0), gxy(0), gyy(0);
+	const dlib::simd4f h(0.5f);
+	for (int r = 0; r < FLOW_WIN; r++) {
+		for (int c = 0; c < FLOW_WIN; c += 4) {
+			const float* row = tpl + (r + 1) * TPL_W + c + 1;
+			dlib::simd4f l, rr, u, d, m;
+			l.load(row - 1);
+			rr.load(row + 1);
+			u.load(row - TPL_W);
+			d.load(row + TPL_W);
+			m.load(row);
+			const dlib::simd4f gx = (rr - l) * h, gy = (d - u) * h;
+			gx.store(ix + r * FLOW_WIN + c);
+			gy.store(iy + r * FLOW_WIN + c);
+			m.store(t + r * FLOW_WIN + c);
+			gxx += gx * gx;
+			gxy += gx * gy;
+			gyy += gy * gy;
+		}
+	}
+
+	const float a = dlib::sum(gxx), b = dlib::sum(gxy), c = dlib::sum(gyy);
+	const float det = a * c - b * b;
+	const float min_eig = (a + c - std::sqrt((a - c) * (a - c) + 4 * b * b)) / 2;
+	if (min_eig / (FLOW_WIN * FLOW_WIN) < FLOW_MIN_EIG || det == 0)
+		return false;
+
+	for (int it = 0; it < FLOW_MAX_ITER; it++) {
+		if (!_flow_sample(cur, q.x() - half, q.y() - half, FLOW_WIN, FLOW_WIN, j))
+			return false;
+
+		dlib::simd4f bx(0), by(0);
+		for (int k = 0; k < FLOW_WIN * FLOW_WIN; k += 4) {
+			dlib::simd4f tt, jj, gx, gy;
+			tt.load(t + k);
+			jj.load(j + k);
+			gx.load(ix + k);
+			gy.load(iy + k);
+			const dlib::simd4f e = tt - jj;
+			bx += e * gx;
+			by += e * gy;
+		}
+
+		const float ex = dlib::sum(bx), ey = dlib::sum(by);
+		const float dx = (c * ex - b * ey) / det;
+		const float dy = (a * ey - b * ex) / det;
+		q.x() += dx;
+		q.y() += dy;
+		if (dx * dx + dy * dy < FLOW_EPS * FLOW_EPS)
+			break;
+	}
+
+	if (!_flow_sample(cur, q.x() - half, q.y() - half, FLOW_WIN, FLOW_WIN, j))
+		return false;
+	float err = 0;
+	for (int k = 0; k < FLOW_WIN * FLOW_WIN; k++)
+		err += std::abs(t[k] - j[k]);
+	res = err / (FLOW_WIN * FLOW_WIN);
+	return true;
+}
+
+/**
+ * @brief Builds the pyramid of a new frame and keeps the previous one.
+ * @details The levels are reused between frames, so nothing is allocated
+ *          once the preview size is stable.
+ */
+void landmark_flow_push_frame(flowdata* fd, const dlib::array2d<unsigned char>& img)
+{
+	fd->prev.swap(fd->cur);
+	fd->has_prev = fd->prev.size() == FLOW_LEVELS
+			&& fd->prev[0].nr() == img.nr() && fd->prev[0].nc() == img.nc();
+
+	dlib::pyramid_down<2> pyr;
+	fd->cur.resize(FLOW_LEVELS);
+	dlib::assign_image(fd->cur[0], img);
+	for (unsigned long l = 1; l < FLOW_LEVELS; l++)
+		pyr(fd->cur[l - 1], fd->cur[l]);
+}
+
+/**
+ * @brief Moves the landmarks of a face from the previous frame to the current one.
+ * @details Points that could not be tracked, or whose residual is above
+ *          FLOW_MAX_RESIDUAL, keep their position and get a residual of
+ *          FLOW_LOST.
+ *
+ * @param fd  The frame pyramids
+ * @param ft  The landmarks of the face
+ *
+ * @return The mean residual of the points that were tracked
+ */
+double landmark_flow_track(const flowdata* fd, flowtrack* ft)
+{
+	ft->frames_since_fit++;
+	ft->residuals.assign(ft->points.size(), FLOW_LOST);
+	if (!fd->has_prev || ft->points.empty())
+		return FLOW_LOST;
+
+	dlib::pyramid_down<2> pyr;
+	double total = 0;
+	unsigned long tracked = 0;
+	for (unsigned long i = 0; i < ft->points.size(); i++) {
+		const dlib::vector<double, 2> p0 = ft->points[i];
+		dlib::vector<double, 2> q = pyr.point_down(p0, FLOW_LEVELS - 1);
+		bool ok = true;
+		float res = FLOW_LOST;
+
+		for (int l = FLOW_LEVELS - 1; l >= 0 && ok; l--) {
+			const dlib::vector<double, 2> p = pyr.point_down(p0, l);
+			ok = _flow_track_level(fd->prev[l], fd->cur[l], p, q, res);
+			if (l > 0)
+				q = pyr.point_up(q);
+		}
+
+		if (ok && res <= FLOW_MAX_RESIDUAL) {
+			/* keep the fraction, rounding every frame would make the points drift */
+			ft->points[i] = q;
+			ft->shape.part(i) = dlib::point(std::floor(q.x() + 0.5), std::floor(q.y() + 0.5));
+			ft->residuals[i] = res;
+			total += res;
+			tracked++;
+		}
+	}
+
+	return tracked > 0 ? total / tracked : FLOW_LOST;
+}
+
+/**
+ * @brief Tells whether the shape predictor has to run on this face again.
+ *
+ * @param ft    The landmarks of the face, as tracked by the flow
+ * @param face  The box of the face on the current frame
+ */
+bool landmark_flow_need_fit(const flowtrack* ft, const dlib::rectangle& face)
+{
+	if (ft->points.empty() || ft->frames_since_fit >= FLOW_REFIT_INTERVAL)
+		return true;
+
+	/* the face tracker was re-acquired somewhere else */
+	dlib::vector<double, 2> mean(0, 0);
+	for (unsigned long i = 0; i < ft->points.size(); i++)
+		mean += ft->points[i];
+	mean /= ft->points.size();
+	if (!face.contains(dlib::point(mean)))
+		return true;
+
+	/* the flow drifted */
+	unsigned long lost = 0;
+	for (size_t i = 0; i < ft->residuals.size(); i++) {
+		if (ft->residuals[i] >= FLOW_LOST)
+			lost++;
+	}
+	return lost > FLOW_MAX_LOST * ft->residuals.size();
+}
+
+/**
+ * @brief Restarts the flow from a fresh shape predictor output.
+ */
+void landmark_flow_set_shape(flowtrack* ft, const dlib::full_object_detection& shape)
+{
+	ft->shape = shape;
+	ft->points.resize(shape.num_parts());
+	for (unsigned long i = 0; i < shape.num_parts(); i++)
+		ft->points[i] = shape.part(i);
+	ft->residuals.assign(shape.num_parts(), 0);
+	ft->frames_since_fit = 0;
+}
+
+/**
+ * @brief Returns the flow state of the given face, creating it if needed.
+ */
+flowtrack* landmark_flow_find(std::vector<flowtrack>& tracks, unsigned long id)
+{
+	for (size_t i = 0; i < tracks.size(); i++) {
+		if (tracks[i].id == id)
+			return &tracks[i];
+	}
+
+	tracks.push_back(flowtrack());
+	tracks.back().id = id;
+	tracks.back().frames_since_fit = 0;
+	return &tracks.back();
+}
+
+/**
+ * @brief Drops the flow state of faces that are no longer tracked.
+ */
+void landmark_flow_prune(std::vector<flowtrack>& tracks,
+		const std::vector<unsigned long>& ids)
+{
+	for (size_t i = 0; i < tracks.size();) {
+		bool alive = false;
+		for (size_t j = 0; j < ids.size(); j++) {
+			if (ids[j] == tracks[i].id)
+				alive = true;
+		}
+
+		if (alive) {
+			i++;
+		} else {
+			tracks[i] = tracks.back();
+			tracks.pop_back();
+		}
+	}
+}
@@ -0,0 +1,198 @@
+/*
+ * nv12_compositor.cpp
+ *
+ *  A premultiplied sample is blended with dst = src + dst * (255 - a) / 255.
+ *  Luma and chroma use the same row kernel: the chroma alpha is stored once
+ *  per byte of the interleaved UV plane, so U and V need no special casing.
+ *  The division by 255 is done with the exact (t + 128 + ((t + 128) >> 8)) >> 8
+ *  identity, which maps to a handful of NEON or SSE2 instructions.
+ */
+
+#include "nv12_compositor.h"
+
+#include <algorithm>
+#include <dlib/simd.h>
+
+/**
+ * @brief Blends n premultiplied samples over dst.
+ */
+static inline void _blend_row(unsigned char* dst, const unsigned char* src,
+		const unsigned char* alpha, int n)
+{
+	int i = 0;
+
+#if defined(DLIB_HAVE_NEON)
+	for (; i + 16 <= n; i += 16) {
+		const uint8x16_t d = vld1q_u8(dst + i);
+		const uint8x16_t ia = vmvnq_u8(vld1q_u8(alpha + i));
+		const uint16x8_t lo = vmull_u8(vget_low_u8(d), vget_low_u8(ia));
+		const uint16x8_t hi = vmull_u8(vget_high_u8(d), vget_high_u8(ia));
+		const uint8x16_t r = vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)),
+				vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+		vst1q_u8(dst + i, vqaddq_u8(vld1q_u8(src + i), r));
+	}
+#elif defined(DLIB_HAVE_AVX2)
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ff = _mm256_set1_epi16(255), half = _mm256_set1_epi16(128);
+	for (; i + 32 <= n; i += 32) {
+		const __m256i d = _mm256_loadu_si256((const __m256i*) (dst + i));
+		const __m256i a = _mm256_loadu_si256((const __m256i*) (alpha + i));
+		__m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero),
+				_mm256_sub_epi16(ff, _mm256_unpacklo_epi8(a, zero)));
+		__m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero),
+				_mm256_sub_epi16(ff, _mm256_unpackhi_epi8(a, zero)));
+		lo = _mm256_add_epi16(lo, half);
+		hi = _mm256_add_epi16(hi, half);
+		lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+		hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+		/* unpack and pack both work within 128 bit lanes, so the order is kept */
+		const __m256i s = _mm256_loadu_si256((const __m256i*) (src + i));
+		_mm256_storeu_si256((__m256i*) (dst + i),
+				_mm256_adds_epu8(s, _mm256_packus_epi16(lo, hi)));
+	}
+#elif defined(DLIB_HAVE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ff = _mm_set1_epi16(255), half = _mm_set1_epi16(128);
+	for (; i + 16 <= n; i += 16) {
+		const __m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+		const __m128i a = _mm_loadu_si128((const __m128i*) (alpha + i));
+		__m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+				_mm_sub_epi16(ff, _mm_unpacklo_epi8(a, zero)));
+		__m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+				_mm_sub_epi16(ff, _mm_unpackhi_epi8(a, zero)));
+		lo = _mm_add_epi16(lo, half);
+		hi = _mm_add_epi16(hi, half);
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+		const __m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+	}
+#endif
+
+	for (; i < n; i++) {
+		const unsigned t = dst[i] * (255 - alpha[i]) + 128;
+		const unsigned v = src[i] + ((t + (t >> 8)) >> 8);
+		dst[i] = v > 255 ? 255 : v;
+	}
+}
+
+/**
+ * @brief Converts a premultiplied RGBA sticker into premultiplied NV12 planes.
+ * @details BT.601 limited range, like the camera preview. The chroma of a
+ *          2x2 block is the mean of its premultiplied samples, which is the
+ *          correctly weighted mean of the colors.
+ *
+ * @param pixels  The sticker, premultiplied, as given by the sticker atlas
+ * @param rows    The height of the sticker
+ * @param cols    The width of the sticker
+ * @param rotate  @c true if the sticker is upright in the orientation of the
+ *                rotated gray image rather than in the orientation of the frame
+ * @param st      Receives the sticker. Odd sizes are padded with transparent
+ *                pixels.
+ */
+void nv12_sticker_build(const dlib::rgb_alpha_pixel* pixels, long rows, long cols, bool rotate,
+		nv12sticker* st)
+{
+	/* size in frame orientation */
+	const long fw = rotate ? rows : cols;
+	const long fh = rotate ? cols : rows;
+	const int width = (fw + 1) & ~1;
+	const int height = (fh + 1) & ~1;
+
+	st->data.assign(NV12_STICKER_SIZE(width, height), 0);
+	nv12_sticker_attach(&st->data[0], width, height, st);
+	unsigned char* y = &st->data[0];
+	unsigned char* ya = y + width * height;
+	unsigned char* uv = ya + width * height;
+	unsigned char* uva = uv + width * height / 2;
+
+	/* per pixel premultiplied U and V, summed into their 2x2 block */
+	std::vector<int> us(width * height / 4, 0), vs(us.size(), 0), as(us.size(), 0);
+
+	for (long r = 0; r < fh; r++) {
+		for (long x = 0; x < fw; x++) {
+			/* the same mapping as the gray image built from the frame */
+			const dlib::rgb_alpha_pixel& p = rotate ? pixels[x * cols + cols - 1 - r] : pixels[r * cols + x];
+			const int red = p.red, g = p.green, b = p.blue, a = p.alpha;
+			const int k = r * width + x;
+
+			y[k] = std::min(a, ((66 * red + 129 * g + 25 * b + 128) >> 8) + (16 * a + 127) / 255);
+			ya[k] = a;
+
+			const int c = (r / 2) * (width / 2) + x / 2;
+			us[c] += ((-38 * red - 74 * g + 112 * b + 128) >> 8) + (128 * a + 127) / 255;
+			vs[c] += ((112 * red - 94 * g - 18 * b + 128) >> 8) + (128 * a + 127) / 255;
+			as[c] += a;
+		}
+	}
+
+	for (size_t c = 0; c < as.size(); c++) {
+		const int a = (as[c] + 2) >> 2;
+		uv[2 * c] = std::max(0, std::min(a, (us[c] + 2) >> 2));
+		uv[2 * c + 1] = std::max(0, std::min(a, (vs[c] + 2) >> 2));
+		uva[2 * c] = a;
+		uva[2 * c + 1] = a;
+	}
+}
+
+/**
+ * @brief Points a sticker at planes laid out like nv12_sticker_build lays them out.
+ *
+ * @param planes  NV12_STICKER_SIZE(width, height) bytes: luma, luma alpha,
+ *                chroma and chroma alpha, back to back. They are used in place.
+ * @param width   The sticker width, even
+ * @param height  The sticker height, even
+ * @param st      Receives the sticker
+ */
+void nv12_sticker_attach(const unsigned char* planes, int width, int height, nv12sticker* st)
+{
+	st->width = width;
+	st->height = height;
+	st->y = planes;
+	st->ya = st->y + width * height;
+	st->uv = st->ya + width * height;
+	st->uva = st->uv + width * height / 2;
+}
+
+/**
+ * @brief Blends a sticker into an NV12 frame.
+ * @details The sticker is clipped against the frame and the rows once, then every row is
+ *          blended without any further bounds check. It is moved to an even
+ *          position so its chroma lines up with the chroma of the frame.
+ *
+ * @param y           The luma plane of the frame
+ * @param uv          The interleaved chroma plane of the frame
+ * @param width       The frame width, even
+ * @param height      The frame height, even
+ * @param st          The sticker
+ * @param cx          The x coordinate of the sticker center on the frame
+ * @param cy          The y coordinate of the sticker center on the frame
+ * @param top_row     The first frame row to blend, even
+ * @param bottom_row  One past the last frame row to blend, even
+ */
+void nv12_blend_sticker(unsigned char* y, unsigned char* uv, int width, int height,
+		const nv12sticker* st, int cx, int cy, int top_row, int bottom_row)
+{
+	int left = cx - st->width / 2;
+	int top = cy - st->height / 2;
+	left -= left & 1;
+	top -= top & 1;
+
+	const int x0 = std::max(left, 0), x1 = std::min(left + st->width, width);
+	const int y0 = std::max(std::max(top, 0), top_row);
+	const int y1 = std::min(std::min(top + st->height, height), bottom_row);
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	const int n = x1 - x0;
+	for (int r = y0; r < y1; r++) {
+		const int k = (r - top) * st->width + (x0 - left);
+		_blend_row(y + r * width + x0, &st->y[k], &st->ya[k], n);
+	}
+
+	/* a chroma row holds width / 2 interleaved pairs, so it is width bytes long too */
+	for (int r = y0 / 2; r < y1 / 2; r++) {
+		const int k = (r - top / 2) * st->width + (x0 - left);
+		_blend_row(uv + r * width + x0, &st->uv[k], &st->uva[k], n);
+	}
+}
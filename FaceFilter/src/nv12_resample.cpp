@@ -0,0 +1,266 @@
+/*
+ * nv12_resample.cpp
+ *
+ *  Every source row a destination row needs is first scaled to the
+ *  destination width: every destination sample blends the two source
+ *  samples around it, eight at a time, the pairs being read one by one
+ *  as their positions only follow the scale. Cb and Cr are read and
+ *  written interleaved, two samples apart. Every destination row then
+ *  blends the two scaled rows around it, sixteen bytes at a time. The
+ *  scaled rows are kept from one destination row to the next, so when
+ *  zooming in every source row is scaled only once.
+ *
+ *  Positions and weights are in 1/256 of a sample, computed once per call
+ *  for the columns and once per row for the rows, so the inner loops are
+ *  only loads, multiplies and adds.
+ */
+
+#include "nv12_resample.h"
+
+#include <algorithm>
+#include <dlib/simd.h>
+
+/**
+ * @brief Finds the two source samples around destination sample i.
+ * @details Sample centers are lined up, as when the whole source is
+ *          stretched over the whole destination. The last source sample
+ *          is reached with the one left of it and a weight of 256, so no
+ *          pair reads past the row.
+ *
+ * @param i       The destination sample
+ * @param src     The source samples
+ * @param dst     The destination samples
+ * @param index   Receives the left or upper source sample
+ * @param weight  Receives the weight of the one after it, in 1/256
+ */
+static inline void _resample_position(int i, int src, int dst, int* index, int* weight)
+{
+	long p = ((2L * i + 1) * src * 128) / dst - 128;
+	p = std::max(0L, std::min(p, (long) (src - 1) * 256));
+	*index = std::max(0, std::min((int) (p >> 8), src - 2));
+	*weight = (int) (p - *index * 256);
+}
+
+static void _resample_positions(int src, int dst, unsigned short* index, unsigned short* weight)
+{
+	for (int i = 0; i < dst; i++) {
+		int k, w;
+		_resample_position(i, src, dst, &k, &w);
+		index[i] = (unsigned short) k;
+		weight[i] = (unsigned short) w;
+	}
+}
+
+#if defined(DLIB_HAVE_NEON)
+/* a, b: 8 samples each, w: their weights */
+static inline uint16x8_t _resample_lerp(uint16x8_t a, uint16x8_t b, uint16x8_t w)
+{
+	const uint16x8_t t = vmlaq_u16(vmulq_u16(a, vsubq_u16(vdupq_n_u16(256), w)), b, w);
+	return vshrq_n_u16(vaddq_u16(t, vdupq_n_u16(128)), 8);
+}
+#elif defined(DLIB_HAVE_SSE2)
+static inline __m128i _resample_lerp(__m128i a, __m128i b, __m128i w)
+{
+	/* at most 255 * 256 + 128, unsigned 16 bits hold it */
+	const __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, _mm_sub_epi16(_mm_set1_epi16(256), w)),
+			_mm_mullo_epi16(b, w));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_set1_epi16(128)), 8);
+}
+#endif
+
+/**
+ * @brief Blends two scaled rows of n bytes into out.
+ */
+static void _resample_rows(const unsigned char* r0, const unsigned char* r1, int w,
+		unsigned char* out, int n)
+{
+	int i = 0;
+
+#if defined(DLIB_HAVE_NEON)
+	const uint16x8_t vw = vdupq_n_u16((unsigned short) w);
+	for (; i + 16 <= n; i += 16) {
+		const uint8x16_t a = vld1q_u8(r0 + i), b = vld1q_u8(r1 + i);
+		const uint16x8_t lo = _resample_lerp(vmovl_u8(vget_low_u8(a)), vmovl_u8(vget_low_u8(b)), vw);
+		const uint16x8_t hi = _resample_lerp(vmovl_u8(vget_high_u8(a)), vmovl_u8(vget_high_u8(b)), vw);
+		vst1q_u8(out + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+	}
+#elif defined(DLIB_HAVE_SSE2)
+	const __m128i zero = _mm_setzero_si128(), vw = _mm_set1_epi16((short) w);
+	for (; i + 16 <= n; i += 16) {
+		const __m128i a = _mm_loadu_si128((const __m128i*) (r0 + i));
+		const __m128i b = _mm_loadu_si128((const __m128i*) (r1 + i));
+		const __m128i lo = _resample_lerp(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), vw);
+		const __m128i hi = _resample_lerp(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), vw);
+		_mm_storeu_si128((__m128i*) (out + i), _mm_packus_epi16(lo, hi));
+	}
+#endif
+
+	for (; i < n; i++)
+		out[i] = (unsigned char) ((r0[i] * (256 - w) + r1[i] * w + 128) >> 8);
+}
+
+/* the samples index and index + 1 of row, step bytes apart, the left one in the low byte */
+static inline unsigned short _resample_pair(const unsigned char* row, int step, int index)
+{
+	const unsigned char* p = row + index * step;
+	return (unsigned short) (p[0] | p[step] << 8);
+}
+
+#if defined(DLIB_HAVE_NEON)
+static inline uint16x8_t _resample_cols8(const unsigned char* row, int step, const unsigned short* index,
+		const unsigned short* weight)
+{
+	uint16x8_t p = vdupq_n_u16(_resample_pair(row, step, index[0]));
+	p = vsetq_lane_u16(_resample_pair(row, step, index[1]), p, 1);
+	p = vsetq_lane_u16(_resample_pair(row, step, index[2]), p, 2);
+	p = vsetq_lane_u16(_resample_pair(row, step, index[3]), p, 3);
+	p = vsetq_lane_u16(_resample_pair(row, step, index[4]), p, 4);
+	p = vsetq_lane_u16(_resample_pair(row, step, index[5]), p, 5);
+	p = vsetq_lane_u16(_resample_pair(row, step, index[6]), p, 6);
+	p = vsetq_lane_u16(_resample_pair(row, step, index[7]), p, 7);
+	return _resample_lerp(vandq_u16(p, vdupq_n_u16(0xff)), vshrq_n_u16(p, 8), vld1q_u16(weight));
+}
+#elif defined(DLIB_HAVE_SSE2)
+static inline __m128i _resample_cols8(const unsigned char* row, int step, const unsigned short* index,
+		const unsigned short* weight)
+{
+	/* inserted lane by lane: eight small stores read back as one vector would stall the load */
+	__m128i p = _mm_cvtsi32_si128(_resample_pair(row, step, index[0]));
+	p = _mm_insert_epi16(p, _resample_pair(row, step, index[1]), 1);
+	p = _mm_insert_epi16(p, _resample_pair(row, step, index[2]), 2);
+	p = _mm_insert_epi16(p, _resample_pair(row, step, index[3]), 3);
+	p = _mm_insert_epi16(p, _resample_pair(row, step, index[4]), 4);
+	p = _mm_insert_epi16(p, _resample_pair(row, step, index[5]), 5);
+	p = _mm_insert_epi16(p, _resample_pair(row, step, index[6]), 6);
+	p = _mm_insert_epi16(p, _resample_pair(row, step, index[7]), 7);
+	return _resample_lerp(_mm_and_si128(p, _mm_set1_epi16(0xff)), _mm_srli_epi16(p, 8),
+			_mm_loadu_si128((const __m128i*) weight));
+}
+#endif
+
+static inline unsigned char _resample_col(const unsigned char* row, int step, int index, int weight)
+{
+	const unsigned char* p = row + index * step;
+	return (unsigned char) ((p[0] * (256 - weight) + p[step] * weight + 128) >> 8);
+}
+
+/**
+ * @brief Scales a source row of luma to n samples.
+ */
+static void _resample_luma_cols(const unsigned char* row, const unsigned short* index,
+		const unsigned short* weight, unsigned char* out, int n)
+{
+	int x = 0;
+
+#if defined(DLIB_HAVE_NEON)
+	for (; x + 16 <= n; x += 16)
+		vst1q_u8(out + x, vcombine_u8(vmovn_u16(_resample_cols8(row, 1, index + x, weight + x)),
+				vmovn_u16(_resample_cols8(row, 1, index + x + 8, weight + x + 8))));
+#elif defined(DLIB_HAVE_SSE2)
+	for (; x + 16 <= n; x += 16)
+		_mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi16(_resample_cols8(row, 1, index + x, weight + x),
+				_resample_cols8(row, 1, index + x + 8, weight + x + 8)));
+#endif
+
+	for (; x < n; x++)
+		out[x] = _resample_col(row, 1, index[x], weight[x]);
+}
+
+/**
+ * @brief Scales a source row of Cb Cr pairs to n pairs.
+ */
+static void _resample_chroma_cols(const unsigned char* row, const unsigned short* index,
+		const unsigned short* weight, unsigned char* out, int n)
+{
+	int x = 0;
+
+#if defined(DLIB_HAVE_NEON)
+	for (; x + 8 <= n; x += 8) {
+		uint8x8x2_t v;
+		v.val[0] = vmovn_u16(_resample_cols8(row, 2, index + x, weight + x));
+		v.val[1] = vmovn_u16(_resample_cols8(row + 1, 2, index + x, weight + x));
+		vst2_u8(out + 2 * x, v);
+	}
+#elif defined(DLIB_HAVE_SSE2)
+	for (; x + 8 <= n; x += 8) {
+		const __m128i u = _resample_cols8(row, 2, index + x, weight + x);
+		const __m128i v = _resample_cols8(row + 1, 2, index + x, weight + x);
+		_mm_storeu_si128((__m128i*) (out + 2 * x), _mm_or_si128(u, _mm_slli_epi16(v, 8)));
+	}
+#endif
+
+	for (; x < n; x++) {
+		out[2 * x] = _resample_col(row, 2, index[x], weight[x]);
+		out[2 * x + 1] = _resample_col(row + 1, 2, index[x], weight[x]);
+	}
+}
+
+/**
+ * @brief Resamples a plane, luma or chroma, row by row.
+ *
+ * @param rs          The column positions and the scaled rows
+ * @param src         The first source row
+ * @param src_rows    The source rows
+ * @param src_stride  The bytes between two source rows
+ * @param dst         The first destination row
+ * @param dst_rows    The destination rows
+ * @param width       The bytes of a destination row
+ * @param chroma      Whether the plane holds Cb Cr pairs
+ */
+static void _resample_plane(nv12resampler* rs, const unsigned char* src, int src_rows, int src_stride,
+		unsigned char* dst, int dst_rows, int width, bool chroma)
+{
+	unsigned char* line[2] = { &rs->rows[0], &rs->rows[width] };
+	int scaled[2] = { -1, -1 }; /* the source row every line holds */
+
+	for (int j = 0; j < dst_rows; j++) {
+		int k, w;
+		_resample_position(j, src_rows, dst_rows, &k, &w);
+		if (scaled[0] != k && scaled[1] == k) {
+			std::swap(line[0], line[1]);
+			std::swap(scaled[0], scaled[1]);
+		}
+		for (int i = 0; i < 2; i++) {
+			if (scaled[i] == k + i)
+				continue;
+			const unsigned char* row = src + (size_t) (k + i) * src_stride;
+			if (chroma)
+				_resample_chroma_cols(row, &rs->chroma_cols[0], &rs->chroma_weights[0], line[i], width / 2);
+			else
+				_resample_luma_cols(row, &rs->luma_cols[0], &rs->luma_weights[0], line[i], width);
+			scaled[i] = k + i;
+		}
+		_resample_rows(line[0], line[1], w, dst + (size_t) j * width, width);
+	}
+}
+
+/**
+ * @brief Resamples an NV12 window into an NV12 frame.
+ * @details The source must not overlap the destination.
+ *
+ * @param rs          Positions and rows, kept from call to call
+ * @param src_y       The top left luma sample of the window
+ * @param src_uv      The top left Cb Cr pair of the window
+ * @param src_width   The window width, even, at least 4
+ * @param src_height  The window height, even, at least 4
+ * @param src_stride  The bytes between two rows of the source planes
+ * @param y           The luma plane of the destination
+ * @param uv          The chroma plane of the destination
+ * @param width       The destination width, even, at most 65536
+ * @param height      The destination height, even
+ */
+void nv12_resample(nv12resampler* rs, const unsigned char* src_y, const unsigned char* src_uv,
+		int src_width, int src_height, int src_stride,
+		unsigned char* y, unsigned char* uv, int width, int height)
+{
+	rs->luma_cols.resize(width);
+	rs->luma_weights.resize(width);
+	rs->chroma_cols.resize(width / 2);
+	rs->chroma_weights.resize(width / 2);
+	rs->rows.resize(2 * width);
+	_resample_positions(src_width, width, &rs->luma_cols[0], &rs->luma_weights[0]);
+	_resample_positions(src_width / 2, width / 2, &rs->chroma_cols[0], &rs->chroma_weights[0]);
+
+	_resample_plane(rs, src_y, src_height, src_stride, y, height, width, false);
+	_resample_plane(rs, src_uv, src_height / 2, src_stride, uv, height / 2, width, true);
+}
@@ -0,0 +1,636 @@
+/*
+ * portrait.cpp
+ *
+ *  The mask of the people is made on a proxy of the luma, PORTRAIT_PROXY
+ *  times smaller. Every face seeds it with the hull of its landmarks and
+ *  a guess of the head, the neck and the shoulders around it. A guided
+ *  filter, guided by the proxy, pulls the borders of that guess onto the
+ *  edges of the picture; thresholded, opened and closed, it becomes the
+ *  mask. A second guided filter feathers the mask, and its coefficients
+ *  are interpolated over the frame and applied to the luma of the frame
+ *  itself, so the border follows edges finer than the proxy.
+ *
+ *  The background is the frame at half size blurred with
+ *  PORTRAIT_BLUR_PASSES box blurs, which approach a Gaussian, and scaled
+ *  back. The boxes keep running sums, so the blur costs the same whatever
+ *  its radius. Every stage over the frame is cut into strips of rows
+ *  blended on the thread pool.
+ */
+
+#include "portrait.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <dlib/simd.h>
+#include <dlib/image_transforms.h>
+
+template <typename T>
+static T* _portrait_buffer(std::vector<T>& v, size_t n)
+{
+	if (v.size() < n)
+		v.resize(n);
+	return &v[0];
+}
+
+/* number of proxy samples in the box of radius r around i, on a side of n */
+static inline int _portrait_span(int i, int r, int n)
+{
+	return std::min(i + r, n - 1) - std::max(i - r, 0) + 1;
+}
+
+/*
+ * position of frame column or row i between two proxy samples of n: the
+ * first one times 512, plus the weight of the second one in 1/256, which
+ * is 256 on the last sample so that the second one is always there
+ */
+static inline int _portrait_position(int i, int n)
+{
+	const int p = std::max(0, std::min((i * 2 + 1) * 128 / PORTRAIT_PROXY - 128, (n - 1) * 256));
+	const int k = std::min(p >> 8, n - 2);
+	return k << 9 | (p - k * 256);
+}
+
+/**
+ * @brief Starts the mask of a frame, with nobody in it.
+ * @details Makes the proxy of the luma the mask is snapped to.
+ *
+ * @param pt      The effect
+ * @param y       The luma plane
+ * @param width   The frame width, even
+ * @param height  The frame height, even
+ */
+void portrait_begin(portrait* pt, const unsigned char* y, int width, int height)
+{
+	const int s = PORTRAIT_PROXY;
+	const int gw = (width + s - 1) / s, gh = (height + s - 1) / s;
+	int* guide = _portrait_buffer(pt->guide, (size_t) gw * gh);
+	int* squares = _portrait_buffer(pt->squares, (size_t) gw * gh);
+	int* cols = _portrait_buffer(pt->cols, std::max(gw * s, width));
+
+	/* means of s x s blocks, the last ones clamped to the frame */
+	for (int gy = 0; gy < gh; gy++) {
+		for (int i = 0; i < gw * s; i++)
+			cols[i] = 0;
+		for (int j = 0; j < s; j++) {
+			const unsigned char* row = y + (size_t) std::min(gy * s + j, height - 1) * width;
+			for (int i = 0; i < width; i++)
+				cols[i] += row[i];
+			for (int i = width; i < gw * s; i++)
+				cols[i] += row[width - 1];
+		}
+		for (int gx = 0; gx < gw; gx++) {
+			int sum = 0;
+			for (int i = 0; i < s; i++)
+				sum += cols[gx * s + i];
+			const int v = (sum + s * s / 2) / (s * s);
+			guide[gy * gw + gx] = v;
+			squares[gy * gw + gx] = v * v;
+		}
+	}
+
+	pt->seed.set_size(gh, gw);
+	dlib::assign_all_pixels(pt->seed, 0);
+	pt->width = gw;
+	pt->height = gh;
+	pt->figures = 0;
+}
+
+/**
+ * @brief Adds a person to the mask, from the landmarks of the face.
+ * @details Besides the face, the hair, the neck and the shoulders are
+ *          guessed from where the chin and the eyebrows are, so the guess
+ *          turns with the head.
+ *
+ * @param pt      The effect, see portrait_begin()
+ * @param shape   The 68 landmarks, in the rotated gray image
+ * @param width   The frame width
+ * @param height  The frame height
+ *
+ * @return @c false if the shape has no 68 landmarks or the face is off the frame
+ */
+bool portrait_add_figure(portrait* pt, const dlib::full_object_detection& shape, int width, int height)
+{
+	const int s = PORTRAIT_PROXY, gw = pt->width, gh = pt->height;
+	if (gw == 0 || !face_mask_build(&pt->face, shape, FACE_MASK_HULL, width, height))
+		return false;
+
+	/* the face itself, sampled at the middle of every proxy pixel */
+	const facemask* fm = &pt->face;
+	for (int gy = (fm->top + s / 2) / s; gy < gh; gy++) {
+		const int my = gy * s + s / 2 - fm->top;
+		if (my >= fm->height)
+			break;
+		for (int gx = (fm->left + s / 2) / s; gx < gw; gx++) {
+			const int mx = gx * s + s / 2 - fm->left;
+			if (mx >= fm->width)
+				break;
+			if (fm->y[(size_t) my * fm->width + mx] >= 128)
+				pt->seed[gy][gx] = 255;
+		}
+	}
+
+	/* the head and the body, along the axis from the chin up to the eyebrows */
+	const dlib::point& chin = shape.part(8);
+	const dlib::point brows = (shape.part(19) + shape.part(24)) / 2;
+	const float cx = chin.y() + 0.5f, cy = height - 1 - chin.x() + 0.5f;
+	const float ux = brows.y() - chin.y(), uy = chin.x() - brows.x();
+	const float length = ux * ux + uy * uy;
+	if (length < 1.0f)
+		return true;
+
+	const float top = PORTRAIT_HEAD_TOP, bottom = -0.2f;
+	const float neck = 0.35f, neck_end = -0.3f;
+	for (int gy = 0; gy < gh; gy++) {
+		for (int gx = 0; gx < gw; gx++) {
+			const float dx = (gx + 0.5f) * s - cx, dy = (gy + 0.5f) * s - cy;
+			/* along the face, 1 at the eyebrows, and across it */
+			const float a = (dx * ux + dy * uy) / length;
+			const float b = (dx * uy - dy * ux) / length;
+			const float ea = (2.0f * a - top - bottom) / (top - bottom);
+			const float eb = b / PORTRAIT_HEAD_WIDTH;
+			bool inside = ea * ea + eb * eb <= 1.0f;
+			if (a <= 0.0f) {
+				/* the shoulders slope down from the neck */
+				const float half = a > neck_end ? neck
+						: std::min(PORTRAIT_SHOULDERS, neck + (neck_end - a) * 2.5f);
+				inside = inside || fabsf(b) <= half;
+			}
+			if (inside)
+				pt->seed[gy][gx] = 255;
+		}
+	}
+	pt->figures++;
+	return true;
+}
+
+/**
+ * @brief Runs the guided filter of the input on the proxy.
+ * @details Leaves the means of the coefficients in mean_a and mean_b, the
+ *          output being mean_a * guide + mean_b.
+ */
+static void _portrait_guided(portrait* pt, const dlib::array2d<unsigned char>& in, int r, int eps)
+{
+	const int gw = pt->width, gh = pt->height;
+	const size_t n = (size_t) gw * gh;
+	const int* guide = &pt->guide[0];
+	int* input = _portrait_buffer(pt->input, n);
+	int* products = _portrait_buffer(pt->products, n);
+	int* sums[4];
+	for (int i = 0; i < 4; i++)
+		sums[i] = _portrait_buffer(pt->sums[i], n);
+	float* a = _portrait_buffer(pt->a, n);
+	float* b = _portrait_buffer(pt->b, n);
+	float* mean_a = _portrait_buffer(pt->mean_a, n);
+	float* mean_b = _portrait_buffer(pt->mean_b, n);
+
+	for (int gy = 0; gy < gh; gy++)
+		for (int gx = 0; gx < gw; gx++) {
+			const size_t k = (size_t) gy * gw + gx;
+			input[k] = in[gy][gx];
+			products[k] = input[k] * guide[k];
+		}
+
+	/* the buffers are viewed as images, nothing is allocated for them */
+	const dlib::rectangle box(-r, -r, r, r);
+	const int* planes[4] = { guide, &pt->squares[0], input, products };
+	for (int i = 0; i < 4; i++) {
+		auto sums_img = dlib::sub_image(sums[i], gh, gw, gw);
+		dlib::sum_filter_assign(dlib::sub_image(planes[i], gh, gw, gw), sums_img, box);
+	}
+
+	for (int gy = 0; gy < gh; gy++) {
+		const int ny = _portrait_span(gy, r, gh);
+		for (int gx = 0; gx < gw; gx++) {
+			const size_t k = (size_t) gy * gw + gx;
+			const float count = (float) (ny * _portrait_span(gx, r, gw));
+			const float mean = sums[0][k] / count, mean_in = sums[2][k] / count;
+			const float var = std::max(sums[1][k] / count - mean * mean, 0.0f);
+			a[k] = (sums[3][k] / count - mean * mean_in) / (var + eps);
+			b[k] = mean_in - a[k] * mean;
+		}
+	}
+
+	auto mean_a_img = dlib::sub_image(mean_a, gh, gw, gw);
+	auto mean_b_img = dlib::sub_image(mean_b, gh, gw, gw);
+	dlib::sum_filter_assign(dlib::sub_image(a, gh, gw, gw), mean_a_img, box);
+	dlib::sum_filter_assign(dlib::sub_image(b, gh, gw, gw), mean_b_img, box);
+
+	for (int gy = 0; gy < gh; gy++) {
+		const int ny = _portrait_span(gy, r, gh);
+		for (int gx = 0; gx < gw; gx++) {
+			const size_t k = (size_t) gy * gw + gx;
+			const float count = (float) (ny * _portrait_span(gx, r, gw));
+			mean_a[k] /= count;
+			mean_b[k] /= count;
+		}
+	}
+}
+
+/**
+ * @brief Dilates or erodes the mask by a 3x3 square.
+ * @details The pixels of every box are counted with a box sum: a pixel is
+ *          on after a dilation if any of them is, after an erosion if all of
+ *          them are. Past the proxy nothing counts either way.
+ */
+static void _portrait_morph(portrait* pt, dlib::array2d<unsigned char>& mask, bool dilate)
+{
+	const int gw = pt->width, gh = pt->height;
+	int* input = _portrait_buffer(pt->input, (size_t) gw * gh);
+	int* sums = _portrait_buffer(pt->sums[0], (size_t) gw * gh);
+
+	for (int gy = 0; gy < gh; gy++)
+		for (int gx = 0; gx < gw; gx++)
+			input[gy * gw + gx] = mask[gy][gx] != 0;
+	auto sums_img = dlib::sub_image(sums, gh, gw, gw);
+	dlib::sum_filter_assign(dlib::sub_image(input, gh, gw, gw), sums_img, dlib::rectangle(-1, -1, 1, 1));
+
+	for (int gy = 0; gy < gh; gy++) {
+		const int ny = _portrait_span(gy, 1, gh);
+		for (int gx = 0; gx < gw; gx++) {
+			const int count = dilate ? 1 : ny * _portrait_span(gx, 1, gw);
+			mask[gy][gx] = sums[gy * gw + gx] >= count ? 255 : 0;
+		}
+	}
+}
+
+/**
+ * @brief Box blurs a row of n samples, step bytes apart, for every one of
+ *        the step interleaved channels.
+ * @details A box of 2r + 1 samples is divided by multiplying its sum,
+ *          plus r to round, by 65536 / (2r + 1) and keeping the high 16
+ *          bits, as the columns do it eight at a time.
+ */
+static void _portrait_box_row(const unsigned char* src, unsigned char* dst, int n, int step, int r)
+{
+	const unsigned inv = 65536 / (2 * r + 1);
+
+	for (int c = 0; c < step; c++) {
+		const unsigned char* s = src + c;
+		unsigned char* d = dst + c;
+		/* the edge samples repeated past the ends, the middle of the row needs no clamping */
+		const int head = std::min(r, n), body = std::max(head, n - r - 1);
+		unsigned sum = s[0] * (r + 1) + r;
+		for (int i = 1; i <= r; i++)
+			sum += s[std::min(i, n - 1) * step];
+		int i = 0;
+		for (; i < head; i++) {
+			d[i * step] = (unsigned char) ((sum * inv) >> 16);
+			sum += s[std::min(i + r + 1, n - 1) * step] - s[0];
+		}
+		for (; i < body; i++) {
+			d[i * step] = (unsigned char) ((sum * inv) >> 16);
+			sum += s[(i + r + 1) * step] - s[(i - r) * step];
+		}
+		for (; i < n; i++) {
+			d[i * step] = (unsigned char) ((sum * inv) >> 16);
+			sum += s[(n - 1) * step] - s[std::max(i - r, 0) * step];
+		}
+	}
+}
+
+/**
+ * @brief Box blurs the rows [top, bottom) of a plane down its columns.
+ * @details Every column keeps a running sum of its box, plus r to round,
+ *          which 16 bits hold for radii up to 127.
+ *
+ * @param src     The plane
+ * @param dst     The blurred plane, another one
+ * @param width   The bytes of a row
+ * @param height  The rows of the plane
+ * @param top     The first row blurred
+ * @param bottom  One past the last one
+ * @param r       The box radius
+ * @param sums    Room for the width running sums
+ */
+static void _portrait_box_cols(const unsigned char* src, unsigned char* dst, int width, int height,
+		int top, int bottom, int r, unsigned short* sums)
+{
+	const unsigned short inv = (unsigned short) (65536 / (2 * r + 1));
+
+	for (int x = 0; x < width; x++)
+		sums[x] = (unsigned short) r;
+	for (int j = top - r; j <= top + r; j++) {
+		const unsigned char* row = src + (size_t) std::max(0, std::min(j, height - 1)) * width;
+		for (int x = 0; x < width; x++)
+			sums[x] += row[x];
+	}
+
+	for (int j = top; j < bottom; j++) {
+		const unsigned char* in = src + (size_t) std::min(j + r + 1, height - 1) * width;
+		const unsigned char* out = src + (size_t) std::max(j - r, 0) * width;
+		unsigned char* d = dst + (size_t) j * width;
+		int x = 0;
+
+#if defined(DLIB_HAVE_NEON)
+		const uint16x4_t vinv = vdup_n_u16(inv);
+		for (; x + 8 <= width; x += 8) {
+			uint16x8_t sum = vld1q_u16(sums + x);
+			const uint16x4_t lo = vshrn_n_u32(vmull_u16(vget_low_u16(sum), vinv), 16);
+			const uint16x4_t hi = vshrn_n_u32(vmull_u16(vget_high_u16(sum), vinv), 16);
+			vst1_u8(d + x, vmovn_u16(vcombine_u16(lo, hi)));
+			sum = vsubq_u16(vaddq_u16(sum, vmovl_u8(vld1_u8(in + x))), vmovl_u8(vld1_u8(out + x)));
+			vst1q_u16(sums + x, sum);
+		}
+#elif defined(DLIB_HAVE_SSE2)
+		const __m128i zero = _mm_setzero_si128(), vinv = _mm_set1_epi16((short) inv);
+		for (; x + 8 <= width; x += 8) {
+			__m128i sum = _mm_loadu_si128((const __m128i*) (sums + x));
+			const __m128i q = _mm_mulhi_epu16(sum, vinv);
+			_mm_storel_epi64((__m128i*) (d + x), _mm_packus_epi16(q, q));
+			sum = _mm_add_epi16(sum, _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (in + x)), zero));
+			sum = _mm_sub_epi16(sum, _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (out + x)), zero));
+			_mm_storeu_si128((__m128i*) (sums + x), sum);
+		}
+#endif
+
+		for (; x < width; x++) {
+			d[x] = (unsigned char) ((sums[x] * inv) >> 16);
+			sums[x] += in[x] - out[x];
+		}
+	}
+}
+
+/* the coefficients of proxy row g interpolated at every frame column */
+static void _portrait_line(const float* coef, int gw, int g, const int* cols, float* line, int width)
+{
+	const float* row = coef + g * gw;
+	for (int x = 0; x < width; x++) {
+		const int c = cols[x] >> 9;
+		const float wx = (cols[x] & 511) / 256.0f;
+		line[x] = row[c] + (row[c + 1] - row[c]) * wx;
+	}
+}
+
+/* blends the frame over the background by alpha, with the exact division by 255 */
+static inline unsigned char _portrait_blend(int frame, int background, int alpha)
+{
+	const unsigned t = frame * alpha + background * (255 - alpha) + 128;
+	return (unsigned char) ((t + (t >> 8)) >> 8);
+}
+
+#if defined(DLIB_HAVE_NEON)
+/* 16 samples of the frame over 16 of the background, by 16 alphas */
+static inline uint8x16_t _portrait_blend16(uint8x16_t frame, uint8x16_t background, uint8x16_t alpha)
+{
+	const uint8x16_t beta = vmvnq_u8(alpha);
+	uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(frame), vget_low_u8(alpha)),
+			vget_low_u8(background), vget_low_u8(beta));
+	uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(frame), vget_high_u8(alpha)),
+			vget_high_u8(background), vget_high_u8(beta));
+	lo = vaddq_u16(lo, vdupq_n_u16(128));
+	hi = vaddq_u16(hi, vdupq_n_u16(128));
+	return vcombine_u8(vshrn_n_u16(vsraq_n_u16(lo, lo, 8), 8), vshrn_n_u16(vsraq_n_u16(hi, hi, 8), 8));
+}
+
+/* the alpha of 4 pixels of luma l, as 4 ints */
+static inline int32x4_t _portrait_alpha4(const float* a0, const float* a1, const float* b0, const float* b1,
+		float32x4_t wy, uint32x4_t l)
+{
+	const float32x4_t av = vld1q_f32(a0), bv = vld1q_f32(b0);
+	const float32x4_t a = vmlaq_f32(av, vsubq_f32(vld1q_f32(a1), av), wy);
+	const float32x4_t b = vmlaq_f32(bv, vsubq_f32(vld1q_f32(b1), bv), wy);
+	/* rounded to the nearest, the conversion truncates */
+	return vcvtq_s32_f32(vaddq_f32(vmlaq_f32(b, a, vcvtq_f32_u32(l)), vdupq_n_f32(0.5f)));
+}
+#elif defined(DLIB_HAVE_SSE2)
+static inline __m128i _portrait_blend16(__m128i frame, __m128i background, __m128i alpha)
+{
+	const __m128i zero = _mm_setzero_si128(), round = _mm_set1_epi16(128);
+	const __m128i beta = _mm_xor_si128(alpha, _mm_set1_epi8((char) 0xff));
+	__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(frame, zero), _mm_unpacklo_epi8(alpha, zero)),
+			_mm_mullo_epi16(_mm_unpacklo_epi8(background, zero), _mm_unpacklo_epi8(beta, zero)));
+	__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(frame, zero), _mm_unpackhi_epi8(alpha, zero)),
+			_mm_mullo_epi16(_mm_unpackhi_epi8(background, zero), _mm_unpackhi_epi8(beta, zero)));
+	lo = _mm_add_epi16(lo, round);
+	hi = _mm_add_epi16(hi, round);
+	lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+	hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+	return _mm_packus_epi16(lo, hi);
+}
+
+static inline __m128i _portrait_alpha4(const float* a0, const float* a1, const float* b0, const float* b1,
+		__m128 wy, __m128i l)
+{
+	const __m128 av = _mm_loadu_ps(a0), bv = _mm_loadu_ps(b0);
+	const __m128 a = _mm_add_ps(av, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(a1), av), wy));
+	const __m128 b = _mm_add_ps(bv, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b1), bv), wy));
+	/* rounded to the nearest by the conversion */
+	return _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(a, _mm_cvtepi32_ps(l)), b));
+}
+#endif
+
+/**
+ * @brief Blends a row of luma over the background.
+ * @details The coefficients of the two lines are blended by wy and
+ *          applied to the luma, which gives the alpha of every pixel, 0
+ *          on the background and 255 on the people.
+ *
+ * @param lines_a     The coefficients a of the proxy rows above and below
+ * @param lines_b     The coefficients b
+ * @param wy          The weight of the row below
+ * @param dst         The row of the frame
+ * @param background  The row of the background
+ * @param alpha       Receives the alpha of every pixel
+ * @param width       The pixels of the row
+ */
+static void _portrait_luma_row(const float* const* lines_a, const float* const* lines_b, float wy,
+		unsigned char* dst, const unsigned char* background, unsigned char* alpha, int width)
+{
+	const float* a0 = lines_a[0];
+	const float* a1 = lines_a[1];
+	const float* b0 = lines_b[0];
+	const float* b1 = lines_b[1];
+	int x = 0;
+
+#if defined(DLIB_HAVE_NEON)
+	const float32x4_t vwy = vdupq_n_f32(wy);
+	for (; x + 16 <= width; x += 16) {
+		const uint8x16_t luma = vld1q_u8(dst + x);
+		const uint16x8_t lo = vmovl_u8(vget_low_u8(luma)), hi = vmovl_u8(vget_high_u8(luma));
+		const uint32x4_t l[4] = { vmovl_u16(vget_low_u16(lo)), vmovl_u16(vget_high_u16(lo)),
+				vmovl_u16(vget_low_u16(hi)), vmovl_u16(vget_high_u16(hi)) };
+		int32x4_t t[4];
+		for (int i = 0; i < 4; i++)
+			t[i] = _portrait_alpha4(a0 + x + 4 * i, a1 + x + 4 * i, b0 + x + 4 * i, b1 + x + 4 * i, vwy, l[i]);
+		/* saturated down to 0..255 */
+		const uint8x16_t al = vcombine_u8(vqmovun_s16(vcombine_s16(vqmovn_s32(t[0]), vqmovn_s32(t[1]))),
+				vqmovun_s16(vcombine_s16(vqmovn_s32(t[2]), vqmovn_s32(t[3]))));
+		vst1q_u8(alpha + x, al);
+		vst1q_u8(dst + x, _portrait_blend16(luma, vld1q_u8(background + x), al));
+	}
+#elif defined(DLIB_HAVE_SSE2)
+	const __m128 vwy = _mm_set1_ps(wy);
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 16 <= width; x += 16) {
+		const __m128i luma = _mm_loadu_si128((const __m128i*) (dst + x));
+		const __m128i lo = _mm_unpacklo_epi8(luma, zero), hi = _mm_unpackhi_epi8(luma, zero);
+		const __m128i l[4] = { _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+				_mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero) };
+		__m128i t[4];
+		for (int i = 0; i < 4; i++)
+			t[i] = _portrait_alpha4(a0 + x + 4 * i, a1 + x + 4 * i, b0 + x + 4 * i, b1 + x + 4 * i, vwy, l[i]);
+		/* saturated down to 0..255 */
+		const __m128i al = _mm_packus_epi16(_mm_packs_epi32(t[0], t[1]), _mm_packs_epi32(t[2], t[3]));
+		_mm_storeu_si128((__m128i*) (alpha + x), al);
+		_mm_storeu_si128((__m128i*) (dst + x), _portrait_blend16(luma,
+				_mm_loadu_si128((const __m128i*) (background + x)), al));
+	}
+#endif
+
+	for (; x < width; x++) {
+		const float a = a0[x] + (a1[x] - a0[x]) * wy, b = b0[x] + (b1[x] - b0[x]) * wy;
+		const int t = std::max(0, std::min((int) lrintf(a * dst[x] + b), 255));
+		alpha[x] = (unsigned char) t;
+		dst[x] = _portrait_blend(dst[x], background[x], t);
+	}
+}
+
+/**
+ * @brief Blends a row of Cb Cr pairs over the background, every pair by
+ *        the alpha of the first luma pixel of its block.
+ */
+static void _portrait_chroma_row(const unsigned char* alpha, unsigned char* dst, const unsigned char* background,
+		int width)
+{
+	int x = 0;
+
+#if defined(DLIB_HAVE_NEON)
+	for (; x + 16 <= width; x += 16) {
+		const uint8x16_t al = vld1q_u8(alpha + x);
+		/* the even alphas, twice each */
+		const uint8x16_t pairs = vtrnq_u8(al, al).val[0];
+		vst1q_u8(dst + x, _portrait_blend16(vld1q_u8(dst + x), vld1q_u8(background + x), pairs));
+	}
+#elif defined(DLIB_HAVE_SSE2)
+	for (; x + 16 <= width; x += 16) {
+		const __m128i even = _mm_and_si128(_mm_loadu_si128((const __m128i*) (alpha + x)), _mm_set1_epi16(0xff));
+		const __m128i pairs = _mm_or_si128(even, _mm_slli_epi16(even, 8));
+		_mm_storeu_si128((__m128i*) (dst + x), _portrait_blend16(_mm_loadu_si128((const __m128i*) (dst + x)),
+				_mm_loadu_si128((const __m128i*) (background + x)), pairs));
+	}
+#endif
+
+	for (; x < width; x += 2) {
+		dst[x] = _portrait_blend(dst[x], background[x], alpha[x]);
+		dst[x + 1] = _portrait_blend(dst[x + 1], background[x + 1], alpha[x]);
+	}
+}
+
+/**
+ * @brief Blurs the frame behind the people added since portrait_begin(), in place.
+ * @details Nothing happens if nobody was added.
+ *
+ * @param pt      The effect
+ * @param y       The luma plane
+ * @param uv      The interleaved chroma plane
+ * @param width   The frame width, a multiple of 4
+ * @param height  The frame height, a multiple of 4
+ * @param pool    Blurs and blends strips of rows on its threads, NULL to do them in turn
+ */
+void portrait_apply(portrait* pt, unsigned char* y, unsigned char* uv, int width, int height,
+		dlib::thread_pool* pool)
+{
+	if (pt->figures == 0)
+		return;
+
+	const int gw = pt->width, gh = pt->height;
+
+	/* the guess snapped to the edges of the proxy, without its specks and holes */
+	for (int pass = 0; pass < PORTRAIT_SNAP_PASSES; pass++) {
+		/* every pass moves the borders by up to a box radius */
+		_portrait_guided(pt, pt->seed, PORTRAIT_SNAP_RADIUS, PORTRAIT_SNAP_EPS);
+		for (int gy = 0; gy < gh; gy++)
+			for (int gx = 0; gx < gw; gx++) {
+				const size_t k = (size_t) gy * gw + gx;
+				pt->seed[gy][gx] = pt->mean_a[k] * pt->guide[k] + pt->mean_b[k] >= 127.5f ? 255 : 0;
+			}
+	}
+	_portrait_morph(pt, pt->seed, false);
+	_portrait_morph(pt, pt->seed, true);
+	for (int i = 0; i < 2; i++)
+		_portrait_morph(pt, pt->seed, true);
+	for (int i = 0; i < 2; i++)
+		_portrait_morph(pt, pt->seed, false);
+
+	/* and feathered: the coefficients are applied at the full resolution */
+	_portrait_guided(pt, pt->seed, PORTRAIT_FEATHER_RADIUS, PORTRAIT_FEATHER_EPS);
+	const float* coef_a = &pt->mean_a[0];
+	const float* coef_b = &pt->mean_b[0];
+	int* cols = &pt->cols[0];
+	for (int x = 0; x < width; x++)
+		cols[x] = _portrait_position(x, gw);
+
+	/* the frame at half size, every strip with its own sums and coefficient rows */
+	const int sw = width / 2, sh = height / 2;
+	unsigned char* small_y = _portrait_buffer(pt->small, (size_t) sw * sh * 3 / 2);
+	unsigned char* small_uv = small_y + (size_t) sw * sh;
+	unsigned char* temp_y = _portrait_buffer(pt->temp, (size_t) sw * sh * 3 / 2);
+	unsigned char* temp_uv = temp_y + (size_t) sw * sh;
+	unsigned char* back_y = _portrait_buffer(pt->background, (size_t) width * height * 3 / 2);
+	unsigned char* back_uv = back_y + (size_t) width * height;
+
+	int strips = 1;
+	if (pool != NULL && pool->num_threads_in_pool() > 1)
+		strips = std::min((int) pool->num_threads_in_pool() * PORTRAIT_STRIPS_PER_THREAD, PORTRAIT_MAX_STRIPS);
+	unsigned short* sums_scratch = _portrait_buffer(pt->sums_scratch, (size_t) strips * sw);
+	float* lines = _portrait_buffer(pt->lines, (size_t) strips * 4 * width);
+	unsigned char* alphas = _portrait_buffer(pt->alphas, (size_t) strips * 2 * width);
+	auto run = [&](const std::function<void(long)>& strip) {
+		if (strips > 1)
+			dlib::parallel_for(*pool, 0, strips, strip);
+		else
+			strip(0);
+	};
+
+	nv12_resample(&pt->down, y, uv, width, height, width, small_y, small_uv, sw, sh);
+	for (int pass = 0; pass < PORTRAIT_BLUR_PASSES; pass++) {
+		run([&](long k) {
+			for (int j = sh * k / strips; j < sh * (k + 1) / strips; j++)
+				_portrait_box_row(small_y + (size_t) j * sw, temp_y + (size_t) j * sw, sw, 1, PORTRAIT_BLUR_RADIUS);
+			for (int j = sh / 2 * k / strips; j < sh / 2 * (k + 1) / strips; j++)
+				_portrait_box_row(small_uv + (size_t) j * sw, temp_uv + (size_t) j * sw, sw / 2, 2,
+						PORTRAIT_BLUR_RADIUS);
+		});
+		run([&](long k) {
+			unsigned short* sums = sums_scratch + k * sw;
+			_portrait_box_cols(temp_y, small_y, sw, sh, sh * k / strips, sh * (k + 1) / strips,
+					PORTRAIT_BLUR_RADIUS, sums);
+			_portrait_box_cols(temp_uv, small_uv, sw, sh / 2, sh / 2 * k / strips, sh / 2 * (k + 1) / strips,
+					PORTRAIT_BLUR_RADIUS, sums);
+		});
+	}
+	nv12_resample(&pt->up, small_y, small_uv, sw, sh, sw, back_y, back_uv, width, height);
+
+	/* the people over the background, two rows of luma and one of chroma at a time */
+	run([&](long k) {
+		float* lines_a[2] = { lines + k * 4 * width, lines + (k * 4 + 1) * width };
+		float* lines_b[2] = { lines + (k * 4 + 2) * width, lines + (k * 4 + 3) * width };
+		unsigned char* alpha[2] = { alphas + k * 2 * width, alphas + (k * 2 + 1) * width };
+		int held[2] = { -1, -1 }; /* the proxy row every line holds */
+
+		for (int cj = height / 2 * k / strips; cj < height / 2 * (k + 1) / strips; cj++) {
+			for (int i = 0; i < 2; i++) {
+				const int j = 2 * cj + i;
+				const int v = _portrait_position(j, gh), g = v >> 9;
+				if (held[0] != g && held[1] == g) {
+					std::swap(lines_a[0], lines_a[1]);
+					std::swap(lines_b[0], lines_b[1]);
+					std::swap(held[0], held[1]);
+				}
+				for (int l = 0; l < 2; l++) {
+					if (held[l] == g + l)
+						continue;
+					_portrait_line(coef_a, gw, g + l, cols, lines_a[l], width);
+					_portrait_line(coef_b, gw, g + l, cols, lines_b[l], width);
+					held[l] = g + l;
+				}
+
+				unsigned char* dst = y + (size_t) j * width;
+				const unsigned char* back = back_y + (size_t) j * width;
+				_portrait_luma_row(lines_a, lines_b, (v & 511) / 256.0f, dst, back, alpha[i], width);
+			}
+			_portrait_chroma_row(alpha[0], uv + (size_t) cj * width, back_uv + (size_t) cj * width, width);
+		}
+	});
+}
@@ -0,0 +1,179 @@
+/*
+ * skin_smooth.cpp
+ *
+ *  The guided filter of He, Sun and Tang, in its fast form: with I the
+ *  guide, every box gives a = var(I) / (var(I) + eps) and
+ *  b = mean(I) * (1 - a), and every pixel becomes mean(a) * I + mean(b),
+ *  the means taken over the boxes that hold it. The boxes are summed with
+ *  dlib's sum_filter, which keeps running column sums, so the cost does
+ *  not depend on the radius. a and b only vary as fast as the boxes do,
+ *  so they are computed on a guide subsampled SKIN_SUBSAMPLE times and
+ *  interpolated back. Only the last step, one multiply and add per pixel,
+ *  runs at the full resolution.
+ */
+
+#include "skin_smooth.h"
+
+#include <algorithm>
+#include <cmath>
+#include <dlib/image_transforms.h>
+
+template <typename T>
+static T* _skin_buffer(std::vector<T>& v, size_t n)
+{
+	if (v.size() < n)
+		v.resize(n);
+	return &v[0];
+}
+
+/* number of guide samples in the box of radius r around i, on a side of n */
+static inline int _skin_span(int i, int r, int n)
+{
+	return std::min(i + r, n - 1) - std::max(i - r, 0) + 1;
+}
+
+/* maps the frame columns or rows [first, last) onto the guide, in 1/256 of a sample */
+static void _skin_positions(int* pos, int first, int last, int origin, int n)
+{
+	for (int i = first; i < last; i++) {
+		/* the center of guide sample g is at origin + g * s + (s - 1) / 2 */
+		int p = ((i - origin) * 2 + 1) * 128 / SKIN_SUBSAMPLE - 128;
+		p = std::max(0, std::min(p, (n - 1) * 256));
+		pos[i - first] = p;
+	}
+}
+
+/**
+ * @brief Smooths the skin of one face, in place.
+ *
+ * @param ss      Buffers of the filter, kept from face to face and frame to frame
+ * @param y       The luma plane of the frame
+ * @param width   The frame width
+ * @param height  The frame height
+ * @param fm      The mask of the face, see face_mask_build()
+ * @param radius  The box radius, in frame pixels
+ * @param eps     The variance under which details are smoothed away, in luma
+ *                levels squared
+ */
+void skin_smooth_face(skinsmooth* ss, unsigned char* y, int width, int height,
+		const facemask* fm, int radius, int eps)
+{
+	if (fm->width == 0 || fm->height == 0)
+		return;
+
+	const int s = SKIN_SUBSAMPLE;
+	/* the guide covers the mask and every box around it */
+	const int x0 = std::max(fm->left - radius, 0);
+	const int y0 = std::max(fm->top - radius, 0);
+	const int x1 = std::min(fm->left + fm->width + radius, width);
+	const int y1 = std::min(fm->top + fm->height + radius, height);
+	const int gw = (x1 - x0 + s - 1) / s;
+	const int gh = (y1 - y0 + s - 1) / s;
+	const int r = std::max(1, (radius + s / 2) / s);
+	const size_t n = (size_t) gw * gh;
+
+	int* guide = _skin_buffer(ss->guide, n);
+	int* squares = _skin_buffer(ss->squares, n);
+	int* sums = _skin_buffer(ss->sums, n);
+	int* square_sums = _skin_buffer(ss->square_sums, n);
+	float* a = _skin_buffer(ss->a, n);
+	float* b = _skin_buffer(ss->b, n);
+	float* mean_a = _skin_buffer(ss->mean_a, n);
+	float* mean_b = _skin_buffer(ss->mean_b, n);
+	int* coef_a = _skin_buffer(ss->coef_a, n);
+	int* coef_b = _skin_buffer(ss->coef_b, n);
+
+	/* the guide: means of s x s blocks, the last ones clamped to the frame */
+	int* cols = _skin_buffer(ss->cols, std::max(gw * s, fm->width));
+	for (int gy = 0; gy < gh; gy++) {
+		/* the block rows summed down first */
+		for (int i = 0; i < gw * s; i++)
+			cols[i] = 0;
+		for (int j = 0; j < s; j++) {
+			const unsigned char* row = y + (size_t) std::min(y0 + gy * s + j, y1 - 1) * width + x0;
+			const int span = x1 - x0;
+			for (int i = 0; i < span; i++)
+				cols[i] += row[i];
+			for (int i = span; i < gw * s; i++)
+				cols[i] += row[span - 1];
+		}
+		for (int gx = 0; gx < gw; gx++) {
+			int sum = 0;
+			for (int i = 0; i < s; i++)
+				sum += cols[gx * s + i];
+			const int v = (sum + s * s / 2) / (s * s);
+			guide[gy * gw + gx] = v;
+			squares[gy * gw + gx] = v * v;
+		}
+	}
+
+	/* the buffers are viewed as images, nothing is allocated for them */
+	const dlib::rectangle box(-r, -r, r, r);
+	auto sums_img = dlib::sub_image(sums, gh, gw, gw);
+	auto square_sums_img = dlib::sub_image(square_sums, gh, gw, gw);
+	dlib::sum_filter_assign(dlib::sub_image(guide, gh, gw, gw), sums_img, box);
+	dlib::sum_filter_assign(dlib::sub_image(squares, gh, gw, gw), square_sums_img, box);
+
+	for (int gy = 0; gy < gh; gy++) {
+		const int ny = _skin_span(gy, r, gh);
+		for (int gx = 0; gx < gw; gx++) {
+			const int k = gy * gw + gx;
+			const float count = (float) (ny * _skin_span(gx, r, gw));
+			const float mean = sums[k] / count;
+			const float var = std::max(square_sums[k] / count - mean * mean, 0.0f);
+			a[k] = var / (var + eps);
+			b[k] = mean * (1.0f - a[k]);
+		}
+	}
+
+	auto mean_a_img = dlib::sub_image(mean_a, gh, gw, gw);
+	auto mean_b_img = dlib::sub_image(mean_b, gh, gw, gw);
+	dlib::sum_filter_assign(dlib::sub_image(a, gh, gw, gw), mean_a_img, box);
+	dlib::sum_filter_assign(dlib::sub_image(b, gh, gw, gw), mean_b_img, box);
+
+	for (int gy = 0; gy < gh; gy++) {
+		const int ny = _skin_span(gy, r, gh);
+		for (int gx = 0; gx < gw; gx++) {
+			const int k = gy * gw + gx;
+			const float count = (float) (ny * _skin_span(gx, r, gw));
+			coef_a[k] = (int) lrintf(mean_a[k] / count * 4096.0f);
+			coef_b[k] = (int) lrintf(mean_b[k] / count * 16.0f);
+		}
+	}
+
+	/* back to the frame, under the mask only */
+	int* row_a = _skin_buffer(ss->row_a, gw);
+	int* row_b = _skin_buffer(ss->row_b, gw);
+	int* line_a = _skin_buffer(ss->line_a, fm->width);
+	int* line_b = _skin_buffer(ss->line_b, fm->width);
+	_skin_positions(cols, fm->left, fm->left + fm->width, x0, gw);
+
+	for (int my = 0; my < fm->height; my++) {
+		int v;
+		_skin_positions(&v, fm->top + my, fm->top + my + 1, y0, gh);
+		const int g0 = v >> 8, g1 = std::min(g0 + 1, gh - 1), wy = v & 255;
+		for (int gx = 0; gx < gw; gx++) {
+			row_a[gx] = (coef_a[g0 * gw + gx] * (256 - wy) + coef_a[g1 * gw + gx] * wy + 128) >> 8;
+			row_b[gx] = (coef_b[g0 * gw + gx] * (256 - wy) + coef_b[g1 * gw + gx] * wy + 128) >> 8;
+		}
+
+		/* the coefficients of every column, then the pixels, both loops free of branches */
+		for (int mx = 0; mx < fm->width; mx++) {
+			const int u = cols[mx];
+			const int c0 = u >> 8, c1 = std::min(c0 + 1, gw - 1), wx = u & 255;
+			line_a[mx] = (row_a[c0] * (256 - wx) + row_a[c1] * wx + 128) >> 8;
+			line_b[mx] = (row_b[c0] * (256 - wx) + row_b[c1] * wx + 128) >> 8;
+		}
+
+		const unsigned char* cover = &fm->y[(size_t) my * fm->width];
+		unsigned char* dst = y + (size_t) (fm->top + my) * width + fm->left;
+		for (int mx = 0; mx < fm->width; mx++) {
+			const int c = cover[mx];
+			const int q = std::max(0, std::min((line_a[mx] * dst[mx] + (line_b[mx] << 8) + 2048) >> 12, 255));
+			/* blended by the coverage with the exact division by 255, which keeps
+			 * uncovered pixels exactly as they are */
+			const unsigned t = dst[mx] * (255 - c) + q * c + 128;
+			dst[mx] = (t + (t >> 8)) >> 8;
+		}
+	}
+}
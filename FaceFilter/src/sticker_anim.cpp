@@ -0,0 +1,79 @@
+/*
+ * sticker_anim.cpp
+ *
+ *  The frames play forth and back (0 1 2 3 2 1 0 ...), so a sequence that
+ *  grows or shrinks never jumps from its last frame to its first one. The
+ *  frame is computed from a monotonic clock rather than counted per camera
+ *  frame, so the speed does not depend on the preview rate.
+ */
+
+#include "sticker_anim.h"
+
+#include <cstdio>
+#include <time.h>
+
+/**
+ * @brief Finds the frames of a sequence in the atlas.
+ * @details A sticker called name is a sequence of one frame. Otherwise the
+ *          frames are name0, name1, ... up to the first missing one.
+ *
+ * @param atlas  The decoded stickers
+ * @param name   The name of the sequence
+ * @param anim   Receives the sequence
+ *
+ * @return @c true if the sequence has a layout and at least one frame
+ */
+bool sticker_anim_load(const stickeratlas* atlas, const char* name, stickeranim* anim)
+{
+	anim->layout = sticker_atlas_find_layout(atlas, name);
+	if (anim->layout == NULL)
+		anim->layout = sticker_layout_find(name);
+	anim->count = 0;
+
+	const sticker* st = sticker_atlas_find(atlas, name);
+	if (st != NULL) {
+		anim->frames[anim->count++] = st;
+	} else {
+		char frame[64];
+		while (anim->count < ANIM_MAX_FRAMES) {
+			snprintf(frame, sizeof(frame), "%s%d", name, anim->count);
+			st = sticker_atlas_find(atlas, frame);
+			if (st == NULL)
+				break;
+			anim->frames[anim->count++] = st;
+		}
+	}
+
+	if (anim->layout == NULL)
+		anim->count = 0;
+	return anim->count > 0;
+}
+
+/**
+ * @brief Returns the time of the monotonic clock, in milliseconds.
+ */
+unsigned long long sticker_anim_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Returns the frame of the animation a face shows at the given time.
+ *
+ * @param anim  The animation, with at least one frame
+ * @param id    The id of the face track, which sets the phase of the face
+ * @param now   The time, as given by sticker_anim_clock()
+ *
+ * @return The frame to draw
+ */
+const sticker* sticker_anim_frame(const stickeranim* anim, unsigned long id, unsigned long long now)
+{
+	if (anim->count == 1)
+		return anim->frames[0];
+
+	const unsigned long period = 2 * (anim->count - 1);
+	const unsigned long k = (now / ANIM_FRAME_MS + id * ANIM_FACE_STAGGER) % period;
+	return anim->frames[k < (unsigned long) anim->count ? k : period - k];
+}
@@ -0,0 +1,245 @@
+/*
+ * sticker_atlas.cpp
+ *
+ *  Stickers are premultiplied once when they are decoded. Averaging and
+ *  interpolating premultiplied pixels does not bleed the color of the
+ *  see-through parts into the edges, so the mips can be built with a plain
+ *  2x2 box filter and sampled with a plain bilinear filter.
+ */
+
+#include "sticker_atlas.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <dlib/threads.h>
+
+static void _sticker_premultiply(dlib::array2d<dlib::rgb_alpha_pixel>& img)
+{
+	for (long r = 0; r < img.nr(); r++) {
+		dlib::rgb_alpha_pixel* row = &img[r][0];
+		for (long c = 0; c < img.nc(); c++) {
+			const unsigned a = row[c].alpha;
+			row[c].red = (row[c].red * a + 127) / 255;
+			row[c].green = (row[c].green * a + 127) / 255;
+			row[c].blue = (row[c].blue * a + 127) / 255;
+		}
+	}
+}
+
+/**
+ * @brief Copies the decoded image into the sticker and builds its mip chain.
+ * @details Every level lives in one block. Each level is the previous one
+ *          halved, until it would get smaller than STICKER_MIN_MIP.
+ */
+static void _sticker_build_mips(sticker* st, const dlib::array2d<dlib::rgb_alpha_pixel>& img)
+{
+	stickermip mip = { img.nr(), img.nc(), NULL };
+	std::vector<size_t> offsets;
+	size_t total = 0;
+
+	st->mips.clear();
+	while (true) {
+		st->mips.push_back(mip);
+		offsets.push_back(total);
+		total += mip.rows * mip.cols;
+		if (mip.rows / 2 < STICKER_MIN_MIP || mip.cols / 2 < STICKER_MIN_MIP)
+			break;
+		mip.rows /= 2;
+		mip.cols /= 2;
+	}
+
+	st->pixels.resize(total);
+	for (size_t i = 0; i < st->mips.size(); i++)
+		st->mips[i].pixels = &st->pixels[offsets[i]];
+	memcpy(&st->pixels[0], &img[0][0], img.size() * sizeof(dlib::rgb_alpha_pixel));
+
+	for (size_t i = 1; i < st->mips.size(); i++) {
+		const stickermip& src = st->mips[i - 1];
+		const stickermip& dst = st->mips[i];
+		dlib::rgb_alpha_pixel* out = &st->pixels[offsets[i]];
+
+		for (long r = 0; r < dst.rows; r++, out += dst.cols) {
+			const dlib::rgb_alpha_pixel* r0 = src.pixels + 2 * r * src.cols;
+			const dlib::rgb_alpha_pixel* r1 = r0 + src.cols;
+			for (long c = 0; c < dst.cols; c++) {
+				const dlib::rgb_alpha_pixel& a = r0[2 * c];
+				const dlib::rgb_alpha_pixel& b = r0[2 * c + 1];
+				const dlib::rgb_alpha_pixel& d = r1[2 * c];
+				const dlib::rgb_alpha_pixel& e = r1[2 * c + 1];
+				out[c].red = (a.red + b.red + d.red + e.red + 2) >> 2;
+				out[c].green = (a.green + b.green + d.green + e.green + 2) >> 2;
+				out[c].blue = (a.blue + b.blue + d.blue + e.blue + 2) >> 2;
+				out[c].alpha = (a.alpha + b.alpha + d.alpha + e.alpha + 2) >> 2;
+			}
+		}
+	}
+}
+
+static std::string _sticker_name(const std::string& path)
+{
+	size_t begin = path.find_last_of('/');
+	begin = begin == std::string::npos ? 0 : begin + 1;
+	size_t end = path.find_last_of('.');
+	if (end == std::string::npos || end < begin)
+		end = path.size();
+	return path.substr(begin, end - begin);
+}
+
+/**
+ * @brief Decodes the given files in parallel and adds them to the atlas.
+ *
+ * @param atlas        The atlas to fill
+ * @param paths        The files to load
+ * @param decode       Decodes one file. It is called from several threads at once.
+ * @param num_threads  The number of decoding threads
+ *
+ * @return The number of stickers added. Files that fail to decode are skipped.
+ */
+unsigned long sticker_atlas_load(stickeratlas* atlas, const std::vector<std::string>& paths,
+		sticker_decode_fn decode, unsigned long num_threads)
+{
+	std::vector<sticker> loaded(paths.size());
+	std::vector<char> ok(paths.size(), 0);
+
+	dlib::parallel_for(std::max(num_threads, 1UL), 0, paths.size(), [&](long i) {
+		sticker& st = loaded[i];
+		dlib::array2d<dlib::rgb_alpha_pixel> img;
+		if (!decode(paths[i].c_str(), img) || img.size() == 0)
+			return;
+
+		_sticker_premultiply(img);
+		_sticker_build_mips(&st, img);
+		/* blended as is, without warping, so it keeps the stored orientation */
+		nv12_sticker_build(st.mips[0].pixels, st.mips[0].rows, st.mips[0].cols, false, &st.nv12);
+		st.name = _sticker_name(paths[i]);
+		ok[i] = 1;
+	}, 1);
+
+	unsigned long count = 0;
+	for (size_t i = 0; i < loaded.size(); i++) {
+		if (ok[i]) {
+			atlas->stickers.push_back(std::move(loaded[i]));
+			count++;
+		}
+	}
+	return count;
+}
+
+/**
+ * @brief Drops every sticker and unmaps the packages they came from.
+ */
+void sticker_atlas_release(stickeratlas* atlas)
+{
+	atlas->stickers.clear();
+	atlas->layouts.clear();
+	for (size_t i = 0; i < atlas->mappings.size(); i++)
+		munmap(atlas->mappings[i].first, atlas->mappings[i].second);
+	atlas->mappings.clear();
+}
+
+/**
+ * @brief Returns the sticker loaded from the file with the given name, or NULL.
+ */
+const sticker* sticker_atlas_find(const stickeratlas* atlas, const char* name)
+{
+	for (size_t i = 0; i < atlas->stickers.size(); i++) {
+		if (atlas->stickers[i].name == name)
+			return &atlas->stickers[i];
+	}
+	return NULL;
+}
+
+/**
+ * @brief Returns the anchors that came with the given sticker or sequence, or NULL.
+ */
+const stickerlayout* sticker_atlas_find_layout(const stickeratlas* atlas, const char* name)
+{
+	for (size_t i = 0; i < atlas->layouts.size(); i++) {
+		if (strcmp(atlas->layouts[i].name, name) == 0)
+			return &atlas->layouts[i];
+	}
+	return NULL;
+}
+
+/**
+ * @brief Maps every output column (or row) to its two source neighbours.
+ * @details Positions are sampled at pixel centers in 16.16 fixed point, and
+ *          the weight of the second neighbour is kept to 8 bits.
+ */
+static void _sticker_coords(long src, long dst, std::vector<int>& i0,
+		std::vector<int>& i1, std::vector<unsigned>& w)
+{
+	i0.resize(dst);
+	i1.resize(dst);
+	w.resize(dst);
+
+	const long step = (src << 16) / dst;
+	const long last = (src - 1) << 16;
+	long pos = step / 2 - 0x8000;
+	for (long i = 0; i < dst; i++, pos += step) {
+		const long p = std::max(0L, std::min(pos, last));
+		i0[i] = p >> 16;
+		i1[i] = std::min(i0[i] + 1, (int) src - 1);
+		w[i] = (p >> 8) & 0xff;
+	}
+}
+
+/**
+ * @brief Produces the sticker at the given size.
+ * @details The smallest mip level that is still at least as large as the
+ *          request is resampled, so the bilinear filter never shrinks by
+ *          more than 2 and does not alias.
+ *
+ * @param st    The sticker
+ * @param rows  The height wanted
+ * @param cols  The width wanted
+ * @param out   Receives the premultiplied sticker
+ */
+void sticker_atlas_scale(const sticker* st, long rows, long cols,
+		dlib::array2d<dlib::rgb_alpha_pixel>& out)
+{
+	if (rows <= 0 || cols <= 0 || st->mips.empty()) {
+		out.clear();
+		return;
+	}
+
+	size_t level = 0;
+	while (level + 1 < st->mips.size() && st->mips[level + 1].rows >= rows
+			&& st->mips[level + 1].cols >= cols)
+		level++;
+	const stickermip& src = st->mips[level];
+
+	if (src.rows == rows && src.cols == cols) {
+		out.set_size(rows, cols);
+		memcpy(&out[0][0], src.pixels, rows * cols * sizeof(dlib::rgb_alpha_pixel));
+		return;
+	}
+
+	std::vector<int> c0, c1, r0, r1;
+	std::vector<unsigned> cw, rw;
+	_sticker_coords(src.cols, cols, c0, c1, cw);
+	_sticker_coords(src.rows, rows, r0, r1, rw);
+
+	out.set_size(rows, cols);
+	for (long r = 0; r < rows; r++) {
+		const unsigned char* top = (const unsigned char*) (src.pixels + r0[r] * src.cols);
+		const unsigned char* bot = (const unsigned char*) (src.pixels + r1[r] * src.cols);
+		const unsigned wy = rw[r];
+		unsigned char* dst = (unsigned char*) &out[r][0];
+
+		for (long c = 0; c < cols; c++) {
+			const unsigned wx = cw[c];
+			const unsigned char* a = top + 4 * c0[c];
+			const unsigned char* b = top + 4 * c1[c];
+			const unsigned char* d = bot + 4 * c0[c];
+			const unsigned char* e = bot + 4 * c1[c];
+			/* the four channels share the weights */
+			for (int k = 0; k < 4; k++) {
+				const unsigned t = a[k] * (256 - wx) + b[k] * wx;
+				const unsigned u = d[k] * (256 - wx) + e[k] * wx;
+				dst[4 * c + k] = (t * (256 - wy) + u * wy + 0x8000) >> 16;
+			}
+		}
+	}
+}
@@ -0,0 +1,255 @@
+/*
+ * sticker_package.cpp
+ *
+ *  Layout of a package, in native (little endian) byte order:
+ *
+ *    ffheader
+ *    fflayout  x num_layouts
+ *    ffsticker x num_stickers
+ *    planes, each one starting on a FFSTICKER_ALIGN boundary
+ *
+ *  Planes are referred to by their offset from the start of the file, so
+ *  the stickers of the atlas point straight into the mapping.
+ */
+
+#include "sticker_package.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FFSTICKER_ALIGN 16
+/* Landmarks of the shape predictor an anchor may follow. */
+#define FFSTICKER_LANDMARKS 68
+
+typedef struct _ffheader {
+	char magic[8];
+	uint32_t version;
+	uint32_t num_layouts;
+	uint32_t num_stickers;
+	uint32_t size; /* of the whole file */
+} ffheader;
+
+typedef struct _fflayout {
+	char name[FFSTICKER_NAME_MAX];
+	int32_t count;
+	int32_t parts[MAX_ANCHORS];
+	float anchors[MAX_ANCHORS][2];
+} fflayout;
+
+typedef struct _ffplane {
+	uint32_t offset;
+	uint32_t rows;
+	uint32_t cols;
+} ffplane;
+
+typedef struct _ffsticker {
+	char name[FFSTICKER_NAME_MAX];
+	uint32_t num_mips;
+	ffplane mips[FFSTICKER_MAX_MIPS]; /* premultiplied RGBA, mips[0] is the full size */
+	ffplane nv12; /* the four planes of nv12_sticker_build, rows and cols are even */
+} ffsticker;
+
+static bool _package_name_ok(const char* name)
+{
+	return memchr(name, '\0', FFSTICKER_NAME_MAX) != NULL && name[0] != '\0';
+}
+
+/* every anchor follows a landmark of the shape and sits at a finite place on the sticker */
+static bool _package_layout_ok(const fflayout& layout)
+{
+	if (!_package_name_ok(layout.name) || layout.count < 2 || layout.count > MAX_ANCHORS)
+		return false;
+	for (int k = 0; k < layout.count; k++) {
+		if (layout.parts[k] < 0 || layout.parts[k] >= FFSTICKER_LANDMARKS
+				|| !std::isfinite(layout.anchors[k][0]) || !std::isfinite(layout.anchors[k][1]))
+			return false;
+	}
+	return true;
+}
+
+static bool _package_plane_ok(const ffplane& plane, uint64_t bytes, size_t size)
+{
+	return plane.rows > 0 && plane.cols > 0 && plane.offset % FFSTICKER_ALIGN == 0
+			&& plane.offset <= size && bytes <= size - plane.offset;
+}
+
+/**
+ * @brief Maps a package and adds its stickers and anchors to the atlas.
+ * @details The stickers point into the mapping, which stays until
+ *          sticker_atlas_release(). A package that does not check out is
+ *          rejected as a whole.
+ *
+ * @param atlas  The atlas to fill
+ * @param path   The .ffsticker file
+ *
+ * @return The number of stickers added, 0 if the package could not be used
+ */
+unsigned long sticker_package_map(stickeratlas* atlas, const char* path)
+{
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	struct stat sb;
+	if (fstat(fd, &sb) != 0 || (size_t) sb.st_size < sizeof(ffheader)) {
+		close(fd);
+		return 0;
+	}
+	const size_t size = sb.st_size;
+	void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return 0;
+
+	const unsigned char* base = (const unsigned char*) map;
+	const ffheader* header = (const ffheader*) base;
+	const uint64_t tables = sizeof(ffheader) + (uint64_t) header->num_layouts * sizeof(fflayout)
+			+ (uint64_t) header->num_stickers * sizeof(ffsticker);
+	bool ok = memcmp(header->magic, FFSTICKER_MAGIC, sizeof(header->magic)) == 0
+			&& header->version == FFSTICKER_VERSION && header->size == size && tables <= size;
+
+	const fflayout* layouts = (const fflayout*) (base + sizeof(ffheader));
+	for (uint32_t i = 0; ok && i < header->num_layouts; i++) {
+		ok = _package_layout_ok(layouts[i]);
+	}
+
+	const ffsticker* stickers = (const ffsticker*) (layouts + header->num_layouts);
+	for (uint32_t i = 0; ok && i < header->num_stickers; i++) {
+		const ffsticker& st = stickers[i];
+		ok = _package_name_ok(st.name) && st.num_mips >= 1 && st.num_mips <= FFSTICKER_MAX_MIPS
+				&& st.nv12.rows % 2 == 0 && st.nv12.cols % 2 == 0
+				&& _package_plane_ok(st.nv12, NV12_STICKER_SIZE((uint64_t) st.nv12.cols, st.nv12.rows), size);
+		for (uint32_t k = 0; ok && k < st.num_mips; k++) {
+			ok = _package_plane_ok(st.mips[k],
+					(uint64_t) st.mips[k].rows * st.mips[k].cols * sizeof(dlib::rgb_alpha_pixel), size);
+		}
+	}
+
+	if (!ok) {
+		munmap(map, size);
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < header->num_layouts; i++) {
+		stickerlayout layout;
+		layout.name = layouts[i].name;
+		layout.count = layouts[i].count;
+		memcpy(layout.parts, layouts[i].parts, sizeof(layout.parts));
+		memcpy(layout.anchors, layouts[i].anchors, sizeof(layout.anchors));
+		atlas->layouts.push_back(layout);
+	}
+
+	for (uint32_t i = 0; i < header->num_stickers; i++) {
+		const ffsticker& packed = stickers[i];
+		atlas->stickers.push_back(sticker());
+		sticker& st = atlas->stickers.back();
+
+		st.name = packed.name;
+		st.mips.resize(packed.num_mips);
+		for (uint32_t k = 0; k < packed.num_mips; k++) {
+			st.mips[k].rows = packed.mips[k].rows;
+			st.mips[k].cols = packed.mips[k].cols;
+			st.mips[k].pixels = (const dlib::rgb_alpha_pixel*) (base + packed.mips[k].offset);
+		}
+		nv12_sticker_attach(base + packed.nv12.offset, packed.nv12.cols, packed.nv12.rows, &st.nv12);
+	}
+
+	atlas->mappings.push_back(std::make_pair(map, size));
+	return header->num_stickers;
+}
+
+static uint32_t _package_place(size_t* end, size_t bytes)
+{
+	const size_t offset = (*end + FFSTICKER_ALIGN - 1) & ~(size_t) (FFSTICKER_ALIGN - 1);
+	*end = offset + bytes;
+	return offset;
+}
+
+/**
+ * @brief Writes every sticker and anchor of the atlas into a package.
+ *
+ * @param atlas  The stickers, decoded or mapped, and the anchors to ship
+ *               with them
+ * @param path   The .ffsticker file to create
+ *
+ * @return @c true on success, @c false if a name is too long, a sticker
+ *         has too many mip levels or the file could not be written
+ */
+bool sticker_package_write(const stickeratlas* atlas, const char* path)
+{
+	ffheader header;
+	std::vector<fflayout> layouts(atlas->layouts.size());
+	std::vector<ffsticker> stickers(atlas->stickers.size());
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FFSTICKER_MAGIC, sizeof(header.magic));
+	header.version = FFSTICKER_VERSION;
+	header.num_layouts = layouts.size();
+	header.num_stickers = stickers.size();
+
+	for (size_t i = 0; i < layouts.size(); i++) {
+		const stickerlayout& layout = atlas->layouts[i];
+		memset(&layouts[i], 0, sizeof(fflayout));
+		if (strlen(layout.name) >= FFSTICKER_NAME_MAX)
+			return false;
+		strcpy(layouts[i].name, layout.name);
+		layouts[i].count = layout.count;
+		memcpy(layouts[i].parts, layout.parts, sizeof(layout.parts));
+		memcpy(layouts[i].anchors, layout.anchors, sizeof(layout.anchors));
+	}
+
+	size_t end = sizeof(ffheader) + layouts.size() * sizeof(fflayout) + stickers.size() * sizeof(ffsticker);
+	for (size_t i = 0; i < stickers.size(); i++) {
+		const sticker& st = atlas->stickers[i];
+		ffsticker& packed = stickers[i];
+		memset(&packed, 0, sizeof(ffsticker));
+		if (st.name.size() >= FFSTICKER_NAME_MAX || st.mips.empty() || st.mips.size() > FFSTICKER_MAX_MIPS)
+			return false;
+		strcpy(packed.name, st.name.c_str());
+
+		packed.num_mips = st.mips.size();
+		for (size_t k = 0; k < st.mips.size(); k++) {
+			packed.mips[k].rows = st.mips[k].rows;
+			packed.mips[k].cols = st.mips[k].cols;
+			packed.mips[k].offset = _package_place(&end,
+					st.mips[k].rows * st.mips[k].cols * sizeof(dlib::rgb_alpha_pixel));
+		}
+		packed.nv12.rows = st.nv12.height;
+		packed.nv12.cols = st.nv12.width;
+		packed.nv12.offset = _package_place(&end, NV12_STICKER_SIZE(st.nv12.width, st.nv12.height));
+	}
+	if (end > UINT32_MAX)
+		return false;
+	header.size = end;
+
+	std::vector<unsigned char> file(end, 0);
+	unsigned char* out = &file[0];
+	memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+	if (!layouts.empty())
+		memcpy(out, &layouts[0], layouts.size() * sizeof(fflayout));
+	out += layouts.size() * sizeof(fflayout);
+	if (!stickers.empty())
+		memcpy(out, &stickers[0], stickers.size() * sizeof(ffsticker));
+
+	for (size_t i = 0; i < stickers.size(); i++) {
+		const sticker& st = atlas->stickers[i];
+		for (size_t k = 0; k < st.mips.size(); k++) {
+			memcpy(&file[stickers[i].mips[k].offset], st.mips[k].pixels,
+					st.mips[k].rows * st.mips[k].cols * sizeof(dlib::rgb_alpha_pixel));
+		}
+		memcpy(&file[stickers[i].nv12.offset], st.nv12.y, NV12_STICKER_SIZE(st.nv12.width, st.nv12.height));
+	}
+
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+		return false;
+	const bool written = fwrite(&file[0], 1, file.size(), fp) == file.size();
+	return fclose(fp) == 0 && written;
+}
@@ -0,0 +1,254 @@
+/*
+ * sticker_warp.cpp
+ *
+ *  A similarity transform is fitted from the landmarks on the frame to the
+ *  anchors on the sticker, so every frame pixel inside the destination box
+ *  knows where to sample the sticker. Going from the frame to the sticker
+ *  leaves no holes, and the transform being affine, the sticker position
+ *  only has to be stepped by a constant along a row.
+ *
+ *  Sampling is bilinear in 16.16 fixed point. A premultiplied RGBA texel
+ *  fits in 32 bits, so red/blue and green/alpha are interpolated two at a
+ *  time in the two 16 bit halves of a word. Gathering texels at arbitrary
+ *  positions is what dominates, and neither NEON nor SSE2 has a gather.
+ */
+
+#include "sticker_warp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+static const stickerlayout layouts[] = {
+	/* lenses over the eyes, fitted on the outer and inner eye corners */
+	{ "glasses01", 4, { 36, 39, 42, 45 },
+		{ { 0.13f, 0.45f }, { 0.40f, 0.45f }, { 0.60f, 0.45f }, { 0.87f, 0.45f } } },
+	/* a round nose between the nostrils, over the tip of the nose */
+	{ "deer_nose", 3, { 31, 35, 30 },
+		{ { 0.05f, 0.65f }, { 0.95f, 0.65f }, { 0.5f, 0.4f } } },
+	/* antlers rising above the temples, the eyebrows span two sticker widths */
+	{ "deer_left", 2, { 17, 26 }, { { 0.9f, 1.5f }, { 3.1f, 1.5f } } },
+	{ "deer_right", 2, { 17, 26 }, { { -2.1f, 1.5f }, { 0.1f, 1.5f } } },
+	/* the brim sits on the forehead, above the eyebrows */
+	{ "hat", 2, { 17, 26 }, { { 0.12f, 1.3f }, { 0.88f, 1.3f } } },
+};
+
+/**
+ * @brief Returns the built-in anchors of the given sticker or sequence, or NULL.
+ * @details Anchors shipped in a sticker package take precedence, see
+ *          sticker_atlas_find_layout().
+ */
+const stickerlayout* sticker_layout_find(const char* name)
+{
+	for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+		if (strcmp(layouts[i].name, name) == 0)
+			return &layouts[i];
+	}
+	return NULL;
+}
+
+/**
+ * @brief Interpolates two packed RGBA texels, w being the weight of b out of 256.
+ */
+static inline uint32_t _lerp(uint32_t a, uint32_t b, uint32_t w)
+{
+	const uint32_t rb = ((a & 0x00ff00ff) * (256 - w) + (b & 0x00ff00ff) * w + 0x00800080) >> 8;
+	const uint32_t ga = ((a >> 8) & 0x00ff00ff) * (256 - w) + ((b >> 8) & 0x00ff00ff) * w + 0x00800080;
+	return (rb & 0x00ff00ff) | (ga & 0xff00ff00);
+}
+
+static inline uint32_t _texel(const stickermip& img, int x, int y)
+{
+	if ((unsigned) x >= (unsigned) img.cols || (unsigned) y >= (unsigned) img.rows)
+		return 0;
+	uint32_t p;
+	memcpy(&p, &img.pixels[y * img.cols + x], sizeof(p));
+	return p;
+}
+
+/**
+ * @brief Samples the sticker at (u, v), given in 16.16 fixed point.
+ * @details Outside of the sticker is transparent, so its edges fade out
+ *          over one texel instead of being cut.
+ */
+static inline uint32_t _sample(const stickermip& img, int u, int v)
+{
+	const int x = u >> 16, y = v >> 16;
+	const uint32_t wx = (u >> 8) & 0xff, wy = (v >> 8) & 0xff;
+	uint32_t a, b, c, d;
+
+	if ((unsigned) x < (unsigned) (img.cols - 1) && (unsigned) y < (unsigned) (img.rows - 1)) {
+		memcpy(&a, &img.pixels[y * img.cols + x], sizeof(a));
+		memcpy(&b, &img.pixels[y * img.cols + x + 1], sizeof(b));
+		memcpy(&c, &img.pixels[(y + 1) * img.cols + x], sizeof(c));
+		memcpy(&d, &img.pixels[(y + 1) * img.cols + x + 1], sizeof(d));
+	} else {
+		if (x < -1 || y < -1 || x >= img.cols || y >= img.rows)
+			return 0;
+		a = _texel(img, x, y);
+		b = _texel(img, x + 1, y);
+		c = _texel(img, x, y + 1);
+		d = _texel(img, x + 1, y + 1);
+	}
+	return _lerp(_lerp(a, b, wx), _lerp(c, d, wx), wy);
+}
+
+/**
+ * @brief Blends one premultiplied luma sample over dst.
+ */
+static inline void _blend_y(unsigned char* dst, uint32_t p)
+{
+	const int r = p & 0xff, g = (p >> 8) & 0xff, b = (p >> 16) & 0xff, a = p >> 24;
+	const int y = std::min(a, ((66 * r + 129 * g + 25 * b + 128) >> 8) + (16 * a + 127) / 255);
+	const unsigned t = *dst * (255 - a) + 128;
+	const unsigned v = y + ((t + (t >> 8)) >> 8);
+	*dst = v > 255 ? 255 : v;
+}
+
+/**
+ * @brief Works out where a sticker goes on a face and how to sample it.
+ *
+ * @param width   The frame width, even
+ * @param height  The frame height, even
+ * @param st      The sticker
+ * @param base    The sticker the anchors are placed on. st is drawn centered
+ *                on it, at its own size, so the frames of an animation keep
+ *                their relative sizes. Usually st itself.
+ * @param layout  Where the landmarks go on base
+ * @param shape   The landmarks of the face, on the rotated gray image
+ * @param draw    Receives the placement
+ *
+ * @return @c false if the sticker falls outside of the frame
+ */
+bool sticker_warp_prepare(int width, int height, const sticker* st, const sticker* base,
+		const stickerlayout* layout, const dlib::full_object_detection& shape, warpdraw* draw)
+{
+	const stickermip& full = st->mips[0];
+	const stickermip& anchored = base->mips[0];
+	const double ox = (full.cols - anchored.cols) / 2.0, oy = (full.rows - anchored.rows) / 2.0;
+
+	std::vector<dlib::vector<double, 2> > from(layout->count), to(layout->count);
+	for (int i = 0; i < layout->count; i++) {
+		const dlib::point& p = shape.part(layout->parts[i]);
+		/* the gray image is the frame turned by 90 degrees */
+		from[i] = dlib::vector<double, 2>(p.y(), height - 1 - p.x());
+		to[i] = dlib::vector<double, 2>(layout->anchors[i][0] * anchored.cols - 0.5 + ox,
+				layout->anchors[i][1] * anchored.rows - 0.5 + oy);
+	}
+	const dlib::point_transform_affine tf = dlib::find_similarity_transform(from, to);
+	const dlib::matrix<double, 2, 2>& m = tf.get_m();
+	const dlib::vector<double, 2>& b = tf.get_b();
+
+	/* sample the mip whose texels are less than two frame pixels apart */
+	double scale = std::sqrt(std::abs(dlib::det(m)));
+	size_t level = 0;
+	while (level + 1 < st->mips.size() && scale >= 2) {
+		scale /= 2;
+		level++;
+	}
+	const stickermip& img = st->mips[level];
+	const double sx = (double) img.cols / full.cols, sy = (double) img.rows / full.rows;
+
+	/* destination box: where the corners of the sticker land on the frame */
+	const dlib::point_transform_affine itf = dlib::inv(tf);
+	const double cx[4] = { -0.5, full.cols - 0.5, -0.5, full.cols - 0.5 };
+	const double cy[4] = { -0.5, -0.5, full.rows - 0.5, full.rows - 0.5 };
+	double l = width, t = height, r = -1, bt = -1;
+	for (int i = 0; i < 4; i++) {
+		const dlib::vector<double, 2> c = itf(dlib::vector<double, 2>(cx[i], cy[i]));
+		l = std::min(l, c.x());
+		t = std::min(t, c.y());
+		r = std::max(r, c.x());
+		bt = std::max(bt, c.y());
+	}
+
+	int x0 = std::max(0, (int) std::floor(l)), y0 = std::max(0, (int) std::floor(t));
+	int x1 = std::min(width, (int) std::ceil(r) + 1), y1 = std::min(height, (int) std::ceil(bt) + 1);
+	x0 -= x0 & 1;
+	y0 -= y0 & 1;
+	x1 += x1 & 1;
+	y1 += y1 & 1;
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+	/* frame pixel to mip texel, with pixel centers lined up, in 16.16 */
+	draw->mip = &img;
+	draw->x0 = x0;
+	draw->y0 = y0;
+	draw->x1 = x1;
+	draw->y1 = y1;
+	draw->du_dx = (int) std::floor(sx * m(0, 0) * 65536 + 0.5);
+	draw->du_dy = (int) std::floor(sx * m(0, 1) * 65536 + 0.5);
+	draw->dv_dx = (int) std::floor(sy * m(1, 0) * 65536 + 0.5);
+	draw->dv_dy = (int) std::floor(sy * m(1, 1) * 65536 + 0.5);
+	const double u0 = sx * (m(0, 0) * x0 + m(0, 1) * y0 + b.x() + 0.5) - 0.5;
+	const double v0 = sy * (m(1, 0) * x0 + m(1, 1) * y0 + b.y() + 0.5) - 0.5;
+	draw->u0 = (int) std::floor(u0 * 65536 + 0.5);
+	draw->v0 = (int) std::floor(v0 * 65536 + 0.5);
+	return true;
+}
+
+/**
+ * @brief Draws the rows of a placed sticker that fall in [top, bottom).
+ * @details Positions are stepped from the top left corner of the box, so
+ *          drawing the rows in several pieces gives the same pixels as
+ *          drawing them at once.
+ *
+ * @param y       The luma plane of the frame
+ * @param uv      The interleaved chroma plane of the frame
+ * @param width   The frame width, even
+ * @param draw    The placement, from sticker_warp_prepare()
+ * @param top     The first row to draw, even
+ * @param bottom  One past the last row to draw, even
+ */
+void sticker_warp_rows(unsigned char* y, unsigned char* uv, int width, const warpdraw* draw,
+		int top, int bottom)
+{
+	const stickermip& img = *draw->mip;
+	const int du_dx = draw->du_dx, du_dy = draw->du_dy;
+	const int dv_dx = draw->dv_dx, dv_dy = draw->dv_dy;
+	const int x0 = draw->x0, x1 = draw->x1;
+	const int y0 = std::max(draw->y0, top), y1 = std::min(draw->y1, bottom);
+	int u_row = draw->u0 + (y0 - draw->y0) * du_dy;
+	int v_row = draw->v0 + (y0 - draw->y0) * dv_dy;
+
+	/* one 2x2 block per step: four luma samples and the chroma sample they share */
+	for (int fy = y0; fy < y1; fy += 2, u_row += 2 * du_dy, v_row += 2 * dv_dy) {
+		unsigned char* yr0 = y + fy * width;
+		unsigned char* yr1 = yr0 + width;
+		unsigned char* cr = uv + (fy / 2) * width;
+		int u = u_row, v = v_row;
+
+		for (int fx = x0; fx < x1; fx += 2, u += 2 * du_dx, v += 2 * dv_dx) {
+			const uint32_t p00 = _sample(img, u, v);
+			const uint32_t p01 = _sample(img, u + du_dx, v + dv_dx);
+			const uint32_t p10 = _sample(img, u + du_dy, v + dv_dy);
+			const uint32_t p11 = _sample(img, u + du_dx + du_dy, v + dv_dx + dv_dy);
+			if (((p00 | p01 | p10 | p11) >> 24) == 0)
+				continue;
+
+			_blend_y(yr0 + fx, p00);
+			_blend_y(yr0 + fx + 1, p01);
+			_blend_y(yr1 + fx, p10);
+			_blend_y(yr1 + fx + 1, p11);
+
+			/* the conversion is linear, so the chroma of the mean is the mean of the chroma */
+			const uint32_t rb = (p00 & 0x00ff00ff) + (p01 & 0x00ff00ff)
+					+ (p10 & 0x00ff00ff) + (p11 & 0x00ff00ff) + 0x00020002;
+			const uint32_t ga = ((p00 >> 8) & 0x00ff00ff) + ((p01 >> 8) & 0x00ff00ff)
+					+ ((p10 >> 8) & 0x00ff00ff) + ((p11 >> 8) & 0x00ff00ff) + 0x00020002;
+			const int pr = (rb >> 2) & 0xff, pb = (rb >> 18) & 0xff;
+			const int pg = (ga >> 2) & 0xff, a = (ga >> 18) & 0xff;
+			const int cu = std::max(0, std::min(a,
+					((-38 * pr - 74 * pg + 112 * pb + 128) >> 8) + (128 * a + 127) / 255));
+			const int cv = std::max(0, std::min(a,
+					((112 * pr - 94 * pg - 18 * pb + 128) >> 8) + (128 * a + 127) / 255));
+			for (int k = 0; k < 2; k++) {
+				const unsigned tt = cr[fx + k] * (255 - a) + 128;
+				const unsigned val = (k == 0 ? cu : cv) + ((tt + (tt >> 8)) >> 8);
+				cr[fx + k] = val > 255 ? 255 : val;
+			}
+		}
+	}
+}
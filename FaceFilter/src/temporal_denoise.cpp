@@ -0,0 +1,191 @@
+/*
+ * temporal_denoise.cpp
+ *
+ *  A recursive filter: out = w * frame + (1 - w) * previous out. The
+ *  weight w of every 8x8 block comes from the sum of absolute differences
+ *  between the block and the previous output, DENOISE_STILL_WEIGHT / 128
+ *  where the difference is no more than noise and 1 where something moved,
+ *  linearly in between. Blocks are 8 bytes wide in both planes, 4 Cb Cr
+ *  pairs in the chroma one, so chroma uses the weights of the luma blocks
+ *  above it. SSE2 sums the differences of two blocks at once with psadbw,
+ *  NEON with vabd and pairwise widening adds.
+ *
+ *  Nothing is allocated once the first frame is in: the history and the
+ *  weights are kept and blended in place.
+ */
+
+#include "temporal_denoise.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <dlib/simd.h>
+
+/**
+ * @brief Weight of the new frame in a block of n samples whose absolute
+ *        differences add up to sad, in 1/128.
+ */
+static inline unsigned char _denoise_weight(int sad, int n)
+{
+	/* sad / n against the thresholds, without dividing */
+	if (sad <= DENOISE_STILL * n)
+		return DENOISE_STILL_WEIGHT;
+	if (sad >= DENOISE_MOVING * n)
+		return 128;
+	return DENOISE_STILL_WEIGHT + (128 - DENOISE_STILL_WEIGHT) * (sad - DENOISE_STILL * n)
+			/ ((DENOISE_MOVING - DENOISE_STILL) * n);
+}
+
+/**
+ * @brief Measures the motion of a row of blocks.
+ *
+ * @param cur      The first luma row of the blocks in the new frame
+ * @param prev     The same row in the history
+ * @param width    The frame width, also the distance between rows
+ * @param rows     The height of the blocks, DENOISE_BLOCK but at the bottom
+ * @param weights  Receives the weight of every block
+ */
+static void _denoise_measure(const unsigned char* cur, const unsigned char* prev, int width,
+		int rows, unsigned char* weights)
+{
+	const int n = DENOISE_BLOCK * rows;
+	int x = 0;
+
+#if defined(DLIB_HAVE_NEON)
+	for (; x + 2 * DENOISE_BLOCK <= width; x += 2 * DENOISE_BLOCK) {
+		uint16x8_t sum = vdupq_n_u16(0);
+		for (int r = 0; r < rows; r++)
+			sum = vpadalq_u8(sum, vabdq_u8(vld1q_u8(cur + r * width + x), vld1q_u8(prev + r * width + x)));
+		const uint64x2_t sads = vpaddlq_u32(vpaddlq_u16(sum));
+		weights[x / DENOISE_BLOCK] = _denoise_weight((int) vgetq_lane_u64(sads, 0), n);
+		weights[x / DENOISE_BLOCK + 1] = _denoise_weight((int) vgetq_lane_u64(sads, 1), n);
+	}
+#elif defined(DLIB_HAVE_SSE2)
+	for (; x + 2 * DENOISE_BLOCK <= width; x += 2 * DENOISE_BLOCK) {
+		__m128i sum = _mm_setzero_si128();
+		for (int r = 0; r < rows; r++)
+			sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i*) (cur + r * width + x)),
+					_mm_loadu_si128((const __m128i*) (prev + r * width + x))));
+		weights[x / DENOISE_BLOCK] = _denoise_weight(_mm_cvtsi128_si32(sum), n);
+		weights[x / DENOISE_BLOCK + 1] = _denoise_weight(_mm_cvtsi128_si32(_mm_srli_si128(sum, 8)), n);
+	}
+#endif
+
+	for (; x < width; x += DENOISE_BLOCK) {
+		const int cols = std::min(DENOISE_BLOCK, width - x);
+		int sad = 0;
+		for (int r = 0; r < rows; r++)
+			for (int i = 0; i < cols; i++)
+				sad += abs(cur[r * width + x + i] - prev[r * width + x + i]);
+		weights[x / DENOISE_BLOCK] = _denoise_weight(sad, cols * rows);
+	}
+}
+
+/**
+ * @brief Blends a row of the new frame into the history, and back.
+ * @details Both hold the result afterwards. Every weight covers DENOISE_BLOCK bytes.
+ */
+static void _denoise_blend(unsigned char* cur, unsigned char* prev, const unsigned char* weights, int n)
+{
+	int x = 0;
+
+#if defined(DLIB_HAVE_NEON)
+	for (; x + 2 * DENOISE_BLOCK <= n; x += 2 * DENOISE_BLOCK) {
+		const uint8x16_t c = vld1q_u8(cur + x), p = vld1q_u8(prev + x);
+		const unsigned char w0 = weights[x / DENOISE_BLOCK], w1 = weights[x / DENOISE_BLOCK + 1];
+		uint16x8_t lo = vmull_u8(vget_low_u8(c), vdup_n_u8(w0));
+		uint16x8_t hi = vmull_u8(vget_high_u8(c), vdup_n_u8(w1));
+		lo = vmlal_u8(lo, vget_low_u8(p), vdup_n_u8(128 - w0));
+		hi = vmlal_u8(hi, vget_high_u8(p), vdup_n_u8(128 - w1));
+		const uint8x16_t r = vcombine_u8(vrshrn_n_u16(lo, 7), vrshrn_n_u16(hi, 7));
+		vst1q_u8(cur + x, r);
+		vst1q_u8(prev + x, r);
+	}
+#elif defined(DLIB_HAVE_SSE2)
+	const __m128i zero = _mm_setzero_si128(), half = _mm_set1_epi16(64), one = _mm_set1_epi16(128);
+	for (; x + 2 * DENOISE_BLOCK <= n; x += 2 * DENOISE_BLOCK) {
+		const __m128i c = _mm_loadu_si128((const __m128i*) (cur + x));
+		const __m128i p = _mm_loadu_si128((const __m128i*) (prev + x));
+		const __m128i w0 = _mm_set1_epi16(weights[x / DENOISE_BLOCK]);
+		const __m128i w1 = _mm_set1_epi16(weights[x / DENOISE_BLOCK + 1]);
+		/* at most 255 * 128 + 64, unsigned 16 bits hold it */
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(c, zero), w0),
+				_mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), _mm_sub_epi16(one, w0)));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(c, zero), w1),
+				_mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), _mm_sub_epi16(one, w1)));
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, half), 7);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, half), 7);
+		const __m128i r = _mm_packus_epi16(lo, hi);
+		_mm_storeu_si128((__m128i*) (cur + x), r);
+		_mm_storeu_si128((__m128i*) (prev + x), r);
+	}
+#endif
+
+	for (; x < n; x++) {
+		const int w = weights[x / DENOISE_BLOCK];
+		cur[x] = prev[x] = (unsigned char) ((cur[x] * w + prev[x] * (128 - w) + 64) >> 7);
+	}
+}
+
+/**
+ * @brief Forgets the history, the next frame passes unchanged.
+ */
+void denoise_reset(denoiser* dn)
+{
+	dn->width = 0;
+	dn->height = 0;
+}
+
+/**
+ * @brief Denoises a frame, in place, and keeps the result for the next one.
+ * @details The first frame, or the first one after a change of size or of
+ *          chroma, only fills the history.
+ *
+ * @param dn      The history
+ * @param y       The luma plane
+ * @param uv      The interleaved chroma plane
+ * @param width   The frame width, even
+ * @param height  The frame height, even
+ * @param chroma  @c true to denoise the chroma as well
+ * @param pool    Denoises rows of blocks on its threads, NULL to denoise them in turn
+ */
+void denoise_frame(denoiser* dn, unsigned char* y, unsigned char* uv, int width, int height,
+		bool chroma, dlib::thread_pool* pool)
+{
+	const size_t luma = (size_t) width * height;
+	const int blocks = (width + DENOISE_BLOCK - 1) / DENOISE_BLOCK;
+	const int block_rows = (height + DENOISE_BLOCK - 1) / DENOISE_BLOCK;
+
+	if (dn->width != width || dn->height != height || (chroma && dn->uv.size() < luma / 2)) {
+		dn->y.assign(y, y + luma);
+		if (chroma)
+			dn->uv.assign(uv, uv + luma / 2);
+		else
+			dn->uv.clear();
+		dn->weights.resize((size_t) blocks * block_rows);
+		dn->width = width;
+		dn->height = height;
+		return;
+	}
+
+	auto run = [&](long begin, long end) {
+		for (long j = begin; j < end; j++) {
+			const int top = j * DENOISE_BLOCK;
+			const int rows = std::min(DENOISE_BLOCK, height - top);
+			unsigned char* weights = &dn->weights[j * blocks];
+			_denoise_measure(y + (size_t) top * width, &dn->y[(size_t) top * width], width, rows, weights);
+			for (int r = top; r < top + rows; r++)
+				_denoise_blend(y + (size_t) r * width, &dn->y[(size_t) r * width], weights, width);
+			if (chroma)
+				for (int r = top / 2; r < (top + rows) / 2; r++)
+					_denoise_blend(uv + (size_t) r * width, &dn->uv[(size_t) r * width], weights, width);
+		}
+	};
+	if (pool != NULL && pool->num_threads_in_pool() > 1)
+		dlib::parallel_for_blocked(*pool, 0, block_rows, run);
+	else
+		run(0, block_rows);
+
+	/* the chroma history went stale while it was not denoised */
+	if (!chroma)
+		dn->uv.clear();
+}
@@ -0,0 +1,146 @@
+// The contents of this file are in the public domain. See LICENSE_FOR_EXAMPLE_PROGRAMS.txt
+/*
+
+    This program measures what the two stage cascade of scan_fhog_pyramid
+    costs the frontal face detector in missed faces, and what it saves in
+    time.
+
+    Every image is run through the frontal face detector as dlib ships it,
+    which scores every window with the full filter bank, along with its
+    mirror image and a few harder variants of it: scaled down, scaled up,
+    and dimmed with sensor noise, as a preview in poor light is.  Then it
+    is run again with the cascade on, at rank 1, for several margins (see
+    set_cascade_rank() and set_cascade_margin()).  A
+    face the full detector finds is missed when the cascade finds no box
+    overlapping it by more than half.  Detections are counted at the
+    default threshold and at a lowered one, so faces the detector is barely
+    sure of are counted too, which are the ones a pessimistic first stage
+    loses first.
+
+    The sample face and the stickers, which have no faces but plenty of
+    edges for false alarms, make a small set.  Any other images can be
+    given as well.
+
+    Call this program like this:
+        ./cascade_check face.jpg ear01.png glasses01.png
+    or run make cascade_check, which gives it the sample face and every
+    sticker of sticker_image.
+*/
+
+#include <dlib/image_processing/frontal_face_detector.h>
+#include <dlib/image_io.h>
+#include <dlib/image_transforms.h>
+#include <dlib/rand.h>
+#include <chrono>
+#include <iostream>
+
+using namespace dlib;
+using namespace std;
+
+// Adds img and its variants to images.
+void add_variants(std::vector<array2d<unsigned char> >& images, const array2d<unsigned char>& img,
+    dlib::rand& rnd)
+{
+    images.resize(images.size() + 5);
+    array2d<unsigned char>* v = &images[images.size() - 5];
+    assign_image(v[0], img);
+    flip_image_left_right(img, v[1]);
+    v[2].set_size(img.nr() * 2 / 3, img.nc() * 2 / 3);
+    resize_image(img, v[2]);
+    v[3].set_size(img.nr() * 3 / 2, img.nc() * 3 / 2);
+    resize_image(img, v[3]);
+    v[4].set_size(img.nr(), img.nc());
+    for (long r = 0; r < img.nr(); ++r)
+        for (long c = 0; c < img.nc(); ++c)
+            v[4][r][c] = (unsigned char) std::max(0.0, std::min(img[r][c] * 0.4 + 6 * rnd.get_random_gaussian() + 8, 255.0));
+}
+
+// Faces of dets the cascade did not find.
+unsigned long count_misses(const std::vector<rectangle>& dets, const std::vector<rectangle>& cascade_dets)
+{
+    unsigned long misses = 0;
+    for (size_t i = 0; i < dets.size(); ++i)
+    {
+        bool found = false;
+        for (size_t j = 0; j < cascade_dets.size() && !found; ++j)
+            found = box_intersection_over_union(drectangle(dets[i]), drectangle(cascade_dets[j])) > 0.5;
+        if (!found)
+            ++misses;
+    }
+    return misses;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        cout << "Call this program like this:" << endl;
+        cout << "./cascade_check face.jpg sticker_image/*" << endl;
+        return 0;
+    }
+
+    dlib::rand rnd;
+    std::vector<array2d<unsigned char> > images;
+    for (int i = 1; i < argc; ++i)
+    {
+        array2d<unsigned char> img;
+        try
+        {
+            load_image(img, argv[i]);
+        }
+        catch (exception& e)
+        {
+            cerr << argv[i] << ": " << e.what() << endl;
+            return 1;
+        }
+        add_variants(images, img, rnd);
+    }
+
+    typedef frontal_face_detector::image_scanner_type scanner_type;
+    frontal_face_detector full = get_frontal_face_detector();
+    std::vector<frontal_face_detector::feature_vector_type> w;
+    for (unsigned long i = 0; i < full.num_detectors(); ++i)
+        w.push_back(full.get_w(i));
+
+    const double thresholds[] = { 0, -0.5 };
+    const double margins[] = { 0, 0.5, 1, 2 };
+
+    for (int t = 0; t < 2; ++t)
+    {
+        const double thresh = thresholds[t];
+
+        std::vector<std::vector<rectangle> > dets(images.size());
+        unsigned long faces = 0;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            dets[i] = full(images[i], thresh);
+            faces += dets[i].size();
+        }
+        const double full_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "threshold " << thresh << ": " << faces << " faces in " << images.size()
+             << " images, full filter bank " << full_ms << " ms" << endl;
+
+        for (int m = 0; m < 4; ++m)
+        {
+            scanner_type scanner;
+            scanner.copy_configuration(full.get_scanner());
+            scanner.set_cascade_rank(1);
+            scanner.set_cascade_margin(margins[m]);
+            frontal_face_detector cascade(scanner, full.get_overlap_tester(), w);
+
+            unsigned long misses = 0, extra = 0;
+            start = chrono::steady_clock::now();
+            for (size_t i = 0; i < images.size(); ++i)
+            {
+                const std::vector<rectangle> cascade_dets = cascade(images[i], thresh);
+                misses += count_misses(dets[i], cascade_dets);
+                extra += count_misses(cascade_dets, dets[i]);
+            }
+            const double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            cout << "  margin " << margins[m] << ": " << misses << " missed, " << extra << " extra, "
+                 << ms << " ms" << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,247 @@
+// The contents of this file are in the public domain. See LICENSE_FOR_EXAMPLE_PROGRAMS.txt
+/*
+
+    This program times the NV12 sticker blending of the FaceFilter app
+    against the routine it replaced, _image_util_imgcpy(), and checks the
+    blend against a floating point reference.
+
+    The old routine copied a sticker into the frame one pixel at a time,
+    keying out the white background on the luma only and checking the
+    bounds of every pixel.  A copy of it is kept below, with stand-ins for
+    the two structures of the Tizen SDK it takes, as the baseline.  Both
+    draw square stickers at the center of a 1280x720 frame.
+
+    The reference is dst = src + dst * (255 - alpha) / 255 in floating
+    point, which the blend has to stay within half a level of, at clipped
+    and unclipped positions alike.
+
+    Call this program like this:
+        ./compositor_bench
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <dlib/rand.h>
+#include "nv12_compositor.h"
+
+using namespace dlib;
+using namespace std;
+
+// ----------------------------------------------------------------------------------------
+
+// The parts of the Tizen camera and image types _image_util_imgcpy() uses.
+struct camera_preview_data_s
+{
+    int width, height;
+    struct { struct { unsigned char* y; unsigned char* uv; int y_size, uv_size; } double_plane; } data;
+};
+
+typedef struct _imageinfo{
+	unsigned char* data;
+	int size;
+	int width;
+	int height;
+	int error;
+}imageinfo;
+
+#define STICKER_WHITE_KEY 220
+
+// As it was in FaceFilter/src/imageutils.cpp, ALPHA was never defined.
+void _image_util_imgcpy(camera_preview_data_s* frame, imageinfo* imginfo, int p, int q)
+{
+	int sh = imginfo->height;
+	int sw = imginfo->width;
+	int sy_size = sh*sw;
+
+	int fh = frame->height;
+	int fw = frame->width;
+	(void) fh; // never used, the routine is kept as it was
+
+	p -= sw/2;
+	q -= sh/2;
+
+	int pt = p + q*fw;
+	int pti = 0;
+
+#ifdef ALPHA
+	// copy Y plane
+	for(int i=0;i<sw;i++)
+	{
+		if(pt > frame->data.double_plane.y_size || pti > sy_size)
+			break;
+		memcpy(frame->data.double_plane.y + pt, imginfo->data + pti, sizeof(unsigned char)*sh);
+		pt += fw;
+		pti += sh;
+	}
+
+	// copy UV plane
+	p /=2;
+	q /=2;
+	pt = (p + q*fw/2)*2;
+	pti = sy_size;
+
+	for(int i=0;i<sw/2;i++)
+	{
+		if(pt > frame->data.double_plane.uv_size || pti > imginfo->size)
+			break;
+		memcpy(frame->data.double_plane.uv + pt, imginfo->data + pti, sizeof(unsigned char)*sh);
+		pt += fw;
+		pti += sh;
+	}
+#else
+	for(int i=0;i<sw;i++)
+	{
+		if(pt >= frame->data.double_plane.y_size || pti >= sy_size)
+			break;
+		for(int j=0;j<sh;j++)
+		{
+			if(pt+j < frame->data.double_plane.y_size && pti+j < sy_size)
+				if(imginfo->data[pti+j] <= STICKER_WHITE_KEY)
+					frame->data.double_plane.y[pt+j] = imginfo->data[pti+j];
+		}
+		pt += fw;
+		pti += sh;
+	}
+
+	// copy UV plane
+	p /=2;
+	q /=2;
+	pt = (p + q*fw/2)*2-1;
+	pti = sy_size;
+
+	for(int i=0;i<sw/2;i++)
+	{
+		if(pt >= frame->data.double_plane.uv_size || pti >= imginfo->size)
+			break;
+		for(int j=0;j<sh;j++)
+		{
+			if(pt+j < frame->data.double_plane.uv_size && pti+j < imginfo->size)
+				frame->data.double_plane.uv[pt+j] = imginfo->data[pti+j];
+		}
+		pt += fw;
+		pti += sh;
+	}
+#endif
+}
+
+// ----------------------------------------------------------------------------------------
+
+const int width = 1280, height = 720;
+
+// Largest difference between nv12_blend_sticker() and the floating point
+// blend, with the sticker centered on (cx, cy).
+double blend_error(const std::vector<unsigned char>& y, const std::vector<unsigned char>& uv,
+    const nv12sticker& st, int cx, int cy)
+{
+    std::vector<unsigned char> y2 = y, uv2 = uv;
+    nv12_blend_sticker(&y2[0], &uv2[0], width, height, &st, cx, cy, 0, height);
+
+    int left = cx - st.width / 2, top = cy - st.height / 2;
+    left -= left & 1;
+    top -= top & 1;
+    double error = 0;
+    for (int r = 0; r < height; ++r)
+    {
+        for (int c = 0; c < width; ++c)
+        {
+            const int sr = r - top, sc = c - left;
+            double expected = y[r * width + c];
+            if (sr >= 0 && sr < st.height && sc >= 0 && sc < st.width)
+            {
+                const int k = sr * st.width + sc;
+                expected = st.y[k] + y[r * width + c] * (255 - st.ya[k]) / 255.0;
+            }
+            error = max(error, fabs(expected - y2[r * width + c]));
+        }
+    }
+    for (int r = 0; r < height / 2; ++r)
+    {
+        for (int c = 0; c < width; ++c)
+        {
+            const int sr = r - top / 2, sc = c - left;
+            double expected = uv[r * width + c];
+            if (sr >= 0 && sr < st.height / 2 && sc >= 0 && sc < st.width)
+            {
+                const int k = sr * st.width + sc;
+                expected = min(255.0, st.uv[k] + uv[r * width + c] * (255 - st.uva[k]) / 255.0);
+            }
+            error = max(error, fabs(expected - uv2[r * width + c]));
+        }
+    }
+    return error;
+}
+
+int main()
+{
+    dlib::rand rnd;
+    std::vector<unsigned char> y(width * height), uv(width * height / 2);
+    for (size_t i = 0; i < y.size(); ++i)
+        y[i] = rnd.get_random_8bit_number();
+    for (size_t i = 0; i < uv.size(); ++i)
+        uv[i] = rnd.get_random_8bit_number();
+
+    // A sticker of odd size with every kind of alpha, premultiplied.
+    std::vector<rgb_alpha_pixel> pixels(201 * 157);
+    for (long r = 0; r < 201; ++r)
+    {
+        for (long c = 0; c < 157; ++c)
+        {
+            const unsigned a = (r + c) % 3 == 0 ? 0 : (r * c) % 256;
+            rgb_alpha_pixel& p = pixels[r * 157 + c];
+            p.red = rnd.get_random_8bit_number() * a / 255;
+            p.green = rnd.get_random_8bit_number() * a / 255;
+            p.blue = rnd.get_random_8bit_number() * a / 255;
+            p.alpha = a;
+        }
+    }
+    nv12sticker st;
+    nv12_sticker_build(&pixels[0], 201, 157, false, &st);
+
+    const int positions[][2] = { { 640, 360 }, { 641, 361 }, { 10, 10 }, { 1275, 715 }, { -50, 300 } };
+    double error = 0;
+    for (int i = 0; i < 5; ++i)
+        error = max(error, blend_error(y, uv, st, positions[i][0], positions[i][1]));
+    cout << "largest difference from the floating point blend: " << error << endl;
+
+    camera_preview_data_s frame;
+    frame.width = width;
+    frame.height = height;
+    frame.data.double_plane.y = &y[0];
+    frame.data.double_plane.uv = &uv[0];
+    frame.data.double_plane.y_size = width * height;
+    frame.data.double_plane.uv_size = width * height / 2;
+
+    const int sizes[] = { 64, 200, 400 };
+    for (int s = 0; s < 3; ++s)
+    {
+        const int size = sizes[s];
+        std::vector<rgb_alpha_pixel> square(size * size, rgb_alpha_pixel(78, 78, 78, 200));
+        nv12sticker blended;
+        nv12_sticker_build(&square[0], size, size, false, &blended);
+
+        // the old routine takes NV12 planes keyed against white
+        std::vector<unsigned char> keyed(size * size * 3 / 2, 100);
+        imageinfo info;
+        info.data = &keyed[0];
+        info.size = keyed.size();
+        info.width = size;
+        info.height = size;
+
+        const int runs = 2000;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int k = 0; k < runs; ++k)
+            _image_util_imgcpy(&frame, &info, width / 2, height / 2);
+        const double old_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / runs;
+
+        start = chrono::steady_clock::now();
+        for (int k = 0; k < runs; ++k)
+            nv12_blend_sticker(&y[0], &uv[0], width, height, &blended, width / 2, height / 2, 0, height);
+        const double new_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / runs;
+
+        cout << size << "x" << size << ": old key copy " << old_us << " us, blend " << new_us << " us" << endl;
+    }
+    return error <= 0.5 ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+// The contents of this file are in the public domain. See LICENSE_FOR_EXAMPLE_PROGRAMS.txt
+/*
+
+    This program checks the fixed point convolutions of the FaceFilter app
+    against a plain reference implementation.
+
+    Thousands of random kernels, full and separable, 3x3 and 5x5, are run
+    through the app's filter engine on random luma and interleaved chroma
+    planes of random sizes, some of them chained behind a second stage.
+    The reference convolves every sample with every weight, with the edge
+    samples repeated past the borders and the same rounding as the app, so
+    whichever of the SSE2, NEON or scalar paths this machine builds has to
+    match it exactly.  So do the largest separable kernels the app accepts,
+    and the ones just past them have to be rejected.  The kernels of the app's
+    own filters are timed on a 1920x1080 plane afterwards.
+
+    Call this program like this:
+        ./conv_check [number of kernels]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "filter_engine.h"
+
+using namespace std;
+
+// Convolves a plane whose horizontal neighbours are step bytes apart, the
+// way the app should, one weight at a time.
+void reference_conv(vector<unsigned char>& plane, int width, int height, int step,
+    const int* k, int size, int shift)
+{
+    const int r = size / 2;
+    vector<unsigned char> out(plane.size());
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const int channel = x % step;
+            long sum = 0;
+            for (int j = 0; j < size; ++j)
+            {
+                for (int i = 0; i < size; ++i)
+                {
+                    const int yy = max(0, min(y + j - r, height - 1));
+                    int xx = x + (i - r) * step;
+                    if (xx < 0)
+                        xx = channel;
+                    if (xx >= width)
+                        xx = width - step + channel;
+                    sum += (long) k[j * size + i] * plane[yy * width + xx];
+                }
+            }
+            sum = (sum + ((1L << shift) >> 1)) >> shift;
+            out[y * width + x] = (unsigned char) max(0L, min(sum, 255L));
+        }
+    }
+    plane.swap(out);
+}
+
+int main(int argc, char** argv)
+{
+    const int kernels = argc > 1 ? atoi(argv[1]) : 3000;
+
+    filterengine engine = filterengine();
+    filter_engine_init(&engine, max(1u, std::thread::hardware_concurrency()));
+    srand(7);
+
+    int mismatches = 0;
+    for (int trial = 0; trial < kernels; ++trial)
+    {
+        const int step = 1 + (trial & 1);
+        const int size = (trial & 2) ? 5 : 3;
+        const bool separable = (trial >> 2) & 1;
+        const int width = step * (1 + rand() % 40);
+        const int height = 1 + rand() % 80;
+        const int shift = rand() % 12;
+
+        // Separable kernels keep the vertical weights within the 16 bit
+        // sums the app holds them in.
+        int k[CONV_MAX_TAPS], col[5], row[5];
+        if (separable)
+        {
+            int col_sum = 0;
+            for (int i = 0; i < size; ++i)
+            {
+                col[i] = rand() % 61 - 20;
+                row[i] = rand() % 2001 - 800;
+                col_sum += abs(col[i]);
+            }
+            if (col_sum > 128)
+                for (int i = 0; i < size; ++i)
+                    col[i] = col[i] * 128 / col_sum;
+            for (int j = 0; j < size; ++j)
+                for (int i = 0; i < size; ++i)
+                    k[j * size + i] = col[j] * row[i];
+        }
+        else
+        {
+            for (int i = 0; i < size * size; ++i)
+                k[i] = rand() % 3 == 0 ? 0 : rand() % 601 - 300;
+        }
+
+        vector<unsigned char> plane(width * height);
+        for (size_t i = 0; i < plane.size(); ++i)
+            plane[i] = (unsigned char) rand();
+        vector<unsigned char> expected = plane;
+
+        filterchain chain;
+        filter_chain_init(&chain, step);
+        const bool added = separable ? filter_chain_add_separable(&chain, col, row, size, shift)
+                                     : filter_chain_add_kernel(&chain, k, size, shift);
+        if (!added)
+        {
+            cout << "kernel " << trial << " was rejected" << endl;
+            ++mismatches;
+            continue;
+        }
+        reference_conv(expected, width, height, step, k, size, shift);
+
+        // An inverted copy of the kernel behind it, to chain two rings.
+        const bool chained = !separable && rand() % 2;
+        if (chained)
+        {
+            filter_chain_add_invert(&chain);
+            filter_chain_add_kernel(&chain, k, size, shift + 3);
+            for (size_t i = 0; i < expected.size(); ++i)
+                expected[i] = 255 - expected[i];
+            reference_conv(expected, width, height, step, k, size, shift + 3);
+        }
+
+        filter_engine_run(&engine, &chain, &plane[0], width, height, width);
+        if (plane != expected && ++mismatches <= 5)
+        {
+            cout << "kernel " << trial << " mismatched: step " << step << ", " << size << "x" << size
+                 << (separable ? " separable" : "") << (chained ? " chained" : "")
+                 << ", " << width << "x" << height << endl;
+        }
+    }
+    cout << mismatches << " of " << kernels << " kernels mismatched" << endl;
+
+    // The largest separable kernels, on a flat white plane, where the sums
+    // come closest to 32 bits.  The horizontal weights may add up to 65535,
+    // any more has to be rejected, and the kernels just within it have to
+    // match.
+    {
+        const int col[3] = { 0, 128, 0 };
+        const int rows[4][3] = {
+            { 30000, 30000, 30000 }, { 21846, -21845, 21845 },  // rejected
+            { 21845, 21845, 21845 }, { 21845, -21845, 21845 }   // accepted
+        };
+        for (int i = 0; i < 4; ++i)
+        {
+            filterchain chain;
+            filter_chain_init(&chain, 1);
+            const bool accepted = filter_chain_add_separable(&chain, col, rows[i], 3, 24);
+            if (accepted != (i >= 2))
+            {
+                cout << "separable kernel " << rows[i][0] << ", " << rows[i][1] << ", " << rows[i][2]
+                     << (accepted ? " was accepted" : " was rejected") << endl;
+                ++mismatches;
+                continue;
+            }
+            if (!accepted)
+                continue;
+
+            int k[9];
+            for (int j = 0; j < 3; ++j)
+                for (int n = 0; n < 3; ++n)
+                    k[j * 3 + n] = col[j] * rows[i][n];
+            vector<unsigned char> plane(64 * 8, 255), expected = plane;
+            reference_conv(expected, 64, 8, 1, k, 3, 24);
+            filter_engine_run(&engine, &chain, &plane[0], 64, 8, 64);
+            if (plane != expected)
+            {
+                cout << "separable kernel " << rows[i][0] << ", " << rows[i][1] << ", " << rows[i][2]
+                     << " mismatched: " << (int) plane[0] << " instead of " << (int) expected[0] << endl;
+                ++mismatches;
+            }
+        }
+    }
+
+    // The kernels of the app's filters, see _build_filters() in data.cpp.
+    const int width = 1920, height = 1080;
+    vector<unsigned char> plane(width * height);
+    for (size_t i = 0; i < plane.size(); ++i)
+        plane[i] = (unsigned char) rand();
+    static const int emboss[9] = { 2, 1, 0, 1, 1, -1, 0, -1, -2 };
+    static const int gaussian_col[3] = { 14, 100, 14 }, gaussian_row[3] = { 27, 202, 27 };
+    static const int binomial[5] = { 1, 4, 6, 4, 1 };
+
+    struct { const char* name; filterchain chain; } timed[3];
+    for (int i = 0; i < 3; ++i)
+        filter_chain_init(&timed[i].chain, 1);
+    timed[0].name = "emboss 3x3";
+    filter_chain_add_kernel(&timed[0].chain, emboss, 3, 0);
+    timed[1].name = "gaussian 3x3 separable";
+    filter_chain_add_separable(&timed[1].chain, gaussian_col, gaussian_row, 3, 15);
+    timed[2].name = "binomial 5x5 separable";
+    filter_chain_add_separable(&timed[2].chain, binomial, binomial, 5, 8);
+    for (int i = 0; i < 3; ++i)
+    {
+        const int runs = 20;
+        const auto start = chrono::steady_clock::now();
+        for (int n = 0; n < runs; ++n)
+            filter_engine_run(&engine, &timed[i].chain, &plane[0], width, height, width);
+        const double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << timed[i].name << ": " << ms / runs << " ms per 1920x1080 plane" << endl;
+    }
+
+    filter_engine_release(&engine);
+    return mismatches == 0 ? 0 : 1;
+}
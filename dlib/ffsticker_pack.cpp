@@ -0,0 +1,127 @@
+// The contents of this file are in the public domain. See LICENSE_FOR_EXAMPLE_PROGRAMS.txt
+/*
+
+    This program builds a .ffsticker package out of sticker images, so the
+    FaceFilter app can map its stickers instead of decoding them at startup.
+
+    Every image is premultiplied, and its mip levels and NV12 planes are
+    built by the same code the app uses, so the package holds exactly what
+    the app would have computed.  The anchors the app knows for a sticker,
+    or for the sequence it is a frame of (hat0, hat1, ... belong to "hat"),
+    are shipped along with it.
+
+    Images without any transparent pixel, JPEGs for instance, are keyed like
+    the app keys them: whatever is brighter than STICKER_WHITE_KEY becomes
+    transparent.  When two images have the same name, the first one wins.
+
+    Call this program like this:
+        ./ffsticker_pack stickers.ffsticker ear01.png glasses01.png hat0.png hat1.png
+    or run make stickers, which packs every sticker of sticker_image and of
+    the app's resource directory.
+*/
+
+#include <dlib/image_io.h>
+#include <iostream>
+#include <set>
+#include <thread>
+#include "sticker_atlas.h"
+#include "sticker_package.h"
+#include "sticker_warp.h"
+
+using namespace dlib;
+using namespace std;
+
+bool decode_sticker(const char* path, array2d<rgb_alpha_pixel>& img)
+{
+    try
+    {
+        load_image(img, path);
+    }
+    catch (exception& e)
+    {
+        cerr << path << ": " << e.what() << endl;
+        return false;
+    }
+
+    bool opaque = true;
+    for (long r = 0; r < img.nr() && opaque; ++r)
+        for (long c = 0; c < img.nc() && opaque; ++c)
+            opaque = img[r][c].alpha == 255;
+
+    if (opaque)
+    {
+        for (long r = 0; r < img.nr(); ++r)
+        {
+            for (long c = 0; c < img.nc(); ++c)
+            {
+                rgb_alpha_pixel& p = img[r][c];
+                // BT.601 luma, like _image_util_decode_sticker()
+                if ((77 * p.red + 150 * p.green + 29 * p.blue) >> 8 > STICKER_WHITE_KEY)
+                    p.alpha = 0;
+            }
+        }
+    }
+    return true;
+}
+
+string sticker_name(const string& path)
+{
+    size_t begin = path.find_last_of('/');
+    begin = begin == string::npos ? 0 : begin + 1;
+    size_t end = path.find_last_of('.');
+    if (end == string::npos || end < begin)
+        end = path.size();
+    return path.substr(begin, end - begin);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        cout << "Call this program like this:" << endl;
+        cout << "./ffsticker_pack <package> <image> ..." << endl;
+        return 0;
+    }
+
+    std::vector<string> paths;
+    std::set<string> names;
+    for (int i = 2; i < argc; ++i)
+    {
+        if (names.insert(sticker_name(argv[i])).second)
+            paths.push_back(argv[i]);
+        else
+            cout << "skipping " << argv[i] << ", a sticker with that name is already packed" << endl;
+    }
+
+    stickeratlas atlas;
+    const unsigned long count = sticker_atlas_load(&atlas, paths, decode_sticker,
+        std::max(1u, std::thread::hardware_concurrency()));
+    if (count != paths.size())
+    {
+        cerr << "Unable to load " << paths.size() - count << " of the sticker images" << endl;
+        return 1;
+    }
+
+    // The anchors of a sticker, or of the sequence it is a frame of.
+    for (size_t i = 0; i < atlas.stickers.size(); ++i)
+    {
+        string name = atlas.stickers[i].name;
+        const stickerlayout* layout = sticker_layout_find(name.c_str());
+        if (layout == NULL)
+        {
+            name = name.substr(0, name.find_last_not_of("0123456789") + 1);
+            layout = sticker_layout_find(name.c_str());
+        }
+        if (layout != NULL && sticker_atlas_find_layout(&atlas, layout->name) == NULL)
+            atlas.layouts.push_back(*layout);
+    }
+
+    if (!sticker_package_write(&atlas, argv[1]))
+    {
+        cerr << "Unable to write " << argv[1] << endl;
+        return 1;
+    }
+    cout << "packed " << atlas.stickers.size() << " stickers and " << atlas.layouts.size()
+         << " layouts into " << argv[1] << endl;
+    return 0;
+}
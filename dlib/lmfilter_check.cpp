@@ -0,0 +1,125 @@
+// The contents of this file are in the public domain. See LICENSE_FOR_EXAMPLE_PROGRAMS.txt
+/*
+
+    This program checks the landmark smoothing of the FaceFilter app on
+    synthetic motion traces.
+
+    The 68 landmarks of a make-believe face are moved along a known path and
+    "measured" the way the shape predictor would: rounded to whole pixels,
+    with 2 px of gaussian noise, at frame intervals jittering between 28 and
+    38 ms.  Every frame goes through landmark_filter_update(), and the
+    filtered points, and the points landmark_filter_predict() extrapolates
+    40 ms ahead to when the frame would be displayed, are compared with the
+    true path.
+
+    Two traces are run: a face swaying in front of the camera, and a face
+    holding still, on which what is left is jitter.  The filter has to beat
+    the raw measurements on both.  On the moving face the prediction has to
+    beat showing the last measurement late; on the still one there is
+    nothing to predict, and it only adds a little of the velocity noise.
+
+    Call this program like this:
+        ./lmfilter_check
+*/
+
+#include <cmath>
+#include <iostream>
+#include <dlib/rand.h>
+#include "landmark_filter.h"
+
+using namespace dlib;
+using namespace std;
+
+// Where landmark i truly is at t seconds.
+typedef dlib::vector<double, 2> (*motion_path)(double t, int i);
+
+dlib::vector<double, 2> swaying(double t, int i)
+{
+    return dlib::vector<double, 2>(300 + 100 * sin(t * 2.0) + i, 200 + 60 * cos(t * 1.3) + i % 7);
+}
+
+dlib::vector<double, 2> holding_still(double /*t*/, int i)
+{
+    return dlib::vector<double, 2>(300.3 + i, 200.6 + i % 7);
+}
+
+// RMS errors in px, against the path, after the first frames have settled
+// the filter.
+struct trace_errors
+{
+    double raw, filtered; // at the time of the frame
+    double stale, predicted; // 40 ms later
+};
+
+trace_errors run_trace(motion_path path)
+{
+    const int frames = 300, settle = 20, ahead_ms = 40, points = 68;
+
+    dlib::rand rnd;
+    lmfilter filter;
+    landmark_filter_init(&filter, 0, LMF_PROCESS_NOISE, LMF_MEASUREMENT_NOISE);
+
+    double raw = 0, filtered = 0, stale = 0, predicted = 0;
+    long n = 0;
+    unsigned int time = 1000;
+    for (int k = 0; k < frames; ++k)
+    {
+        time += 28 + rnd.get_random_32bit_number() % 11;
+
+        std::vector<point> parts;
+        for (int i = 0; i < points; ++i)
+        {
+            const dlib::vector<double, 2> p = path(time / 1000.0, i);
+            parts.push_back(point((long) floor(p.x() + 2.0 * rnd.get_random_gaussian() + 0.5),
+                                  (long) floor(p.y() + 2.0 * rnd.get_random_gaussian() + 0.5)));
+        }
+        const full_object_detection shape(rectangle(200, 100, 400, 300), parts);
+
+        full_object_detection now, later;
+        landmark_filter_update(&filter, shape, time);
+        landmark_filter_predict(&filter, time, now);
+        landmark_filter_predict(&filter, time + ahead_ms, later);
+        if (k < settle)
+            continue;
+
+        for (int i = 0; i < points; ++i)
+        {
+            const dlib::vector<double, 2> truth = path(time / 1000.0, i);
+            const dlib::vector<double, 2> truth_later = path((time + ahead_ms) / 1000.0, i);
+            raw += length_squared(dlib::vector<double, 2>(parts[i]) - truth);
+            filtered += length_squared(dlib::vector<double, 2>(now.part(i)) - truth);
+            stale += length_squared(dlib::vector<double, 2>(parts[i]) - truth_later);
+            predicted += length_squared(dlib::vector<double, 2>(later.part(i)) - truth_later);
+            ++n;
+        }
+    }
+
+    trace_errors e;
+    e.raw = sqrt(raw / n);
+    e.filtered = sqrt(filtered / n);
+    e.stale = sqrt(stale / n);
+    e.predicted = sqrt(predicted / n);
+    return e;
+}
+
+int main()
+{
+    const struct { const char* name; motion_path path; bool moving; } traces[] = {
+        { "swaying", swaying, true },
+        { "holding still", holding_still, false }
+    };
+
+    bool ok = true;
+    for (int t = 0; t < 2; ++t)
+    {
+        const trace_errors e = run_trace(traces[t].path);
+        cout << traces[t].name << ": rms raw " << e.raw << " px, filtered " << e.filtered
+             << " px; 40 ms later: last measurement " << e.stale << " px, predicted "
+             << e.predicted << " px" << endl;
+        ok = ok && e.filtered < e.raw && (!traces[t].moving || e.predicted < e.stale);
+    }
+
+    if (!ok)
+        cout << "the filter does worse than the raw landmarks" << endl;
+    return ok ? 0 : 1;
+}
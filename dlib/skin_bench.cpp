@@ -0,0 +1,104 @@
+// The contents of this file are in the public domain. See LICENSE_FOR_EXAMPLE_PROGRAMS.txt
+/*
+
+    This program times the skin smoothing of the FaceFilter app at several
+    box radii, and measures what it does to the skin and to an edge.
+
+    The frame is a 1920x1080 luma plane with sensor noise of std 6, split
+    by a 50 level edge down its middle.  A face of 440x560 pixels sits on
+    the edge, its mask built from made-up landmarks by face_mask_build(),
+    as the app builds it.  For every radius the best of many runs is
+    reported, with the noise left in flat skin 30 pixels or more from the
+    edge, and the levels the edge keeps across the 6 pixels around it.
+
+    The box sums of the guided filter keep running sums, so the cost per
+    pixel should not depend on the radius.  Only the guide grows, by the
+    radius around the mask.
+
+    Call this program like this:
+        ./skin_bench
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <dlib/rand.h>
+#include "skin_smooth.h"
+
+using namespace dlib;
+using namespace std;
+
+const int width = 1920, height = 1080;
+const int edge = width / 2; // first column of the bright side
+
+double column_mean(const std::vector<unsigned char>& y, int x, int top, int bottom)
+{
+    double sum = 0;
+    for (int j = top; j < bottom; ++j)
+        sum += y[j * width + x];
+    return sum / (bottom - top);
+}
+
+// Standard deviation of the pixels of a box, around their mean.
+double noise(const std::vector<unsigned char>& y, int left, int top, int right, int bottom)
+{
+    double sum = 0, squares = 0;
+    for (int j = top; j < bottom; ++j)
+    {
+        for (int i = left; i < right; ++i)
+        {
+            sum += y[j * width + i];
+            squares += (double) y[j * width + i] * y[j * width + i];
+        }
+    }
+    const double n = (double) (right - left) * (bottom - top);
+    return sqrt(max(0.0, squares / n - (sum / n) * (sum / n)));
+}
+
+int main()
+{
+    dlib::rand rnd;
+    std::vector<unsigned char> frame(width * height);
+    for (int j = 0; j < height; ++j)
+        for (int i = 0; i < width; ++i)
+            frame[j * width + i] = (unsigned char) max(0.0, min((i < edge ? 120 : 170) + 6 * rnd.get_random_gaussian() + 0.5, 255.0));
+
+    // An oval face centered on the edge, in the rotated image the landmarks
+    // are found in: frame pixel (x, y) is landmark (height - 1 - y, x).
+    std::vector<point> parts(68);
+    for (int k = 0; k < 68; ++k)
+    {
+        const double t = 2 * pi * k / 68;
+        parts[k] = point(height - 1 - (long) (height / 2 + 280 * sin(t)), (long) (edge + 220 * cos(t)));
+    }
+    const full_object_detection shape(rectangle(0, 0, height - 1, width - 1), parts);
+    facemask mask;
+    face_mask_build(&mask, shape, FACE_MASK_HULL, width, height);
+
+    // flat skin on the dark side, and the rows the edge is measured on
+    const int top = height / 2 - 60, bottom = height / 2 + 60;
+    cout << "noise std " << noise(frame, edge - 110, top, edge - 30, bottom) << ", edge "
+         << column_mean(frame, edge + 2, top, bottom) - column_mean(frame, edge - 3, top, bottom)
+         << " levels before smoothing" << endl;
+
+    skinsmooth skin;
+    std::vector<unsigned char> y;
+    const int radii[] = { 4, 8, 12, 16, 24, 32, 48 };
+    for (int r = 0; r < 7; ++r)
+    {
+        double best = 1e9;
+        for (int run = 0; run < 60; ++run)
+        {
+            y = frame;
+            const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            skin_smooth_face(&skin, &y[0], width, height, &mask, radii[r], SKIN_EPS);
+            best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+        }
+        cout << "radius " << radii[r] << (radii[r] == SKIN_RADIUS ? " (SKIN_RADIUS)" : "") << ": "
+             << best << " ms, noise std " << noise(y, edge - 110, top, edge - 30, bottom)
+             << ", edge " << column_mean(y, edge + 2, top, bottom) - column_mean(y, edge - 3, top, bottom)
+             << " levels" << endl;
+    }
+    return 0;
+}
@@ -35,23 +35,63 @@
 #include <dlib/image_processing.h>
 #include <dlib/gui_widgets.h>
 #include <dlib/image_io.h>
+#include "../FaceFilter/inc/sticker_atlas.h"
 
 using namespace dlib;
 using namespace std;
 
 cv_image<bgr_pixel> cimg;
 //array2d<rgb_pixel> cimg;
-array2d<rgb_alpha_pixel> origin_img;
 array2d<rgb_alpha_pixel> resize_img;
 std::vector<rectangle> faces;
 int width;
 int height;
 
+// Every sticker is decoded once before the capture loop starts.  The loop only
+// resamples the mip level closest to the size it needs.
+stickeratlas atlas;
+const sticker* sticker_img = NULL;
+const sticker* sticker_right = NULL;
+
 void stick_mustache(full_object_detection );
 void stick_glasses(full_object_detection);
-void stick_ear(full_object_detection , char* );
+void stick_ear(full_object_detection );
 void stick_hat(full_object_detection );
 
+bool decode_sticker(const char* path, array2d<rgb_alpha_pixel>& img)
+{
+    try
+    {
+        load_image(img, path);
+        return true;
+    }
+    catch (exception& e)
+    {
+        cout << e.what() << endl;
+        return false;
+    }
+}
+
+// Blends the premultiplied sticker onto cimg with its top left corner at (top, left).
+void paste_sticker(const array2d<rgb_alpha_pixel>& st, long top, long left)
+{
+    const rectangle area = rectangle(left, top, left + st.nc() - 1, top + st.nr() - 1).intersect(get_rect(cimg));
+    for (long r = area.top(); r <= area.bottom(); ++r)
+    {
+        for (long c = area.left(); c <= area.right(); ++c)
+        {
+            const rgb_alpha_pixel& s = st[r - top][c - left];
+            if (s.alpha == 0)
+                continue;
+            bgr_pixel& d = cimg[r][c];
+            const unsigned k = 255 - s.alpha;
+            d.red = s.red + (d.red * k + 127) / 255;
+            d.green = s.green + (d.green * k + 127) / 255;
+            d.blue = s.blue + (d.blue * k + 127) / 255;
+        }
+    }
+}
+
 int main(int argc, char** argv)
 {
     try
@@ -75,6 +115,23 @@ int main(int argc, char** argv)
             return 1;
         }
 
+        // The ear stickers come in pairs, "<name>l.<ext>" and "<name>r.<ext>".
+        std::string path = argv[2];
+        std::vector<std::string> paths(1, path);
+        const size_t dot = path.find_last_of('.');
+        if (stoi(argv[1]) == 2 && dot != std::string::npos && dot > 0)
+        {
+            paths.push_back(path);
+            paths.back()[dot - 1] = 'r';
+        }
+        if (sticker_atlas_load(&atlas, paths, decode_sticker, paths.size()) != paths.size())
+        {
+            cerr << "Unable to load the sticker images" << endl;
+            return 1;
+        }
+        sticker_img = &atlas.stickers[0];
+        sticker_right = &atlas.stickers.back();
+
         image_window win;
 
         // Load face detection and pose estimation models.
@@ -82,6 +139,11 @@ int main(int argc, char** argv)
         shape_predictor pose_model;
         deserialize("shape_predictor_68_face_landmarks.dat") >> pose_model;
 
+        // Keep the detector buffers alive across frames so that detection doesn't
+        // reallocate the HOG pyramid for every frame.
+        fhog_detection_workspace<bgr_pixel> detector_workspace;
+        std::vector<rect_detection> face_dets;
+
         // Grab and process frames until the main window is closed by the user.
         while(!win.is_closed())
         {
@@ -102,14 +164,16 @@ int main(int argc, char** argv)
 
             // Detect faces
             //load_image(cimg, "a.jpg"); 
-            faces = detector(cimg);
+            evaluate_detectors(detector, cimg, face_dets, detector_workspace);
+            faces.clear();
+            for (unsigned long i = 0; i < face_dets.size(); ++i)
+                faces.push_back(face_dets[i].rect);
 
             // Find the pose of each face.
             std::vector<full_object_detection> shapes;
             for (unsigned long i = 0; i < faces.size(); ++i)
                 shapes.push_back(pose_model(cimg, faces[i]));
 
-            load_image(origin_img, argv[2]);
             //Resize image using face size
             for(unsigned long i = 0; i < faces.size(); i++)
             {
@@ -123,7 +187,7 @@ int main(int argc, char** argv)
                         stick_glasses(shape);
                         break;
                     case 2: // Ear
-                        stick_ear(shape, argv[2]);
+                        stick_ear(shape);
                         break;
                     case 3: // Hair
                         //stick_hair();
@@ -158,21 +222,10 @@ void stick_mustache(full_object_detection shape)
     rectangle rect = shape.get_rect();
     long width = rect.right() - rect.left();
     long height = rect.bottom() - rect.top();
-    resize_img.set_size(height/2, width/2); // set row, column
-    resize_image(origin_img, resize_img, interpolate_bilinear());
+    sticker_atlas_scale(sticker_img, height/2, width/2, resize_img); // set row, column
 
-    for(int i = 0; i < resize_img.nc(); i++)
-    {
-        for(int j = 0; j < resize_img.nr(); j++)
-        {
-            if(resize_img[i][j].alpha == 0)
-                continue;
-            //Be careful. shape.part(idx)(0) returns row value, shape.part(idx)(1) returns column value
-            cimg[i-resize_img.nc()/2 + shape.part(33)(1)][j-resize_img.nr()/2 + shape.part(33)(0)].red = resize_img[i][j].red;
-            cimg[i-resize_img.nc()/2 + shape.part(33)(1)][j-resize_img.nr()/2 + shape.part(33)(0)].blue = resize_img[i][j].blue;
-            cimg[i-resize_img.nc()/2 + shape.part(33)(1)][j-resize_img.nr()/2 + shape.part(33)(0)].green = resize_img[i][j].green;
-        }
-    }
+    //Be careful. shape.part(idx)(0) returns column value, shape.part(idx)(1) returns row value
+    paste_sticker(resize_img, shape.part(33)(1) - resize_img.nr()/2, shape.part(33)(0) - resize_img.nc()/2);
 }
 
 void stick_glasses(full_object_detection shape)
@@ -180,119 +233,40 @@ void stick_glasses(full_object_detection shape)
     rectangle rect = shape.get_rect();
     long height = (shape.part(41)(1) - shape.part(19)(1))*3; //left eyebrow to bottom of left eye
     long width = rect.right() - rect.left(); 
-    resize_img.set_size(height, width);
-    resize_image(origin_img, resize_img, interpolate_bilinear()); 
-    
+    sticker_atlas_scale(sticker_img, height, width, resize_img);
+
     long m_x = shape.part(27)(0);
     long m_y = shape.part(27)(1);
 
-    for(int i = 0; i < resize_img.nr(); ++i)
-    {
-        for(int j = 0; j < resize_img.nc(); ++j)
-        {
-            if(resize_img[i][j].alpha == 0)
-                continue;
-            cimg[i - resize_img.nr()/2 + m_y][j - resize_img.nc()/2 + m_x].red = resize_img[i][j].red;
-            cimg[i - resize_img.nr()/2 + m_y][j - resize_img.nc()/2 + m_x].blue = resize_img[i][j].blue;
-            cimg[i - resize_img.nr()/2 + m_y][j - resize_img.nc()/2 + m_x].green = resize_img[i][j].green;
-        }
-    }
-        
+    paste_sticker(resize_img, m_y - resize_img.nr()/2, m_x - resize_img.nc()/2);
 }
 
-void stick_ear(full_object_detection shape, char* img_name)
+void stick_ear(full_object_detection shape)
 {
-    try{
-        long h = ((shape.part(21) + shape.part(22)) - shape.part(33))(1);
-
-        dlib::vector<long int, 2l> fore_l = dlib::vector<long int, 2l>((shape.part(19))(0), h);
-        dlib::vector<long int, 2l> fore_r = dlib::vector<long int, 2l>((shape.part(24))(0), h);
-
-        int nw = (int)((float)h/origin_img.nr() * origin_img.nc());
-        resize_img.set_size(h, nw);
-        resize_image(origin_img, resize_img, interpolate_bilinear());
-        
-        int p = (int)fore_l(0);
-        int q = (int)fore_l(1);
-        int sw = (int)resize_img.nr()/2;
-        int sh = (int)resize_img.nc()/2;
-
-        for(int i = -sw; i < sw; i++) {
-            for(int j = -sh; j < sh; j++) {
-                if(resize_img[i+sw][j+sh].alpha == 0)
-                    continue;
-                cimg[i+q][j+p].red = resize_img[i+sw][j+sh].red;
-                cimg[i+q][j+p].blue = resize_img[i+sw][j+sh].blue;
-                cimg[i+q][j+p].green = resize_img[i+sw][j+sh].green;
-            }
-        }
+    long h = ((shape.part(21) + shape.part(22)) - shape.part(33))(1);
 
-        char* new_name;
-        strncpy(new_name, img_name, strlen(img_name));
-        new_name[strlen(new_name) - 5] = 'r';
-        load_image(origin_img, new_name);
-
-        resize_image(origin_img, resize_img, interpolate_bilinear());
-        p = (int)fore_r(0);
-        q = (int)fore_r(1);
-
-        for(int i = -sw; i < sw; i++) {
-            for(int j = -sh; j < sh; j++) {
-                if(resize_img[i+sw][j+sh].alpha == 0)
-                    continue;
-                cimg[i+q][j+p].red = resize_img[i+sw][j+sh].red;
-                cimg[i+q][j+p].blue = resize_img[i+sw][j+sh].blue;
-                cimg[i+q][j+p].green = resize_img[i+sw][j+sh].green;
-            }
-        }
+    dlib::vector<long int, 2l> fore_l = dlib::vector<long int, 2l>((shape.part(19))(0), h);
+    dlib::vector<long int, 2l> fore_r = dlib::vector<long int, 2l>((shape.part(24))(0), h);
 
-        delete(new_name);
-    }
-    
-    catch (exception &e)
-    {
-        cout << "\nexception thrown!" << endl;
-        cout << e.what() << endl;
-    }
+    const stickermip& origin_img = sticker_img->mips[0];
+    int nw = (int)((float)h/origin_img.rows * origin_img.cols);
+
+    sticker_atlas_scale(sticker_img, h, nw, resize_img);
+    paste_sticker(resize_img, fore_l(1) - resize_img.nr()/2, fore_l(0) - resize_img.nc()/2);
+
+    sticker_atlas_scale(sticker_right, h, nw, resize_img);
+    paste_sticker(resize_img, fore_r(1) - resize_img.nr()/2, fore_r(0) - resize_img.nc()/2);
 }
 
 void stick_hat(full_object_detection shape)
 {
-    try{
-        long h = ((shape.part(21) + shape.part(22)) - shape.part(33))(1);
-        rectangle rect = shape.get_rect();
-        long width = rect.right() - rect.left();
-        long height = rect.bottom() - rect.top();
-
-        dlib::vector<long int, 2l> fore = dlib::vector<long int, 2l>((shape.part(27))(0), h);
-
-        int w = (int)((float)h/origin_img.nr() * origin_img.nc());
-        cout << "(" << w << ", " << h << ")" << endl;
-        //resize_img.set_size(w, h);
-        resize_img.set_size(height, width);
-        resize_image(origin_img, resize_img, interpolate_bilinear());
-        
-        int p = (int)fore(0);
-        int q = (int)fore(1);
-        int sw = (int)resize_img.nc()/2;
-        int sh = (int)resize_img.nr()/2;
-
-        for(int i = 0; i < resize_img.nc(); i++) {
-            for(int j = 0; j < resize_img.nr(); j++) {
-                if(resize_img[i+w][j+h].alpha == 0)
-                    continue;
-                cimg[i+q-sw][j+p-sh].red = resize_img[i][j].red;
-                cimg[i+q-sw][j+p-sh].blue = resize_img[i][j].blue;
-                cimg[i+q-sw][j+p-sh].green = resize_img[i][j].green;
-            }
-        }
+    long h = ((shape.part(21) + shape.part(22)) - shape.part(33))(1);
+    rectangle rect = shape.get_rect();
+    long width = rect.right() - rect.left();
+    long height = rect.bottom() - rect.top();
 
-    }
-    
-    catch (exception &e)
-    {
-        cout << "\nexception thrown!" << endl;
-        cout << e.what() << endl;
-    }
-}
+    dlib::vector<long int, 2l> fore = dlib::vector<long int, 2l>((shape.part(27))(0), h);
 
+    sticker_atlas_scale(sticker_img, height, width, resize_img);
+    paste_sticker(resize_img, fore(1) - resize_img.nr()/2, fore(0) - resize_img.nc()/2);
+}